@@ -0,0 +1,236 @@
+#include <Arduino.h>
+#include <driver/i2s_std.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "pins.h"
+#include "config.h"
+#include "audio.h"
+#include "bands.h"
+#include "energy.h"
+#include "levelstats.h"
+#include "metrics.h"
+#include "logring.h"
+
+// Frames of audio per level window (the smoothing below is tuned per window).
+static const uint32_t WINDOW_FRAMES = (uint32_t)SAMPLE_RATE * DB_CALC_INTERVAL / 1000;
+
+static i2s_chan_handle_t s_rx = nullptr;
+static TaskHandle_t s_task = nullptr;
+
+// Capture -> analysis stages. One DMA buffer of mono samples per block; the pool
+// is 16-byte aligned for the S3's 128-bit vector loads.
+typedef FrameBus<int16_t, I2S_DMA_FRAME_NUM, AUDIO_BUS_DEPTH, AUDIO_BUS_CONSUMERS> AudioBus;
+static AudioBus s_bus;
+static TaskHandle_t s_bandsTask = nullptr;
+static int s_bandsReader = -1;
+
+// Written only by the capture task / I2S ISR; 32-bit stores are atomic on the S3.
+static volatile float s_dbFS = -60.0f;
+static volatile uint32_t s_overruns = 0;
+static volatile uint32_t s_frames = 0;
+static volatile Weighting s_weighting = WEIGHTING_Z;  // requested by loop(), applied by the task
+
+// Per-block DSP cost (weighting + energy), worst case since the last log line.
+static uint32_t s_blockCyclesMax = 0;
+
+// ISR: a DMA buffer just completed — wake the capture task.
+static bool IRAM_ATTR onRecv(i2s_chan_handle_t, i2s_event_data_t *, void *) {
+  BaseType_t woken = pdFALSE;
+  if (s_task) vTaskNotifyGiveFromISR(s_task, &woken);
+  return woken == pdTRUE;
+}
+
+// ISR: the DMA ring filled before the capture task drained it (frames dropped).
+static bool IRAM_ATTR onRecvOverflow(i2s_chan_handle_t, i2s_event_data_t *, void *) {
+  s_overruns = s_overruns + 1;
+  return false;
+}
+
+// RX-only, mono, channel-based std driver. The ES8311 mirrors its mono ADC into
+// both slots, so only the left slot is captured: half the DMA bandwidth and
+// buffer memory of the old full-duplex stereo setup, and no unused TX channel.
+static bool installI2S() {
+  LOGI(LOG_AUDIO, "Init I2S...");
+
+  i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_0, I2S_ROLE_MASTER);
+  chan_cfg.dma_desc_num = I2S_DMA_DESC_NUM;
+  chan_cfg.dma_frame_num = I2S_DMA_FRAME_NUM;
+  esp_err_t err = i2s_new_channel(&chan_cfg, NULL, &s_rx);
+  if (err != ESP_OK) {
+    LOGE(LOG_AUDIO, "I2S channel create failed: %d", err);
+    return false;
+  }
+
+  i2s_std_config_t std_cfg = {
+    .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(SAMPLE_RATE),
+    .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_MONO),
+    .gpio_cfg = {
+      .mclk = (gpio_num_t)PIN_I2S_MCLK,
+      .bclk = (gpio_num_t)PIN_I2S_BCLK,
+      .ws = (gpio_num_t)PIN_I2S_LRCK,
+      .dout = I2S_GPIO_UNUSED,
+      .din = (gpio_num_t)PIN_I2S_DIN,
+      .invert_flags = {
+        .mclk_inv = false,
+        .bclk_inv = false,
+        .ws_inv = false,
+      },
+    },
+  };
+  std_cfg.clk_cfg.mclk_multiple = I2S_MCLK_MULTIPLE_256;
+  std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
+
+  err = i2s_channel_init_std_mode(s_rx, &std_cfg);
+  if (err != ESP_OK) {
+    LOGE(LOG_AUDIO, "I2S std init failed: %d", err);
+    return false;
+  }
+
+  i2s_event_callbacks_t cbs = {};
+  cbs.on_recv = onRecv;
+  cbs.on_recv_q_ovf = onRecvOverflow;
+  err = i2s_channel_register_event_callback(s_rx, &cbs, NULL);
+  if (err != ESP_OK) {
+    LOGE(LOG_AUDIO, "I2S callback register failed: %d", err);
+    return false;
+  }
+
+  LOGI(LOG_AUDIO, "I2S OK");
+  return true;
+}
+
+// Close a level window: smooth in the ENERGY domain (short Leq) so the reported
+// level reflects sustained loudness rather than individual loud/quiet blocks.
+// Single precision throughout: the S3 FPU has no double, and float keeps the
+// level within 0.001 dB of the former double path (check with the native replay
+// harness, which runs that path alongside).
+static void publishWindow(float meanSquare) {
+  // The window's own Leq feeds the percentile histograms, unsmoothed.
+  levelStatsAdd(10.0f * log10f(meanSquare < 1.0f ? 1.0f : meanSquare) - 90.308734f);
+
+  static float avgMeanSquare = 0;
+  if (avgMeanSquare <= 0) avgMeanSquare = meanSquare;  // seed on first window
+  const float alpha = (float)AUDIO_ENERGY_ALPHA;
+  avgMeanSquare = alpha * meanSquare + (1.0f - alpha) * avgMeanSquare;
+
+  // 10 log10(ms) - 20 log10(32767): the dB of the RMS without the sqrt.
+  float ms = avgMeanSquare < 1.0f ? 1.0f : avgMeanSquare;
+  s_dbFS = 10.0f * log10f(ms) - 90.308734f;
+
+  static uint8_t dbgCount = 0;
+  if (++dbgCount % 20 == 0) {  // ~every 2s, light field-diagnostic logging
+    uint32_t maxUs = s_blockCyclesMax / ESP.getCpuFreqMHz();
+    s_blockCyclesMax = 0;
+    FrameBusStats bands = audioGetBandsBusStats();
+    LOGD(LOG_AUDIO, "%.1f dB%s  (overruns %u, dsp max %uus/block%s, bands lag max %u missed %u)",
+                  (float)s_dbFS, weightingName(s_weighting), (unsigned)s_overruns,
+                  (unsigned)maxUs, maxUs > AUDIO_DSP_BUDGET_US ? " OVER BUDGET" : "",
+                  (unsigned)bands.maxLag, (unsigned)bands.overruns);
+  }
+}
+
+static void captureTask(void *) {
+  float sumSquares = 0;
+  uint32_t windowFrames = 0;
+  BiquadCascade filter;
+  Weighting active = WEIGHTING_Z;
+  const uint32_t cyclesPerUs = ESP.getCpuFreqMHz();
+
+  for (;;) {
+    // Sleep until the on-receive ISR signals a completed DMA buffer (the timeout
+    // only guards against a stalled clock), then drain everything queued.
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+    for (;;) {
+      // Read straight into a bus block; it stays readable here after publishing.
+      int16_t *buf = s_bus.acquire();
+      size_t bytesRead = 0;
+      esp_err_t err = i2s_channel_read(s_rx, buf, I2S_DMA_FRAME_NUM * sizeof(int16_t), &bytesRead, 0);
+      int numFrames = bytesRead / sizeof(int16_t);
+      if (numFrames > 0) {
+        s_bus.publish(numFrames);
+        if (s_bandsTask) xTaskNotifyGive(s_bandsTask);
+      }
+
+      if (active != s_weighting) {
+        active = s_weighting;
+        uint8_t count;
+        const Biquad *sections = weightingSections(active, count);
+        filter.set(sections, count);
+      }
+
+      // Energy per run of samples up to the next window edge. Windows may end
+      // mid-block; carry the rest into the next one. Z has no filter, so its
+      // energy is the exact integer kernel (vectorised on the S3); weighted
+      // curves filter and square in float.
+      uint32_t t0 = ESP.getCycleCount();
+      for (int i = 0; i < numFrames;) {
+        uint32_t n = WINDOW_FRAMES - windowFrames;
+        if (n > (uint32_t)(numFrames - i)) n = numFrames - i;
+        if (filter.count == 0) {
+          sumSquares += (float)energyInt16(buf + i, n);
+        } else {
+          sumSquares += filter.sumSquares(buf + i, n);
+        }
+        i += n;
+        windowFrames += n;
+        if (windowFrames >= WINDOW_FRAMES) {
+          publishWindow(sumSquares / windowFrames);
+          sumSquares = 0;
+          windowFrames = 0;
+        }
+      }
+      uint32_t cycles = ESP.getCycleCount() - t0;
+      if (cycles > s_blockCyclesMax) s_blockCyclesMax = cycles;
+      if (numFrames > 0) metricsObserve(METRIC_DSP_US, cycles / cyclesPerUs);
+
+      s_frames = s_frames + numFrames;
+      if (err != ESP_OK || numFrames == 0) break;  // queue drained
+    }
+  }
+}
+
+// Spectrum of the unweighted signal, one bus block at a time. Below the capture
+// task's priority: it runs whenever the capture task sleeps, and if it ever
+// falls AUDIO_BUS_DEPTH blocks behind it skips ahead instead of stalling capture.
+static void bandsTask(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while (const AudioBus::Block *block = s_bus.read(s_bandsReader)) {
+      bandsFeed(block->data, block->len);
+      s_bus.release(s_bandsReader);
+    }
+  }
+}
+
+void audioInit(Weighting weighting) {
+  s_weighting = weighting;
+  // Internal RAM for the DSP's sake; PSRAM if that is short.
+  if (!s_bus.begin(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) &&
+      !s_bus.begin(MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)) {
+    LOGE(LOG_AUDIO, "frame bus allocation failed");
+    return;
+  }
+  if (!installI2S()) return;  // stay silent at -60 dBFS rather than crash
+  levelStatsInit();
+  if (bandsInit()) {
+    s_bandsReader = s_bus.subscribe();
+    xTaskCreatePinnedToCore(bandsTask, "bands", BANDS_TASK_STACK, nullptr,
+                            BANDS_TASK_PRIORITY, &s_bandsTask, AUDIO_TASK_CORE);
+  }
+
+  // Create the consumers before enabling the channel so the first ISR can wake them.
+  xTaskCreatePinnedToCore(captureTask, "audio", AUDIO_TASK_STACK, nullptr,
+                          AUDIO_TASK_PRIORITY, &s_task, AUDIO_TASK_CORE);
+  i2s_channel_enable(s_rx);
+}
+
+float audioGetDbFS() { return s_dbFS; }
+uint32_t audioGetOverruns() { return s_overruns; }
+uint32_t audioGetFrames() { return s_frames; }
+FrameBusStats audioGetBandsBusStats() {
+  return s_bandsReader >= 0 ? s_bus.stats(s_bandsReader) : FrameBusStats{};
+}
+void audioSetWeighting(Weighting weighting) { s_weighting = weighting; }
+Weighting audioGetWeighting() { return s_weighting; }
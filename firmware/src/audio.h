@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "framebus.h"
+#include "weighting.h"
+
+// Continuous microphone capture. A dedicated FreeRTOS task, pinned to the core
+// that does NOT run loop(), drains the I2S DMA ring back-to-back and feeds every
+// frame into the energy accumulator — so the reported level covers 100% of the
+// signal and is unaffected by ws.loop(), display redraws or a blocking OTA download.
+// DMA blocks are read straight into a FrameBus (framebus.h); further analysis
+// stages (the octave-band analyzer so far) consume them from their own tasks
+// without a copy or a second I2S read.
+
+// Install the I2S driver and start the capture task. Call once in setup(), after
+// the ES8311 is configured. `weighting` selects the level meter's curve.
+void audioInit(Weighting weighting);
+
+// Latest smoothed, frequency-weighted level in dBFS (refreshed every
+// DB_CALC_INTERVAL ms of audio). Safe to call from any task.
+float audioGetDbFS();
+
+// Switch the weighting curve; takes effect at the next DMA block.
+void audioSetWeighting(Weighting weighting);
+Weighting audioGetWeighting();
+
+// DMA overrun events since boot: the ring filled before the capture task drained
+// it, so frames were dropped. Should stay at 0 in the field.
+uint32_t audioGetOverruns();
+
+// Total frames measured since boot (SAMPLE_RATE per second when gap-free).
+uint32_t audioGetFrames();
+
+// Frame-bus accounting of the band analyzer: blocks read, blocks it missed by
+// lagging more than AUDIO_BUS_DEPTH behind the capture, current / worst lag.
+FrameBusStats audioGetBandsBusStats();
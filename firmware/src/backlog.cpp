@@ -0,0 +1,76 @@
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+#include "config.h"
+#include "backlog.h"
+#include "telemetry.h"
+#include "wallclock.h"
+#include "logring.h"
+
+static TelemetryReading *s_ring = nullptr;  // BACKLOG_CAPACITY entries in PSRAM
+static size_t s_head = 0;  // oldest
+static size_t s_count = 0;
+static uint32_t s_dropped = 0;
+
+bool backlogInit() {
+  size_t bytes = BACKLOG_CAPACITY * sizeof(TelemetryReading);
+  s_ring = (TelemetryReading *)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!s_ring) {
+    LOGW(LOG_BACKLOG, "no PSRAM for %u KB; outages will lose readings", (unsigned)(bytes / 1024));
+    return false;
+  }
+  LOGI(LOG_BACKLOG, "%u readings (%u KB PSRAM)", (unsigned)BACKLOG_CAPACITY, (unsigned)(bytes / 1024));
+  return true;
+}
+
+void backlogPush(uint32_t ms, float dbFS) {
+  if (!s_ring) return;
+  if (s_count == BACKLOG_CAPACITY) {  // full: drop the oldest
+    s_head = (s_head + 1) % BACKLOG_CAPACITY;
+    s_count--;
+    if (s_dropped++ == 0) LOGW(LOG_BACKLOG, "full, dropping oldest readings");
+  }
+  TelemetryReading &r = s_ring[(s_head + s_count) % BACKLOG_CAPACITY];
+  r.ms = ms;
+  if (wallclockNow(r.unixSec, r.unixMs)) {
+    // Back to when the reading was taken.
+    uint64_t t = (uint64_t)r.unixSec * 1000 + r.unixMs - (uint32_t)(millis() - ms);
+    r.unixSec = (uint32_t)(t / 1000);
+    r.unixMs = (uint16_t)(t % 1000);
+  } else {
+    r.unixSec = r.unixMs = 0;
+  }
+  r.db10 = telemetryDb10(dbFS);
+  s_count++;
+}
+
+size_t backlogCount() { return s_count; }
+
+uint32_t backlogDropped() { return s_dropped; }
+
+void backlogClear() {
+  s_head = 0;
+  s_count = 0;
+}
+
+size_t backlogEncode(uint8_t *out, size_t cap, Weighting weighting) {
+  if (s_count == 0) return 0;
+
+  // One frame: consecutive readings within a u16 dt of the first, all with or
+  // all without wall-clock time (the clock may get set mid-outage).
+  TelemetryReading batch[TELEMETRY_MAX_READINGS];
+  size_t n = 0;
+  const TelemetryReading &first = s_ring[s_head];
+  while (n < TELEMETRY_MAX_READINGS && n < s_count) {
+    const TelemetryReading &r = s_ring[(s_head + n) % BACKLOG_CAPACITY];
+    if (n > 0 && (r.ms - first.ms > 0xFFFF || (r.unixSec != 0) != (first.unixSec != 0))) break;
+    batch[n++] = r;
+  }
+
+  size_t len = telemetryEncodeReplay(out, cap, weighting, batch, n, s_count - n, BACKLOG_CAPACITY, s_dropped);
+  if (len > 0) {
+    s_head = (s_head + n) % BACKLOG_CAPACITY;
+    s_count -= n;
+  }
+  return len;
+}
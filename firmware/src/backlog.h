@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "weighting.h"
+
+// Store-and-forward for level readings taken while the websocket is down (router
+// reboot, ISP blip). A fixed ring of BACKLOG_CAPACITY readings in PSRAM fills
+// during the outage, dropping the oldest when full, and is replayed after
+// reconnect as bin1 frames (telemetry.h) at most one per
+// BACKLOG_DRAIN_INTERVAL_MS, so catching up never starves live telemetry.
+//
+// Replayed frames carry two extra sections:
+//   TELEMETRY_TAG_WALLCLOCK  u32 unix seconds, u16 ms of the frame's t0 (the
+//                            readings' own time; absent if the clock was unset)
+//   TELEMETRY_TAG_BACKLOG    u32 readings still queued, u32 capacity,
+//                            u32 readings dropped (ring full) since boot
+// The server records them as history only; they never drive the volume loop.
+
+// Allocate the ring. Call once in setup(). Returns false if PSRAM is short (the
+// backlog is then disabled and outages lose readings, as before).
+bool backlogInit();
+
+// Queue one reading taken at device millis() ms (now, or a reading that was
+// batched for a frame when the socket dropped). loop() only.
+void backlogPush(uint32_t ms, float dbFS);
+
+// Readings queued / dropped since boot because the ring was full.
+size_t backlogCount();
+uint32_t backlogDropped();
+
+// Discard everything queued (e.g. the server cannot take bin1).
+void backlogClear();
+
+// Encode the oldest queued readings (up to TELEMETRY_MAX_READINGS, within one
+// frame's time span) as a bin1 frame and remove them. Returns the frame length,
+// or 0 if nothing is queued.
+size_t backlogEncode(uint8_t *out, size_t cap, Weighting weighting);
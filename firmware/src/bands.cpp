@@ -0,0 +1,136 @@
+#include <Arduino.h>
+#include <esp_dsp.h>
+#include <freertos/FreeRTOS.h>
+
+#include "config.h"
+#include "bands.h"
+#include "logring.h"
+
+const uint16_t BANDS_CENTER_HZ[BANDS_COUNT] = {63, 125, 250, 500, 1000, 2000, 4000};
+
+// esp-dsp's S3 FFT uses 128-bit loads: keep its buffers 16-byte aligned.
+alignas(16) static float s_fft[BANDS_FFT_SIZE * 2];  // interleaved re/im
+alignas(16) static float s_window[BANDS_FFT_SIZE];
+static int16_t s_history[BANDS_FFT_SIZE];  // last FFT_SIZE samples, oldest first
+static size_t s_fill = 0;
+
+// FFT bins [s_binLo[b], s_binHi[b]] make up band b.
+static uint16_t s_binLo[BANDS_COUNT], s_binHi[BANDS_COUNT];
+// Converts a per-frame bin power sum to mean square relative to full scale.
+static float s_scale = 0;
+static bool s_ready = false;
+
+// Shared with bandsTake(); guarded by s_mux (held only for a short copy).
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static float s_power[BANDS_COUNT];
+static uint32_t s_frames = 0;
+
+// CPU cost bookkeeping for the periodic "[bands]" log line.
+static uint32_t s_costCycles = 0;
+static uint32_t s_costFrames = 0;
+
+bool bandsInit() {
+  if (dsps_fft2r_init_fc32(NULL, BANDS_FFT_SIZE) != ESP_OK) {
+    LOGE(LOG_AUDIO, "FFT init failed — band analysis disabled");
+    return false;
+  }
+  dsps_wind_hann_f32(s_window, BANDS_FFT_SIZE);
+
+  // Parseval with a one-sided spectrum: mean square = 2 * sum|X|^2 / (N * sum w^2).
+  float sumW2 = 0;
+  for (int i = 0; i < BANDS_FFT_SIZE; i++) sumW2 += s_window[i] * s_window[i];
+  s_scale = 2.0f / (BANDS_FFT_SIZE * sumW2 * 32767.0f * 32767.0f);
+
+  // Octave edges at fc/sqrt(2) .. fc*sqrt(2), rounded to bin boundaries.
+  const float binHz = (float)SAMPLE_RATE / BANDS_FFT_SIZE;
+  for (int b = 0; b < BANDS_COUNT; b++) {
+    int lo = (int)ceilf(BANDS_CENTER_HZ[b] * 0.70710678f / binHz);
+    int hi = (int)ceilf(BANDS_CENTER_HZ[b] * 1.41421356f / binHz) - 1;
+    if (lo < 1) lo = 1;  // never include DC
+    if (hi < lo) hi = lo;
+    if (hi > BANDS_FFT_SIZE / 2 - 1) hi = BANDS_FFT_SIZE / 2 - 1;
+    s_binLo[b] = lo;
+    s_binHi[b] = hi;
+  }
+
+  s_ready = true;
+  return true;
+}
+
+static void analyzeFrame() {
+  uint32_t t0 = ESP.getCycleCount();
+
+  for (int i = 0; i < BANDS_FFT_SIZE; i++) {
+    s_fft[i * 2] = s_history[i] * s_window[i];
+    s_fft[i * 2 + 1] = 0;
+  }
+  dsps_fft2r_fc32(s_fft, BANDS_FFT_SIZE);
+  dsps_bit_rev_fc32(s_fft, BANDS_FFT_SIZE);
+
+  float power[BANDS_COUNT];
+  for (int b = 0; b < BANDS_COUNT; b++) {
+    float p = 0;
+    for (int k = s_binLo[b]; k <= s_binHi[b]; k++) {
+      float re = s_fft[k * 2], im = s_fft[k * 2 + 1];
+      p += re * re + im * im;
+    }
+    power[b] = p;
+  }
+
+  portENTER_CRITICAL(&s_mux);
+  for (int b = 0; b < BANDS_COUNT; b++) s_power[b] += power[b];
+  s_frames++;
+  portEXIT_CRITICAL(&s_mux);
+
+  // Real-time headroom: CPU time spent per second of audio, logged every ~10s.
+  s_costCycles += ESP.getCycleCount() - t0;
+  const uint32_t framesPerSec = SAMPLE_RATE / BANDS_FFT_HOP;
+  if (++s_costFrames >= framesPerSec * 10) {
+    uint32_t usPerSec = s_costCycles / ESP.getCpuFreqMHz() / 10;
+    LOGD(LOG_AUDIO, "bands: %u us CPU per second of audio (%.2f%% of one core)",
+                  (unsigned)usPerSec, usPerSec / 10000.0f);
+    s_costCycles = 0;
+    s_costFrames = 0;
+  }
+}
+
+void bandsFeed(const int16_t *samples, size_t count) {
+  if (!s_ready) return;
+  while (count > 0) {
+    size_t n = BANDS_FFT_SIZE - s_fill;
+    if (n > count) n = count;
+    memcpy(&s_history[s_fill], samples, n * sizeof(int16_t));
+    s_fill += n;
+    samples += n;
+    count -= n;
+
+    if (s_fill == BANDS_FFT_SIZE) {
+      analyzeFrame();
+      // Slide by one hop so consecutive frames overlap.
+      memmove(s_history, &s_history[BANDS_FFT_HOP],
+              (BANDS_FFT_SIZE - BANDS_FFT_HOP) * sizeof(int16_t));
+      s_fill = BANDS_FFT_SIZE - BANDS_FFT_HOP;
+    }
+  }
+}
+
+bool bandsTake(int8_t out[BANDS_COUNT]) {
+  float power[BANDS_COUNT];
+  uint32_t frames;
+  portENTER_CRITICAL(&s_mux);
+  frames = s_frames;
+  for (int b = 0; b < BANDS_COUNT; b++) {
+    power[b] = s_power[b];
+    s_power[b] = 0;
+  }
+  s_frames = 0;
+  portEXIT_CRITICAL(&s_mux);
+  if (frames == 0) return false;
+
+  for (int b = 0; b < BANDS_COUNT; b++) {
+    float ms = power[b] * s_scale / frames;
+    float db = ms > 1e-12f ? 10.0f * log10f(ms) : -120.0f;
+    out[b] = (int8_t)lroundf(db < -120.0f ? -120.0f : (db > 0.0f ? 0.0f : db));
+  }
+  return true;
+}
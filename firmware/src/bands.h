@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Octave-band energy analyzer. Runs in its own task, fed from the audio frame
+// bus (audio.cpp): every BANDS_FFT_HOP new samples it windows the last
+// BANDS_FFT_SIZE samples (Hann, 50% overlap) and takes an esp-dsp FFT (SIMD on
+// the S3), accumulating power per octave band.
+// The server uses the spectrum to tell crowd noise from the venue's own music.
+
+// Octave bands centred on 63 Hz .. 4 kHz (the 8 kHz band would straddle Nyquist).
+#define BANDS_COUNT 7
+extern const uint16_t BANDS_CENTER_HZ[BANDS_COUNT];
+
+// Allocate FFT tables and buffers. Call once before the capture task starts.
+bool bandsInit();
+
+// Feed mono samples (any block length). Band analyzer task only.
+void bandsFeed(const int16_t *samples, size_t count);
+
+// Average level per band in whole dBFS since the previous call, then restart
+// the average. Returns false if no FFT frame completed in between. Any task.
+bool bandsTake(int8_t out[BANDS_COUNT]);
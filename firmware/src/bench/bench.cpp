@@ -0,0 +1,270 @@
+// DSP kernel micro-benchmarks: the level meter's energy, smoothing, weighting
+// and spectrum kernels and the capture frame bus, per block size and variant,
+// as one CSV table.
+//
+//   target: pio run -e bench -t upload && pio device monitor   (cycle counter)
+//   host:   pio run -e native_bench && .pio/build/native_bench/program > host.csv
+//
+// Columns: target,kernel,variant,block,ns_per_block,cycles_per_block,ns_per_sample,rel_err
+// cycles_per_block is the CPU cycle counter on the S3 and empty on the host.
+// rel_err is against the exact (int64) or double reference for the same input.
+// Log lines ("   1234 E [audio] ...") go to Serial: on the target they share
+// the port with the table, so keep the lines that start with the target name
+// or '#'. On the host Serial is stderr.
+
+#include <Arduino.h>
+#include <float.h>
+#include <stdarg.h>
+#include <math.h>
+
+#include "../config.h"
+#include "../energy.h"
+#include "../weighting.h"
+#include "../bands.h"
+#include "../framebus.h"
+#include "../logring.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+#define BENCH_TARGET "esp32s3"
+#define BENCH_FFT    "esp-dsp"
+#else
+#include <chrono>
+#define BENCH_TARGET "host"
+#define BENCH_FFT    "portable"  // native/shim/esp_dsp.h
+#endif
+
+#define BENCH_MAX_BLOCK 1024
+#define BENCH_REPS      50    // best of N: filters out interrupts / scheduler noise
+#define BENCH_SAMPLES   4096  // samples processed per rep (block calls = this / block)
+
+static const size_t BLOCKS[] = {32, 64, 128, 256, 512, 1024};
+
+static int16_t s_signal[BENCH_MAX_BLOCK] __attribute__((aligned(16)));
+static float s_scratch[BENCH_MAX_BLOCK];
+static volatile double s_sink;  // keeps results observable to the optimiser
+
+static void emit(const char *fmt, ...) {
+  char line[160];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(line, sizeof(line), fmt, ap);
+  va_end(ap);
+#if defined(ARDUINO_ARCH_ESP32)
+  Serial.println(line);
+#else
+  puts(line);
+#endif
+}
+
+// Best-of-BENCH_REPS time for `calls` invocations of fn, divided per call.
+template <typename F>
+static void measure(const char *kernel, const char *variant, size_t block, size_t calls, double relErr, F fn) {
+  double bestNs = DBL_MAX;
+#if defined(ARDUINO_ARCH_ESP32)
+  uint32_t bestCycles = UINT32_MAX;
+#endif
+  for (int r = 0; r < BENCH_REPS; r++) {
+#if defined(ARDUINO_ARCH_ESP32)
+    uint32_t c0 = ESP.getCycleCount();
+    for (size_t i = 0; i < calls; i++) fn();
+    uint32_t c = ESP.getCycleCount() - c0;
+    if (c < bestCycles) bestCycles = c;
+    bestNs = bestCycles * 1000.0 / ESP.getCpuFreqMHz();
+#else
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < calls; i++) fn();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    if (ns < bestNs) bestNs = ns;
+#endif
+  }
+  double nsPerCall = bestNs / calls;
+  char cycles[16] = "";
+#if defined(ARDUINO_ARCH_ESP32)
+  snprintf(cycles, sizeof(cycles), "%.0f", (double)bestCycles / calls);
+#endif
+  char err[16] = "";
+  if (relErr >= 0) snprintf(err, sizeof(err), "%.2e", relErr);
+  emit("%s,%s,%s,%u,%.1f,%s,%.2f,%s", BENCH_TARGET, kernel, variant, (unsigned)block, nsPerCall,
+       cycles, nsPerCall / block, err);
+}
+
+static double relErr(double v, double ref) { return ref != 0 ? fabs(v - ref) / fabs(ref) : 0; }
+
+// Filter + square, accumulating in double exactly as the capture task does.
+static double weightedDouble(BiquadCascade &f, const int16_t *x, size_t n) {
+  double acc = 0;
+  for (size_t i = 0; i < n; i++) {
+    float y = f.process((float)x[i]);
+    acc += (double)(y * y);
+  }
+  return acc;
+}
+
+static void benchEnergy() {
+  for (size_t block : BLOCKS) {
+    size_t calls = BENCH_SAMPLES / block;
+    double exact = (double)energyInt64(s_signal, block);
+    measure("energy", "double", block, calls, relErr(energyDouble(s_signal, block), exact),
+            [&] { s_sink = energyDouble(s_signal, block); });
+    measure("energy", "float", block, calls, relErr(energyFloat(s_signal, block), exact),
+            [&] { s_sink = energyFloat(s_signal, block); });
+    measure("energy", "int64", block, calls, 0,
+            [&] { s_sink = (double)energyInt64(s_signal, block); });
+    measure("energy", "simd_f32", block, calls, relErr(energySimd(s_signal, block, s_scratch), exact),
+            [&] { s_sink = energySimd(s_signal, block, s_scratch); });
+    // The level meter's kernel: S3 vector MACs on target, scalar int64 on the host.
+    measure("energy", ENERGY_PIE ? "simd_s16" : "int16", block, calls,
+            relErr((double)energyInt16(s_signal, block), exact),
+            [&] { s_sink = (double)energyInt16(s_signal, block); });
+    measure("energy", "int16_stride2", block / 2, calls, 0,
+            [&] { s_sink = (double)energyInt16(s_signal, block / 2, 2); });
+  }
+}
+
+static void benchWeighting(Weighting w) {
+  uint8_t count;
+  const Biquad *sections = weightingSections(w, count);
+  char kernel[16];
+  snprintf(kernel, sizeof(kernel), "weighting_%s", weightingName(w));
+  for (size_t block : BLOCKS) {
+    size_t calls = BENCH_SAMPLES / block;
+    BiquadCascade f;
+    f.set(sections, count);
+    double ref = weightedDouble(f, s_signal, block);
+    f.reset();
+    double approx = f.sumSquares(s_signal, block);
+    measure(kernel, "double", block, calls, 0, [&] { s_sink = weightedDouble(f, s_signal, block); });
+    measure(kernel, "float", block, calls, relErr(approx, ref), [&] { s_sink = f.sumSquares(s_signal, block); });
+  }
+}
+
+// publishWindow()'s energy EMA, per window.
+static void benchSmoothing() {
+  const size_t windows = 1000;
+  double refD = 1e6;
+  float refF = 1e6f;
+  for (size_t i = 0; i < windows; i++) {
+    double ms = 1e6 + (i % 7) * 1e5;
+    refD = AUDIO_ENERGY_ALPHA * ms + (1.0 - AUDIO_ENERGY_ALPHA) * refD;
+    refF = (float)AUDIO_ENERGY_ALPHA * (float)ms + (1.0f - (float)AUDIO_ENERGY_ALPHA) * refF;
+  }
+  double avgD = 1e6;
+  float avgF = 1e6f;
+  size_t i = 0;
+  measure("smoothing", "double", 1, windows, 0, [&] {
+    double ms = 1e6 + (i++ % 7) * 1e5;
+    avgD = AUDIO_ENERGY_ALPHA * ms + (1.0 - AUDIO_ENERGY_ALPHA) * avgD;
+    s_sink = avgD;
+  });
+  measure("smoothing", "float", 1, windows, relErr(refF, refD), [&] {
+    float ms = 1e6f + (i++ % 7) * 1e5f;
+    avgF = (float)AUDIO_ENERGY_ALPHA * ms + (1.0f - (float)AUDIO_ENERGY_ALPHA) * avgF;
+    s_sink = avgF;
+  });
+}
+
+// bandsFeed(): FFT every BANDS_FFT_HOP samples, so cost is amortised per block.
+static void benchSpectrum() {
+  if (!bandsInit()) return;
+  for (size_t block : BLOCKS) {
+    size_t calls = BENCH_SAMPLES / block;
+    measure("spectrum", BENCH_FFT, block, calls, -1, [&] { bandsFeed(s_signal, block); });
+  }
+  int8_t bands[BANDS_COUNT];
+  bandsTake(bands);
+}
+
+// Capture -> consumers hand-off per DMA block: FrameBus (publish, then every
+// consumer reads and releases the same block) against a copy per consumer.
+// rel_err is 0 when every consumer saw every block intact, 1 otherwise.
+template <size_t Block>
+static void benchFrameBusBlock(size_t consumers) {
+  static FrameBus<int16_t, Block, AUDIO_BUS_DEPTH, AUDIO_BUS_CONSUMERS> bus;
+  static int ids[AUDIO_BUS_CONSUMERS];
+  static int16_t copies[AUDIO_BUS_CONSUMERS][Block] __attribute__((aligned(16)));
+  static bool ready = false;
+  if (!ready) {
+    if (!bus.begin(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)) return;
+    for (size_t c = 0; c < AUDIO_BUS_CONSUMERS; c++) ids[c] = bus.subscribe();
+    ready = true;
+  }
+  size_t calls = BENCH_SAMPLES / Block;
+  char variant[20];
+  uint32_t sum = 0;
+  bool intact = true;
+
+  snprintf(variant, sizeof(variant), "zero_copy_x%u", (unsigned)consumers);
+  auto zeroCopy = [&] {
+    memcpy(bus.acquire(), s_signal, Block * sizeof(int16_t));  // stands in for the I2S read
+    bus.publish(Block);
+    for (size_t c = 0; c < AUDIO_BUS_CONSUMERS; c++) {  // idle consumers keep up too
+      const auto *b = bus.read(ids[c]);
+      if (c < consumers) {
+        sum += (uint16_t)b->data[Block - 1];
+        intact = intact && b->len == Block && b->data[Block - 1] == s_signal[Block - 1];
+      }
+      bus.release(ids[c]);
+    }
+  };
+  zeroCopy();
+  for (size_t c = 0; c < AUDIO_BUS_CONSUMERS; c++) intact = intact && bus.stats(ids[c]).overruns == 0;
+  measure("framebus", variant, Block, calls, intact ? 0 : 1, zeroCopy);
+
+  static int16_t capture[Block] __attribute__((aligned(16)));
+  snprintf(variant, sizeof(variant), "copy_x%u", (unsigned)consumers);
+  measure("framebus", variant, Block, calls, -1, [&] {
+    memcpy(capture, s_signal, sizeof(capture));
+    for (size_t c = 0; c < consumers; c++) {
+      memcpy(copies[c], capture, sizeof(capture));
+      sum += (uint16_t)copies[c][Block - 1];
+    }
+  });
+  s_sink = sum;
+}
+
+static void benchFrameBus() {
+  for (size_t consumers = 1; consumers <= AUDIO_BUS_CONSUMERS; consumers++) {
+    benchFrameBusBlock<64>(consumers);
+    benchFrameBusBlock<I2S_DMA_FRAME_NUM>(consumers);
+    benchFrameBusBlock<BENCH_MAX_BLOCK>(consumers);
+  }
+}
+
+static void runSuite() {
+  // Music-like test signal: a 440 Hz tone plus LCG noise, well inside full scale.
+  uint32_t lcg = 12345;
+  for (int i = 0; i < BENCH_MAX_BLOCK; i++) {
+    lcg = lcg * 1664525u + 1013904223u;
+    s_signal[i] = (int16_t)(8000.0f * sinf(2.0f * (float)M_PI * 440.0f * i / SAMPLE_RATE) +
+                            (int16_t)(lcg >> 16) / 16);
+  }
+
+  emit("target,kernel,variant,block,ns_per_block,cycles_per_block,ns_per_sample,rel_err");
+  benchEnergy();
+  benchWeighting(WEIGHTING_A);
+  benchWeighting(WEIGHTING_K);
+  benchSmoothing();
+  benchSpectrum();
+  benchFrameBus();
+  emit("# done");
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+void setup() {
+  Serial.begin(115200);
+  delay(2000);  // let the USB CDC port enumerate
+  logInit();
+  runSuite();
+  logFlush();
+}
+
+void loop() { delay(1000); }
+#else
+int main() {
+  logInit();
+  runSuite();
+  logFlush();
+  fflush(stdout);
+  std::quick_exit(0);  // the log task is still parked in ulTaskNotifyTake()
+}
+#endif
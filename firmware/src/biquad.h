@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Second-order IIR section with a0 normalised to 1:
+//   y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+struct Biquad {
+  float b0, b1, b2, a1, a2;
+};
+
+#define BIQUAD_MAX_SECTIONS 4
+
+// A cascade of Biquad sections run in transposed direct form II: two float
+// state words per section (the S3 FPU is single precision — no double here).
+// The coefficient table is borrowed, not copied; it must outlive the cascade.
+struct BiquadCascade {
+  const Biquad *sections = nullptr;
+  uint8_t count = 0;
+  float z1[BIQUAD_MAX_SECTIONS] = {};
+  float z2[BIQUAD_MAX_SECTIONS] = {};
+
+  void set(const Biquad *s, uint8_t n) {
+    sections = s;
+    count = n > BIQUAD_MAX_SECTIONS ? BIQUAD_MAX_SECTIONS : n;
+    reset();
+  }
+
+  void reset() {
+    for (uint8_t i = 0; i < BIQUAD_MAX_SECTIONS; i++) z1[i] = z2[i] = 0.0f;
+  }
+
+  inline float process(float x) {
+    for (uint8_t i = 0; i < count; i++) {
+      const Biquad &q = sections[i];
+      float y = q.b0 * x + z1[i];
+      z1[i] = q.b1 * x - q.a1 * y + z2[i];
+      z2[i] = q.b2 * x - q.a2 * y;
+      x = y;
+    }
+    return x;
+  }
+
+  // Filter a block of samples and return the sum of squares of the output (in
+  // the input's units, so full scale stays 32767). An empty cascade passes through.
+  float sumSquares(const int16_t *in, size_t n) {
+    float acc = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+      float y = process((float)in[i]);
+      acc += y * y;
+    }
+    return acc;
+  }
+};
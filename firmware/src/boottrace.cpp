@@ -0,0 +1,26 @@
+#include <Arduino.h>
+
+#include "boottrace.h"
+#include "logring.h"
+
+static struct {
+  const char *name;
+  uint32_t ms;
+} s_phases[BOOT_MAX_PHASES];
+static size_t s_count = 0;
+
+void bootMark(const char *phase) {
+  uint32_t now = millis();
+  uint32_t prev = s_count > 0 ? s_phases[s_count - 1].ms : 0;
+  LOGI(LOG_SYS, "boot: %s at %lu ms (+%lu)", phase, (unsigned long)now, (unsigned long)(now - prev));
+  if (s_count == BOOT_MAX_PHASES) return;
+  s_phases[s_count].name = phase;
+  s_phases[s_count].ms = now;
+  s_count++;
+}
+
+size_t bootPhaseCount() { return s_count; }
+
+const char *bootPhaseName(size_t i) { return i < s_count ? s_phases[i].name : ""; }
+
+uint32_t bootPhaseMs(size_t i) { return i < s_count ? s_phases[i].ms : 0; }
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Boot-phase tracer. setup() marks the end of each init phase with bootMark();
+// the list (ms since boot at each mark) goes to the server in "register" so
+// boot-to-online time can be broken down across the fleet. Marks past
+// BOOT_MAX_PHASES are dropped.
+
+#define BOOT_MAX_PHASES 16
+
+// Record that `phase` (a string literal) finished now.
+void bootMark(const char *phase);
+
+size_t bootPhaseCount();
+const char *bootPhaseName(size_t i);
+uint32_t bootPhaseMs(size_t i);
@@ -0,0 +1,104 @@
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+#include "canvas.h"
+#include "logring.h"
+
+DirtyCanvas::DirtyCanvas(int16_t w, int16_t h, Arduino_TFT *panel, Arduino_DataBus *bus)
+    : Arduino_GFX(w, h), _panel(panel), _bus(bus),
+      _tilesX((w + CANVAS_TILE - 1) / CANVAS_TILE), _tilesY((h + CANVAS_TILE - 1) / CANVAS_TILE) {}
+
+bool DirtyCanvas::begin(int32_t) {
+  if (_fb) return true;
+  size_t bytes = (size_t)WIDTH * HEIGHT * sizeof(uint16_t);
+  _fb = (uint16_t *)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!_fb) _fb = (uint16_t *)malloc(bytes);
+  _dirty = (uint8_t *)calloc(_tilesX * _tilesY, 1);
+  if (!_fb || !_dirty) {
+    LOGE(LOG_SYS, "framebuffer allocation failed");
+    return false;
+  }
+  memset(_fb, 0, bytes);  // matches the panel's black fillScreen at init
+  return true;
+}
+
+void DirtyCanvas::markSpan(int16_t y, int16_t x0, int16_t x1) {
+  uint8_t *row = _dirty + (y / CANVAS_TILE) * _tilesX;
+  for (int16_t t = x0 / CANVAS_TILE; t <= x1 / CANVAS_TILE; t++) row[t] = 1;
+}
+
+void DirtyCanvas::writePixelPreclipped(int16_t x, int16_t y, uint16_t color) {
+  uint16_t *p = _fb + (int32_t)y * WIDTH + x;
+  if (*p == color) return;
+  *p = color;
+  _dirty[(y / CANVAS_TILE) * _tilesX + x / CANVAS_TILE] = 1;
+}
+
+void DirtyCanvas::writeFillRectPreclipped(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  for (int16_t row = y; row < y + h; row++) {
+    uint16_t *p = _fb + (int32_t)row * WIDTH + x;
+    int16_t first = -1, last = -1;
+    for (int16_t i = 0; i < w; i++) {
+      if (p[i] != color) {
+        p[i] = color;
+        if (first < 0) first = i;
+        last = i;
+      }
+    }
+    if (first >= 0) markSpan(row, x + first, x + last);
+  }
+}
+
+void DirtyCanvas::writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  if (y < 0 || y >= HEIGHT || w <= 0) return;
+  if (x < 0) { w += x; x = 0; }
+  if (x + w > WIDTH) w = WIDTH - x;
+  if (w > 0) writeFillRectPreclipped(x, y, w, 1, color);
+}
+
+void DirtyCanvas::writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  if (x < 0 || x >= WIDTH || h <= 0) return;
+  if (y < 0) { h += y; y = 0; }
+  if (y + h > HEIGHT) h = HEIGHT - y;
+  if (h > 0) writeFillRectPreclipped(x, y, 1, h, color);
+}
+
+void DirtyCanvas::invalidate() {
+  if (_dirty) memset(_dirty, 1, _tilesX * _tilesY);
+}
+
+uint32_t DirtyCanvas::flush() {
+  if (!_fb) return 0;
+  uint32_t t0 = micros();
+  uint32_t bytes = 0;
+  bool started = false;
+
+  for (int16_t ty = 0; ty < _tilesY; ty++) {
+    uint8_t *row = _dirty + ty * _tilesX;
+    for (int16_t tx = 0; tx < _tilesX;) {
+      if (!row[tx]) { tx++; continue; }
+      // Merge a horizontal run of damaged tiles into one address window.
+      int16_t end = tx;
+      while (end < _tilesX && row[end]) row[end++] = 0;
+
+      int16_t x = tx * CANVAS_TILE, y = ty * CANVAS_TILE;
+      int16_t w = (end * CANVAS_TILE > WIDTH ? WIDTH : end * CANVAS_TILE) - x;
+      int16_t h = (y + CANVAS_TILE > HEIGHT ? HEIGHT : y + CANVAS_TILE) - y;
+      if (!started) {
+        _panel->startWrite();
+        started = true;
+      }
+      _panel->writeAddrWindow(x, y, w, h);
+      for (int16_t r = 0; r < h; r++) {
+        _bus->writePixels(_fb + (int32_t)(y + r) * WIDTH + x, w);
+      }
+      bytes += (uint32_t)w * h * sizeof(uint16_t);
+      tx = end;
+    }
+  }
+  if (started) _panel->endWrite();
+
+  _lastBytes = bytes;
+  _lastMicros = micros() - t0;
+  return bytes;
+}
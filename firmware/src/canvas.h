@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Arduino_GFX_Library.h>
+
+// PSRAM framebuffer for the status screen that only sends what changed.
+//
+// Drawing goes into RAM; a pixel write that doesn't change the stored colour is
+// a no-op, otherwise its 16x16 tile is marked damaged. flush() then pushes the
+// damaged tiles (merged into horizontal runs) to the panel inside ONE bus
+// transaction. Redrawing an unchanged widget therefore costs no QSPI time, and
+// since the panel only ever sees finished frames there is no fillRect flicker.
+//
+// Other code may still draw straight to the panel (provisioning / OTA pages);
+// call invalidate() before returning to the canvas so the next flush repaints all.
+
+#define CANVAS_TILE 16  // multiple of 2: the SH8601 needs even column windows
+
+class DirtyCanvas : public Arduino_GFX {
+public:
+  DirtyCanvas(int16_t w, int16_t h, Arduino_TFT *panel, Arduino_DataBus *bus);
+
+  // Allocates the framebuffer (PSRAM when present). The panel must already be up.
+  bool begin(int32_t speed = GFX_NOT_DEFINED) override;
+
+  void writePixelPreclipped(int16_t x, int16_t y, uint16_t color) override;
+  void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override;
+  void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+  void writeFillRectPreclipped(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override;
+
+  // Mark the whole screen damaged (the panel shows something else).
+  void invalidate();
+
+  // Push damaged tiles to the panel. Returns the pixel bytes sent (0 = nothing changed).
+  uint32_t flush();
+
+  // Cost of the most recent flush(), for diagnostics.
+  uint32_t lastFlushBytes() const { return _lastBytes; }
+  uint32_t lastFlushMicros() const { return _lastMicros; }
+
+private:
+  void markSpan(int16_t y, int16_t x0, int16_t x1);  // inclusive pixel columns
+
+  Arduino_TFT *_panel;
+  Arduino_DataBus *_bus;
+  uint16_t *_fb = nullptr;
+  uint8_t *_dirty = nullptr;  // one byte per tile, row-major
+  int16_t _tilesX, _tilesY;
+  uint32_t _lastBytes = 0;
+  uint32_t _lastMicros = 0;
+};
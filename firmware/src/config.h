@@ -1,19 +1,71 @@
 #pragma once
 
-// Audio settings
+// Audio settings. SAMPLE_RATE may be overridden for host builds (the weighting
+// tests design the filters at 48 kHz too).
+#ifndef SAMPLE_RATE
 #define SAMPLE_RATE        16000
+#endif
 #define SAMPLE_BITS        16
-#define I2S_READ_BUF_SIZE  1024    // Bytes per I2S read
-#define DB_CALC_INTERVAL   100     // ms between dB calculations
-#define DB_SEND_INTERVAL   500     // ms between WebSocket sends
+// I2S DMA ring (RX-only, mono 16-bit): I2S_DMA_DESC_NUM buffers of
+// I2S_DMA_FRAME_NUM frames each. 8 x 256 = 128ms of slack at 16kHz.
+#define I2S_DMA_DESC_NUM   8
+#define I2S_DMA_FRAME_NUM  256
+#define DB_CALC_INTERVAL   100     // ms of audio per level window (every frame is measured)
+#define DB_SEND_INTERVAL   500     // ms between readings (sent to the server as report.h decides)
+#define TELEMETRY_BATCH_SIZE 2     // readings per binary telemetry frame (~1s)
 // Energy-domain smoothing (short Leq) so the level tracks sustained loudness
 // instead of jumping on each transient/quiet sample. ~tau = DB_CALC_INTERVAL/alpha
 // = 100ms/0.2 = ~0.5s.
 #define AUDIO_ENERGY_ALPHA 0.2
 
-// WebSocket server (default, can be overridden via captive portal)
+// Capture task: runs on core 0 (loop() and ws.loop() run on core 1) above the
+// loop's priority, so it drains the I2S DMA ring continuously.
+#define AUDIO_TASK_CORE      0
+#define AUDIO_TASK_PRIORITY  5
+#define AUDIO_TASK_STACK     4096
+// Capture -> DSP frame bus (framebus.h): the last AUDIO_BUS_DEPTH DMA blocks stay
+// readable, so a consumer task may lag the capture by up to 8 x 16ms = 128ms
+// before it is overrun. Room for AUDIO_BUS_CONSUMERS analysis stages.
+#define AUDIO_BUS_DEPTH      8
+#define AUDIO_BUS_CONSUMERS  2
+
+// Boot-time connect task (main.cpp): WiFi wait + websocket TLS handshake during
+// setup(), on core 0 beside the capture task. mbedTLS needs a loopTask-sized stack.
+#define EARLY_CONNECT_CORE   0
+#define EARLY_CONNECT_STACK  8192
+
+// Level-meter frequency weighting: "Z" (flat), "A", "C" or "K" (BS.1770). The
+// server can change it per device ("set_weighting"); the choice persists in NVS.
+// Z keeps the calibrated quiet/loud thresholds unchanged.
+#define AUDIO_DEFAULT_WEIGHTING "Z"
+// Per-DMA-block DSP budget (weighting + energy). A 256-frame block is 16ms of
+// audio; the logged worst case is flagged if it exceeds this.
+#define AUDIO_DSP_BUDGET_US  1000
+
+// Octave-band analyzer: 512-point FFT (31.25 Hz bins), 50% overlap, band levels
+// sent with sound_level every BANDS_REPORT_INTERVAL ms.
+#define BANDS_FFT_SIZE        512
+#define BANDS_FFT_HOP         256
+#define BANDS_REPORT_INTERVAL 2000
+// The analyzer is a frame-bus consumer in its own task, below the capture task
+// on the same core, so an FFT never delays draining the DMA ring.
+#define BANDS_TASK_PRIORITY   4
+#define BANDS_TASK_STACK      4096
+
+// Percentile levels (levelstats.h): histograms of 0.5 dB bins from -100 dBFS
+// (lower levels count in the lowest bin) up to 0 dBFS.
+#define LEVELSTATS_FLOOR_DB   -100.0f
+#define LEVELSTATS_BIN_DB     0.5f
+
+// WebSocket server (default, can be overridden via captive portal). Also the OTA
+// manifest host. Build flags may point both at a local stand-in
+// (server/scripts/tls-standin.mjs), e.g. -DDEFAULT_WS_HOST='"192.168.1.20"' -DWS_PORT=8443
+#ifndef DEFAULT_WS_HOST
 #define DEFAULT_WS_HOST    "soundtrack-auto-volume.onrender.com"
+#endif
+#ifndef WS_PORT
 #define WS_PORT            443
+#endif
 #define WS_PATH            "/ws"
 #define WS_USE_SSL         true
 
@@ -33,19 +85,78 @@
 // Firmware version
 #define FW_VERSION         "2.6.0"
 
+// On-device volume control (mapper.h). Offered in "register"; when the server
+// accepts it in "registered", the device sends volume_intent messages and the
+// server only forwards them to Soundtrack and answers with volume_ack.
+// Version 2 adds ZoneConfig.levelMetric (percentile-driven zones).
+#define MAPPER_VERSION        2
+#define MAPPER_ACK_TIMEOUT_MS 10000  // an intent with no volume_ack by then has failed
+#define MAPPER_PERCENTILE_WINDOW_S 60  // levelstats window a percentile-driven zone follows
+
 // OTA (over-the-air firmware update). The device polls a manifest on the server
 // and self-updates when a newer version is published. D'ARK's beta unit ships on
 // 2.5.0 (no OTA client); OTA is exercised on the spare/dev unit first.
-#define OTA_VERSION_PATH        "/api/firmware/version"  // GET {version,url,md5,available}
+#define OTA_VERSION_PATH        "/api/firmware/version"  // GET {version,url,md5,sha256,deltas,available}
 #define OTA_INITIAL_DELAY_MS    30000UL     // wait 30s after coming online before first check
 #define OTA_CHECK_INTERVAL_MS   21600000UL  // re-check every 6 hours
 #define OTA_MAX_PROBATION_BOOTS 3           // reboots a new image gets to reach the server before revert
+#define OTA_CHUNK_SIZE          65536       // bytes per HTTP Range request (multiple of 4096)
+#define OTA_CHUNK_RETRIES       5           // consecutive chunk failures before pausing the download
+#define OTA_RESUME_DELAY_MS     60000UL     // retry a paused download after 1 minute
+
+// Store-and-forward (backlog.h): readings taken while the websocket is down are
+// kept in PSRAM and replayed in bin1 frames after reconnect.
+#define BACKLOG_CAPACITY          28800  // readings: 4 h at DB_SEND_INTERVAL, 12 bytes each
+#define BACKLOG_DRAIN_INTERVAL_MS 100    // at most one backlog frame per 100 ms
+
+// Send-on-delta (report.h): defaults until the server pushes its own in
+// "registered" / "set_reporting". A reading is sent when the level moved
+// REPORT_DEADBAND_DB since the last one sent, its slope (over
+// REPORT_SLOPE_READINGS readings) changed by REPORT_SLOPE_DB_PER_S, or a
+// percentile moved the deadband; then every reading for REPORT_HOLD_MS; and at
+// least every REPORT_HEARTBEAT_MS. Deadband 0 sends every reading.
+#define REPORT_DEADBAND_DB     1.0f
+#define REPORT_SLOPE_DB_PER_S  0.5f
+#define REPORT_SLOPE_READINGS  4      // 2 s at DB_SEND_INTERVAL
+#define REPORT_HOLD_MS         5000
+#define REPORT_HEARTBEAT_MS    30000
+
+// Runtime metrics (metrics.h): a "stats" message this often while connected.
+#define STATS_INTERVAL_MS         60000
+
+// Log ring (logring.h): fixed 64-byte records in PSRAM (a smaller ring in
+// internal RAM without it), printed to Serial by a low-priority task on the
+// capture core. Levels reset to LOG_DEFAULT_LEVEL at boot.
+#define LOG_RING_SLOTS          1024
+#define LOG_RING_SLOTS_INTERNAL 128
+#define LOG_DEFAULT_LEVEL       LOG_INFO
+#define LOG_TASK_CORE           0
+#define LOG_TASK_PRIORITY       1
+#define LOG_TASK_STACK          3072
+#define LOG_FETCH_MAX           64   // records per "logs" reply
+
+// Message memory (msgarena.h), reserved at boot in PSRAM: JSON documents for
+// sends and for received messages, and the buffer sends serialize into. Sized
+// for the largest of each ("logs" with LOG_FETCH_MAX records; "registered" with
+// MAPPER_MAX_ZONES zone configs).
+#define MSG_TX_ARENA_BYTES      32768
+#define MSG_RX_ARENA_BYTES      16384
+#define MSG_TX_BUFFER_BYTES     16384
+#define MSG_FRAME_HEADER_ROOM   14   // WEBSOCKETS_MAX_HEADER_SIZE
+#define WS_RX_MESSAGE_BYTES     8192 // longest message received (wsclient.h), NUL included
+
+// Wall clock (wallclock.h)
+#define NTP_SERVER_1       "pool.ntp.org"
+#define NTP_SERVER_2       "time.google.com"
 
 // NVS keys
 #define NVS_KEY_ACCOUNT    "account_id"
+#define NVS_KEY_WEIGHTING  "weighting"
 
 // Provisioning
 #define AP_NAME_PREFIX     "AutoVolume-"
-#define PORTAL_TIMEOUT     180     // seconds before portal times out
+#define PORTAL_TIMEOUT     180     // seconds before portal times out (with no phone on it)
+#define PORTAL_STA_RETRY_MS 15000  // ms between stored-network retries while the portal is open
+#define WIFI_FAST_TIMEOUT_MS 5000  // ms for a cached AP/channel connect (incl. DHCP) before a full scan
 #define MAX_WIFI_FAILURES  5       // consecutive failures before re-provisioning
 #define TOUCH_RESET_HOLD_MS 5000   // ms to hold touch for factory reset
@@ -0,0 +1,205 @@
+#include <Arduino.h>
+#include <Update.h>
+#include <esp_heap_caps.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+#include "rom/miniz.h"  // tinfl lives in ROM: no inflate code in the image
+
+#include "delta.h"
+#include "logring.h"
+
+#define OP_END    0
+#define OP_COPY   1
+#define OP_ADD    2
+#define OP_INSERT 3
+
+#define DELTA_CHUNK 4096
+
+// Pull-style inflater over the HTTP stream: the op parser asks for N bytes and
+// this refills the 32 KB window from the network as needed.
+struct Inflate {
+  Stream *in;
+  size_t inLeft;  // compressed bytes not yet read from the network
+  uint8_t inBuf[1024];
+  size_t inPos, inLen;
+  tinfl_decompressor tinfl;
+  uint8_t dict[TINFL_LZ_DICT_SIZE];  // circular output window
+  size_t dictPos;
+  size_t outPos, outLen;  // decompressed bytes not yet consumed, at dict[outPos]
+  bool done;
+};
+
+static uint32_t getU32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool inflateRead(Inflate &z, uint8_t *dst, size_t n) {
+  while (n > 0) {
+    if (z.outLen > 0) {
+      size_t k = n < z.outLen ? n : z.outLen;
+      memcpy(dst, z.dict + z.outPos, k);
+      z.outPos += k;
+      z.outLen -= k;
+      dst += k;
+      n -= k;
+      continue;
+    }
+    if (z.done) return false;  // deflate stream ended mid-op
+
+    if (z.inPos == z.inLen && z.inLeft > 0) {
+      size_t want = z.inLeft < sizeof(z.inBuf) ? z.inLeft : sizeof(z.inBuf);
+      z.inLen = z.in->readBytes(z.inBuf, want);
+      if (z.inLen == 0) return false;  // network timeout
+      z.inPos = 0;
+      z.inLeft -= z.inLen;
+    }
+
+    size_t inBytes = z.inLen - z.inPos;
+    size_t outBytes = TINFL_LZ_DICT_SIZE - z.dictPos;
+    mz_uint32 flags = z.inLeft > 0 ? TINFL_FLAG_HAS_MORE_INPUT : 0;
+    tinfl_status st = tinfl_decompress(&z.tinfl, z.inBuf + z.inPos, &inBytes, z.dict,
+                                       z.dict + z.dictPos, &outBytes, flags);
+    if (st < TINFL_STATUS_DONE) return false;
+    if (st == TINFL_STATUS_DONE) z.done = true;
+    if (inBytes == 0 && outBytes == 0 && !z.done && z.inLeft == 0) return false;  // truncated
+    z.inPos += inBytes;
+    z.outPos = z.dictPos;
+    z.outLen = outBytes;
+    z.dictPos = (z.dictPos + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+  }
+  return true;
+}
+
+static bool readU32(Inflate &z, uint32_t &v) {
+  uint8_t b[4];
+  if (!inflateRead(z, b, 4)) return false;
+  v = getU32(b);
+  return true;
+}
+
+static bool hashPartition(const esp_partition_t *part, size_t size, uint8_t *buf, uint8_t out[32]) {
+  mbedtls_sha256_context sha;
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts(&sha, 0);
+  bool ok = true;
+  for (size_t off = 0; off < size && ok; off += DELTA_CHUNK) {
+    size_t n = size - off < DELTA_CHUNK ? size - off : DELTA_CHUNK;
+    ok = esp_partition_read(part, off, buf, n) == ESP_OK;
+    if (ok) mbedtls_sha256_update(&sha, buf, n);
+  }
+  mbedtls_sha256_finish(&sha, out);
+  mbedtls_sha256_free(&sha);
+  return ok;
+}
+
+// Run the op stream, writing the rebuilt image through Update and hashing it.
+static bool applyOps(Inflate &z, const esp_partition_t *src, uint32_t srcSize, uint32_t dstSize,
+                     uint8_t *a, uint8_t *b, mbedtls_sha256_context &sha, DeltaProgress progress) {
+  size_t written = 0;
+  for (;;) {
+    uint8_t op;
+    uint32_t off = 0, len;
+    if (!inflateRead(z, &op, 1)) return false;
+    if (op == OP_END) return written == dstSize;
+    if (op != OP_COPY && op != OP_ADD && op != OP_INSERT) return false;
+    if (op != OP_INSERT && !readU32(z, off)) return false;
+    if (!readU32(z, len)) return false;
+    if (len > dstSize - written) return false;
+    if (op != OP_INSERT && (off > srcSize || len > srcSize - off)) return false;
+
+    while (len > 0) {
+      size_t n = len < DELTA_CHUNK ? len : DELTA_CHUNK;
+      if (op == OP_INSERT) {
+        if (!inflateRead(z, a, n)) return false;
+      } else {
+        if (esp_partition_read(src, off, a, n) != ESP_OK) return false;
+        if (op == OP_ADD) {
+          if (!inflateRead(z, b, n)) return false;
+          for (size_t i = 0; i < n; i++) a[i] += b[i];
+        }
+        off += n;
+      }
+      mbedtls_sha256_update(&sha, a, n);
+      if (Update.write(a, n) != n) return false;
+      written += n;
+      len -= n;
+      if (progress) progress(written, dstSize);
+    }
+  }
+}
+
+bool deltaApply(Stream &in, size_t patchSize, const uint8_t *expectSha256, DeltaProgress progress) {
+  uint8_t hdr[DELTA_HEADER_SIZE];
+  if (patchSize <= DELTA_HEADER_SIZE || in.readBytes(hdr, sizeof(hdr)) != sizeof(hdr) ||
+      memcmp(hdr, DELTA_MAGIC, 4) != 0) {
+    LOGW(LOG_OTA, "delta: bad patch header");
+    return false;
+  }
+  uint32_t srcSize = getU32(hdr + 4);
+  uint32_t dstSize = getU32(hdr + 8);
+  const uint8_t *srcSha = hdr + 12;
+  const uint8_t *dstSha = hdr + 44;
+  if (expectSha256 && memcmp(dstSha, expectSha256, 32) != 0) {
+    LOGW(LOG_OTA, "delta: patch does not produce the published image");
+    return false;
+  }
+
+  const esp_partition_t *src = esp_ota_get_running_partition();
+  if (!src || srcSize > src->size) return false;
+
+  uint8_t *a = (uint8_t *)malloc(DELTA_CHUNK);
+  uint8_t *b = (uint8_t *)malloc(DELTA_CHUNK);
+  // ~44 KB: prefer PSRAM so the TLS session keeps the internal heap.
+  Inflate *z = (Inflate *)heap_caps_malloc(sizeof(Inflate), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!z) z = (Inflate *)malloc(sizeof(Inflate));
+  bool ok = a && b && z;
+  if (!ok) LOGE(LOG_OTA, "delta: out of memory");
+
+  // The patch only applies to the exact image it was made from — check before
+  // erasing anything.
+  uint8_t digest[32];
+  if (ok && (!hashPartition(src, srcSize, a, digest) || memcmp(digest, srcSha, 32) != 0)) {
+    LOGW(LOG_OTA, "delta: running image differs from the patch source");
+    ok = false;
+  }
+
+  if (ok && !Update.begin(dstSize)) {
+    LOGE(LOG_OTA, "delta: Update.begin failed: %s", Update.errorString());
+    ok = false;
+  }
+
+  if (ok) {
+    z->in = &in;
+    z->inLeft = patchSize - DELTA_HEADER_SIZE;
+    z->inPos = z->inLen = 0;
+    z->dictPos = z->outPos = z->outLen = 0;
+    z->done = false;
+    tinfl_init(&z->tinfl);
+
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    ok = applyOps(*z, src, srcSize, dstSize, a, b, sha, progress);
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+
+    if (!ok) {
+      LOGW(LOG_OTA, "delta: patch stream failed");
+    } else if (memcmp(digest, dstSha, 32) != 0) {
+      LOGE(LOG_OTA, "delta: rebuilt image hash mismatch");
+      ok = false;
+    }
+    if (ok) {
+      ok = Update.end();  // validates the image and sets it as the boot partition
+      if (!ok) LOGE(LOG_OTA, "delta: Update.end failed: %s", Update.errorString());
+    } else {
+      Update.abort();
+    }
+  }
+
+  free(a);
+  free(b);
+  free(z);
+  return ok;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Delta OTA: rebuild the new image from the running partition plus a patch,
+// streamed straight into the inactive OTA slot (via Update), so a point release
+// downloads tens of KB instead of the whole firmware.bin.
+//
+// Patch format "AVD1" (generated by server/scripts/publish-firmware.mjs):
+//   char[4] magic        "AVD1"
+//   u32     sourceSize   bytes of the running image the patch was made against
+//   u32     targetSize   bytes of the new image
+//   u8[32]  sourceSha256
+//   u8[32]  targetSha256
+//   raw-deflate stream of ops (integers little-endian):
+//     0 END
+//     1 COPY   u32 srcOff, u32 len                 target = source[srcOff..]
+//     2 ADD    u32 srcOff, u32 len, len bytes diff target = source[srcOff..] + diff
+//     3 INSERT u32 len, len bytes                  target = literal bytes
+#define DELTA_MAGIC       "AVD1"
+#define DELTA_HEADER_SIZE 76
+
+// Progress callback: bytes of the new image written so far, and its total size.
+typedef void (*DeltaProgress)(size_t written, size_t total);
+
+// Apply a patch read from `in` (patchSize bytes). Verifies the running image
+// against the patch's source hash before touching flash, and the rebuilt image
+// against its target hash (and expectSha256, when non-null) before committing
+// it as the boot partition. Returns false — with nothing committed — on any
+// mismatch, so the caller can fall back to the full image.
+bool deltaApply(Stream &in, size_t patchSize, const uint8_t *expectSha256, DeltaProgress progress);
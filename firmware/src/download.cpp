@@ -0,0 +1,156 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <Preferences.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+
+#include "config.h"
+#include "download.h"
+#include "tls.h"
+#include "logring.h"
+
+// NVS namespace shared with provisioning (Preferences "autovolume").
+static const char *NVS_NS = "autovolume";
+static const char *NVS_KEY = "dl_state";
+
+#define SECTOR 4096
+
+// Checkpoint: everything needed to continue a download. The S3's hardware SHA
+// context is plain data (state is read back after every update), so the
+// midstate can be stored as-is. A layout change just fails the size check.
+struct DlState {
+  uint8_t sha[32];  // image being downloaded
+  char part[17];    // target partition label
+  uint32_t off;     // bytes written and hashed (sector-aligned unless complete)
+  mbedtls_sha256_context ctx;
+};
+
+static bool loadState(DlState &st) {
+  Preferences prefs;
+  prefs.begin(NVS_NS, true);
+  bool ok = prefs.getBytesLength(NVS_KEY) == sizeof(DlState) &&
+            prefs.getBytes(NVS_KEY, &st, sizeof(DlState)) == sizeof(DlState);
+  prefs.end();
+  return ok;
+}
+
+static void saveState(const DlState &st) {
+  Preferences prefs;
+  prefs.begin(NVS_NS, false);
+  prefs.putBytes(NVS_KEY, &st, sizeof(DlState));
+  prefs.end();
+}
+
+void downloadReset() {
+  Preferences prefs;
+  prefs.begin(NVS_NS, false);
+  if (prefs.isKey(NVS_KEY)) prefs.remove(NVS_KEY);
+  prefs.end();
+}
+
+bool downloadPending(const uint8_t sha256[32]) {
+  DlState st;
+  return loadState(st) && memcmp(st.sha, sha256, 32) == 0 && st.off > 0;
+}
+
+// GET bytes [st.off, end] and write them, advancing st one sector at a time so
+// st is always a valid checkpoint, even when this returns false.
+static bool fetchRange(HTTPClient &http, WiFiClient &client, const String &url, DlState &st,
+                       size_t end, size_t size, const esp_partition_t *part, uint8_t *buf,
+                       DownloadProgress progress) {
+  if (!http.begin(client, url)) return false;
+  char range[32];
+  snprintf(range, sizeof(range), "bytes=%u-%u", (unsigned)st.off, (unsigned)end);
+  http.addHeader("Range", range);
+  int code = http.GET();
+  if (code == HTTP_CODE_OK && st.off == 0) {
+    end = size - 1;  // server ignored Range: take the whole body in one go
+  } else if (code != HTTP_CODE_PARTIAL_CONTENT) {
+    LOGW(LOG_OTA, "range %s: HTTP %d", range, code);
+    http.end();
+    return false;
+  }
+
+  WiFiClient *stream = http.getStreamPtr();
+  bool ok = true;
+  while (ok && st.off <= end) {
+    size_t n = end + 1 - st.off < SECTOR ? end + 1 - st.off : SECTOR;
+    ok = stream->readBytes(buf, n) == n &&
+         esp_partition_erase_range(part, st.off, SECTOR) == ESP_OK &&
+         esp_partition_write(part, st.off, buf, n) == ESP_OK;
+    if (!ok) break;
+    mbedtls_sha256_update(&st.ctx, buf, n);
+    st.off += n;
+    if (progress) progress(st.off, size);
+  }
+  if (!ok) LOGW(LOG_OTA, "chunk interrupted at %u bytes", (unsigned)st.off);
+  http.end();
+  return ok;
+}
+
+bool downloadImage(const String &url, size_t size, const uint8_t sha256[32], DownloadProgress progress) {
+  const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
+  if (!part || size == 0 || size > part->size) {
+    LOGE(LOG_OTA, "no OTA partition large enough for the image");
+    return false;
+  }
+
+  DlState st;
+  if (loadState(st) && memcmp(st.sha, sha256, 32) == 0 && strcmp(st.part, part->label) == 0 &&
+      st.off <= size && (st.off % SECTOR == 0 || st.off == size)) {
+    LOGI(LOG_OTA, "resuming download at %u/%u bytes", (unsigned)st.off, (unsigned)size);
+  } else {
+    memset(&st, 0, sizeof(st));
+    memcpy(st.sha, sha256, 32);
+    strlcpy(st.part, part->label, sizeof(st.part));
+    mbedtls_sha256_init(&st.ctx);
+    mbedtls_sha256_starts(&st.ctx, 0);
+    saveState(st);
+  }
+
+  uint8_t *buf = (uint8_t *)malloc(SECTOR);
+  if (!buf) return false;
+
+  TlsClient tls;  // integrity comes from the manifest sha256, not the channel
+  WiFiClient plain;
+  WiFiClient &client = url.startsWith("https://") ? (WiFiClient &)tls : plain;
+  HTTPClient http;
+  http.setReuse(true);  // one TLS handshake for all the chunks
+  http.setConnectTimeout(8000);
+  http.setTimeout(8000);
+
+  int failures = 0;
+  while (st.off < size) {
+    size_t end = st.off + OTA_CHUNK_SIZE < size ? st.off + OTA_CHUNK_SIZE - 1 : size - 1;
+    bool ok = fetchRange(http, client, url, st, end, size, part, buf, progress);
+    saveState(st);
+    if (ok) {
+      failures = 0;
+    } else if (++failures > OTA_CHUNK_RETRIES || WiFi.status() != WL_CONNECTED) {
+      LOGW(LOG_OTA, "download paused at %u/%u bytes — will resume",
+                    (unsigned)st.off, (unsigned)size);
+      free(buf);
+      return false;
+    } else {
+      delay(1000 * failures);
+    }
+  }
+  free(buf);
+
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&st.ctx, digest);
+  mbedtls_sha256_free(&st.ctx);
+  downloadReset();
+  if (memcmp(digest, sha256, 32) != 0) {
+    LOGE(LOG_OTA, "image sha256 mismatch — discarded");
+    return false;
+  }
+  esp_err_t err = esp_ota_set_boot_partition(part);  // also validates the image
+  if (err != ESP_OK) {
+    LOGE(LOG_OTA, "set boot partition failed: %s", esp_err_to_name(err));
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Resumable full-image OTA download into the inactive OTA slot.
+//
+// The image is fetched in OTA_CHUNK_SIZE HTTP Range requests over one kept-alive
+// connection and written sector by sector. SHA-256 is computed on the fly, so
+// flash is never read back. After every chunk (and on any failure) the offset
+// and hash midstate are checkpointed in NVS. A dropped connection, a later
+// check, or a reboot all resume where the last checkpoint left off.
+// The boot partition is switched only when the hash matches the manifest.
+
+typedef void (*DownloadProgress)(size_t written, size_t total);
+
+// Download url (size bytes, expected sha256) and make it the boot partition.
+// Retries failed chunks up to OTA_CHUNK_RETRIES times in a row before giving
+// up. The checkpoint is kept, so the next attempt resumes. http:// URLs are
+// allowed (e.g. a LAN stand-in); integrity comes from the hash.
+bool downloadImage(const String &url, size_t size, const uint8_t sha256[32], DownloadProgress progress);
+
+// True if a partial download of this exact image is checkpointed.
+bool downloadPending(const uint8_t sha256[32]);
+
+// Forget any checkpoint (the inactive slot is about to be written another way).
+void downloadReset();
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <esp_dsp.h>
+#endif
+
+#if defined(CONFIG_IDF_TARGET_ESP32S3)
+#define ENERGY_PIE 1  // S3 vector extension (ee.* instructions)
+#else
+#define ENERGY_PIE 0
+#endif
+
+// Block energy (sum of squares of 16-bit samples) — the core of the level
+// meter. Kept as separate variants so src/bench can price them against each
+// other; full scale is 32767 in every variant.
+
+// Double accumulation. Exact enough for any block, but software-emulated on
+// the S3 (its FPU is single precision).
+inline double energyDouble(const int16_t *x, size_t n) {
+  double acc = 0;
+  for (size_t i = 0; i < n; i++) acc += (double)x[i] * x[i];
+  return acc;
+}
+
+// Single-precision accumulation: hardware FPU, ~24-bit mantissa, so relative
+// error grows with block length.
+inline float energyFloat(const int16_t *x, size_t n) {
+  float acc = 0;
+  for (size_t i = 0; i < n; i++) acc += (float)x[i] * x[i];
+  return acc;
+}
+
+// Integer: 32-bit products into a 64-bit accumulator. Exact.
+inline int64_t energyInt64(const int16_t *x, size_t n) {
+  int64_t acc = 0;
+  for (size_t i = 0; i < n; i++) acc += (int32_t)x[i] * x[i];
+  return acc;
+}
+
+// Exact integer energy of n samples read every `stride` int16s (stride 2 picks
+// one slot of an interleaved stereo buffer). The level meter's kernel.
+//
+// On the S3, contiguous runs use the vector unit: 8 int16 lanes multiplied
+// and summed into the 40-bit ACCX accumulator per instruction. 512 full-scale
+// squares (2^30 each) fit in 40 bits, so ACCX is drained into the 64-bit
+// total every 512 samples. Unaligned head/tail samples and strided reads take
+// the scalar path.
+inline int64_t energyInt16(const int16_t *x, size_t n, size_t stride = 1) {
+  int64_t acc = 0;
+  if (stride != 1) {
+    for (size_t i = 0; i < n; i++, x += stride) acc += (int32_t)*x * *x;
+    return acc;
+  }
+#if ENERGY_PIE
+  while (n > 0 && ((uintptr_t)x & 15)) {  // ee.vld.128 needs 16-byte alignment
+    acc += (int32_t)*x * *x;
+    x++;
+    n--;
+  }
+  while (n >= 8) {
+    size_t chunk = n < 512 ? n & ~(size_t)7 : 512;
+    uint32_t vecs = chunk / 8, lo, hi;
+    const int16_t *p = x;
+    // Plain branch loop, not loopnez: the compiler may already be using the
+    // zero-overhead loop registers around this block.
+    asm volatile(
+        "ee.zero.accx\n"
+        "1:\n"
+        "ee.vld.128.ip q0, %[p], 16\n"
+        "addi %[vecs], %[vecs], -1\n"
+        "ee.vmulas.s16.accx q0, q0\n"
+        "bnez %[vecs], 1b\n"
+        "rur.accx_0 %[lo]\n"
+        "rur.accx_1 %[hi]\n"
+        : [p] "+r"(p), [vecs] "+r"(vecs), [lo] "=r"(lo), [hi] "=r"(hi)
+        :
+        : "memory");
+    acc += ((int64_t)(hi & 0xFF) << 32) | lo;
+    x += chunk;
+    n -= chunk;
+  }
+#endif
+  while (n--) {
+    acc += (int32_t)*x * *x;
+    x++;
+  }
+  return acc;
+}
+
+// Vectorised: convert to float, then esp-dsp's dot product (SIMD on the S3).
+// scratch must hold n floats. Portable loop elsewhere.
+inline float energySimd(const int16_t *x, size_t n, float *scratch) {
+  for (size_t i = 0; i < n; i++) scratch[i] = x[i];
+  float acc = 0;
+#if defined(ARDUINO_ARCH_ESP32)
+  dsps_dotprod_f32(scratch, scratch, &acc, n);
+#else
+  for (size_t i = 0; i < n; i++) acc += scratch[i] * scratch[i];
+#endif
+  return acc;
+}
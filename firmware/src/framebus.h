@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <new>
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_heap_caps.h>
+
+// Single-producer / multi-consumer bus of fixed-size sample blocks, so several
+// DSP stages share one capture without copying it. The producer fills a block
+// in place (i2s_channel_read() straight into it) and publishes it; each
+// consumer reads blocks in order and releases each one when done. Lock-free:
+// blocks are reference counted and the producer never waits.
+//
+// The bus remembers the last Depth published blocks. A consumer that falls
+// further behind than that is overrun: it skips to the oldest block still held
+// and the skipped blocks are counted against it alone. The pool holds
+// Depth + MaxConsumers + 1 blocks (the ring, one held per consumer, one being
+// filled), so the producer always finds a free block however slow a consumer is.
+//
+// Threading: one producer task; each consumer id is used by one task only.
+// subscribe() before the producer starts. Waking consumers is up to the caller
+// (e.g. xTaskNotifyGive after publish()).
+//
+// Memory order: a reader pins a block (refs acq_rel) and then checks seqValid;
+// the producer clears seqValid before dropping the ring's ref, and can only
+// reuse the block through a refs CAS that follows it in the refs modification
+// order. So a reader that pins a reused block always sees it as not valid.
+
+struct FrameBusStats {
+  uint32_t received;  // blocks read
+  uint32_t overruns;  // blocks missed because this consumer lagged > Depth
+  uint32_t lag;       // blocks published but not yet read, now
+  uint32_t maxLag;    // worst lag seen at a read
+};
+
+template <typename T, size_t BlockLen, size_t Depth, size_t MaxConsumers>
+class FrameBus {
+ public:
+  struct Block {
+    T data[BlockLen];  // first, so the pool's alignment carries over to the samples
+    size_t len;
+    uint32_t seq;
+    std::atomic<uint32_t> seqValid;  // seq + 1 while in the ring, 0 otherwise
+    std::atomic<uint32_t> refs;      // ring + producer + consumers holding it
+  };
+
+  static const size_t POOL = Depth + MaxConsumers + 1;
+
+  // Allocate the pool with heap_caps capabilities (e.g. MALLOC_CAP_SPIRAM to
+  // keep internal RAM free, MALLOC_CAP_INTERNAL for the fastest DSP access).
+  bool begin(uint32_t caps) {
+    _pool = (Block *)heap_caps_aligned_alloc(16, sizeof(Block) * POOL, caps);
+    if (!_pool) return false;
+    for (size_t i = 0; i < POOL; i++) new (&_pool[i]) Block();
+    for (auto &slot : _ring) slot.store(nullptr);
+    return true;
+  }
+
+  // Register a consumer. It sees blocks published from now on. Returns its id,
+  // or -1 if MaxConsumers are already subscribed.
+  int subscribe() {
+    if (_consumers >= MaxConsumers) return -1;
+    Consumer &c = _consumer[_consumers];
+    c = Consumer{};
+    c.next = _head.load();
+    return (int)_consumers++;
+  }
+
+  // --- Producer ---
+
+  // A free block to fill, or nullptr (only if begin() failed).
+  T *acquire() {
+    if (!_pool) return nullptr;
+    if (_filling) return _filling->data;
+    // Blocks free up roughly in publish order: resume the scan after the last one.
+    for (size_t n = 0; n < POOL; n++) {
+      Block &b = _pool[_cursor];
+      _cursor = _cursor + 1 == POOL ? 0 : _cursor + 1;
+      uint32_t expected = 0;
+      if (b.refs.load(std::memory_order_relaxed) == 0 &&
+          b.refs.compare_exchange_strong(expected, 1, std::memory_order_acq_rel)) {
+        _filling = &b;
+        return b.data;
+      }
+    }
+    return nullptr;
+  }
+
+  // Hand the acquired block (its first len samples) to every consumer. The
+  // producer may keep reading it until its next publish().
+  void publish(size_t len) {
+    Block *b = _filling;
+    if (!b) return;
+    _filling = nullptr;
+    uint32_t seq = _head.load(std::memory_order_relaxed);
+    b->len = len;
+    b->seq = seq;
+    b->seqValid.store(seq + 1, std::memory_order_release);  // the producer's ref passes to the ring
+    Block *old = _ring[seq % Depth].exchange(b, std::memory_order_acq_rel);
+    if (old) {
+      old->seqValid.store(0, std::memory_order_release);  // readers that pin it from here on reject it
+      old->refs.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    _head.store(seq + 1, std::memory_order_release);
+  }
+
+  uint32_t published() const { return _head.load(std::memory_order_acquire); }
+
+  // --- Consumers ---
+
+  // The next block for consumer id, or nullptr if it is caught up. Release it
+  // before the next read().
+  const Block *read(int id) {
+    Consumer &c = _consumer[id];
+    for (;;) {
+      uint32_t head = _head.load(std::memory_order_acquire);
+      if (c.next == head) return nullptr;
+      if (head - c.next > Depth) {
+        c.stats.overruns += head - c.next - Depth;
+        c.next = head - Depth;
+      }
+      uint32_t lag = head - c.next;
+      if (lag > c.stats.maxLag) c.stats.maxLag = lag;
+
+      Block *b = _ring[c.next % Depth].load(std::memory_order_acquire);
+      b->refs.fetch_add(1, std::memory_order_acq_rel);
+      if (b->seqValid.load(std::memory_order_acquire) == c.next + 1) {
+        c.held = b;
+        c.next++;
+        c.stats.received++;
+        return b;
+      }
+      // Evicted between the head check and the pin: count it and move on.
+      b->refs.fetch_sub(1, std::memory_order_acq_rel);
+      c.stats.overruns++;
+      c.next++;
+    }
+  }
+
+  void release(int id) {
+    Consumer &c = _consumer[id];
+    if (c.held) c.held->refs.fetch_sub(1, std::memory_order_acq_rel);
+    c.held = nullptr;
+  }
+
+  FrameBusStats stats(int id) const {
+    FrameBusStats s = _consumer[id].stats;
+    s.lag = _head.load(std::memory_order_acquire) - _consumer[id].next;
+    return s;
+  }
+
+ private:
+  struct Consumer {
+    uint32_t next = 0;  // seq of the next block to read
+    Block *held = nullptr;
+    FrameBusStats stats = {};
+  };
+
+  Block *_pool = nullptr;
+  Block *_filling = nullptr;
+  size_t _cursor = 0;  // producer's next pool slot to try
+  std::atomic<Block *> _ring[Depth];
+  std::atomic<uint32_t> _head{0};  // seq of the next block to publish
+  Consumer _consumer[MaxConsumers];
+  size_t _consumers = 0;
+};
@@ -0,0 +1,127 @@
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+
+#include "config.h"
+#include "levelstats.h"
+#include "logring.h"
+
+const uint16_t LEVELSTATS_WINDOW_S[LEVELSTATS_WINDOWS] = {10, 60, 300};
+
+// Slices per window: the window slides in steps of windowS / slices.
+static const uint16_t SLICES[LEVELSTATS_WINDOWS] = {10, 12, 10};
+
+static const int BINS = (int)(-LEVELSTATS_FLOOR_DB / LEVELSTATS_BIN_DB);
+static const uint32_t LEVELS_PER_SECOND = 1000 / DB_CALC_INTERVAL;
+
+// Counts fit u16: the longest window holds 300 s x 10 levels.
+struct Window {
+  uint16_t *slices;  // SLICES x BINS, ring of per-slice histograms
+  uint16_t total[BINS];  // sum of the slices
+  uint32_t sliceLevels;  // levels per slice
+  uint32_t inSlice;      // levels added to the current slice
+  uint16_t slice;        // current slice
+  uint32_t count;        // levels in total[]
+};
+
+static Window s_win[LEVELSTATS_WINDOWS];
+static bool s_ready = false;
+static uint32_t s_sinceUpdate = 0;
+
+// Shared with levelStatsGet(); guarded by s_mux (held only for a short copy).
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static LevelPercentiles s_out[LEVELSTATS_WINDOWS];
+static size_t s_outCount = 0;
+
+bool levelStatsInit() {
+  size_t slices = 0;
+  for (int w = 0; w < LEVELSTATS_WINDOWS; w++) slices += SLICES[w];
+  size_t bytes = slices * BINS * sizeof(uint16_t);
+  uint16_t *mem = (uint16_t *)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!mem) mem = (uint16_t *)heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+  if (!mem) {
+    LOGE(LOG_AUDIO, "level percentiles disabled (no memory)");
+    return false;
+  }
+  memset(mem, 0, bytes);
+  for (int w = 0; w < LEVELSTATS_WINDOWS; w++) {
+    Window &win = s_win[w];
+    win.slices = mem;
+    mem += SLICES[w] * BINS;
+    memset(win.total, 0, sizeof(win.total));
+    win.sliceLevels = LEVELSTATS_WINDOW_S[w] * LEVELS_PER_SECOND / SLICES[w];
+    win.inSlice = 0;
+    win.slice = 0;
+    win.count = 0;
+  }
+  s_ready = true;
+  return true;
+}
+
+// Level exceeded (1 - q) of the time, interpolated within its bin, in dB x 10.
+static int16_t quantile(const Window &win, float q) {
+  float target = q * win.count;
+  uint32_t below = 0;
+  for (int b = 0; b < BINS; b++) {
+    uint16_t n = win.total[b];
+    if (n > 0 && below + n >= target) {
+      float db = LEVELSTATS_FLOOR_DB + (b + (target - below) / n) * LEVELSTATS_BIN_DB;
+      return (int16_t)lroundf(db * 10.0f);
+    }
+    below += n;
+  }
+  return 0;
+}
+
+static void update() {
+  LevelPercentiles out[LEVELSTATS_WINDOWS];
+  size_t n = 0;
+  for (int w = 0; w < LEVELSTATS_WINDOWS; w++) {
+    const Window &win = s_win[w];
+    if (win.count == 0) continue;
+    out[n++] = {LEVELSTATS_WINDOW_S[w], quantile(win, 0.9f), quantile(win, 0.5f), quantile(win, 0.1f)};
+  }
+  portENTER_CRITICAL(&s_mux);
+  memcpy(s_out, out, n * sizeof(LevelPercentiles));
+  s_outCount = n;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+void levelStatsAdd(float dbFS) {
+  if (!s_ready) return;
+  int bin = (int)((dbFS - LEVELSTATS_FLOOR_DB) / LEVELSTATS_BIN_DB);
+  if (bin < 0) bin = 0;
+  if (bin >= BINS) bin = BINS - 1;
+
+  for (int w = 0; w < LEVELSTATS_WINDOWS; w++) {
+    Window &win = s_win[w];
+    if (win.inSlice == win.sliceLevels) {
+      // Start the next slice: retire the oldest one it replaces.
+      win.slice = (win.slice + 1) % SLICES[w];
+      uint16_t *oldest = win.slices + win.slice * BINS;
+      for (int b = 0; b < BINS; b++) {
+        win.total[b] -= oldest[b];
+        win.count -= oldest[b];
+        oldest[b] = 0;
+      }
+      win.inSlice = 0;
+    }
+    win.slices[win.slice * BINS + bin]++;
+    win.total[bin]++;
+    win.count++;
+    win.inSlice++;
+  }
+
+  if (++s_sinceUpdate >= LEVELS_PER_SECOND) {
+    s_sinceUpdate = 0;
+    update();
+  }
+}
+
+size_t levelStatsGet(LevelPercentiles out[LEVELSTATS_WINDOWS]) {
+  portENTER_CRITICAL(&s_mux);
+  size_t n = s_outCount;
+  memcpy(out, s_out, n * sizeof(LevelPercentiles));
+  portEXIT_CRITICAL(&s_mux);
+  return n;
+}
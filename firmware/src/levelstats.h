@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Streaming percentile levels over sliding windows: L90 (exceeded 90% of the
+// time, the steady ambient floor), L50 and L10 (intermittent peaks). Every
+// DB_CALC_INTERVAL level window's own Leq (before the meter's smoothing) goes
+// into a histogram of LEVELSTATS_BIN_DB-wide bins per window, kept as a ring of
+// time slices: adding a level is O(1), retiring a slice O(bins). Percentiles
+// are recomputed once a second; memory is fixed (PSRAM when available).
+//
+// Windows (seconds): LEVELSTATS_WINDOW_S. They go out with every sound_level
+// reading (TELEMETRY_TAG_PERCENTILES, or "percentiles" in JSON), so the server
+// and the on-device mapper can drive a zone off L90 instead of the level.
+#define LEVELSTATS_WINDOWS 3
+extern const uint16_t LEVELSTATS_WINDOW_S[LEVELSTATS_WINDOWS];
+
+// One window's percentiles in dBFS x 10.
+struct LevelPercentiles {
+  uint16_t windowS;
+  int16_t l10, l50, l90;
+};
+
+// Allocate the histograms. Call once before the capture task starts.
+bool levelStatsInit();
+
+// Add one level window's Leq in dBFS. Capture task only.
+void levelStatsAdd(float dbFS);
+
+// Percentiles of the windows that hold any levels yet (shortest first) as of
+// the last once-a-second update. Returns how many were written. Any task.
+size_t levelStatsGet(LevelPercentiles out[LEVELSTATS_WINDOWS]);
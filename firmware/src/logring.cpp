@@ -0,0 +1,257 @@
+#include <Arduino.h>
+#include <atomic>
+#include <new>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#include "config.h"
+#include "logring.h"
+
+static const char *const MODULE_NAMES[LOG_MODULES] = {
+  "sys", "audio", "ws", "wifi", "ota", "mapper", "backlog", "tls", "clock",
+};
+static const char *const LEVEL_NAMES[LOG_LEVELS] = {"error", "warn", "info", "debug"};
+static const char LEVEL_CHARS[LOG_LEVELS] = {'E', 'W', 'I', 'D'};
+
+struct LogRecord {
+  uint32_t ms;
+  const char *fmt;
+  uint8_t module;
+  uint8_t level;
+  uint8_t len;
+  uint8_t args[LOG_ARG_BYTES];
+};
+
+// A slot is a seqlock: seq is 0 while a writer fills it, then the record's
+// index + 1. Writers claim slots with one fetch_add on s_head and never wait;
+// a reader keeps a copy only if seq was the index it wanted both before and
+// after copying (a writer that lapped the ring meanwhile changes it).
+struct Slot {
+  std::atomic<uint32_t> seq;
+  LogRecord rec;
+};
+
+static Slot *s_ring = nullptr;
+static uint32_t s_slots = 0;
+static std::atomic<uint32_t> s_head{0};  // index of the next record
+static std::atomic<uint8_t> s_level[LOG_MODULES];
+
+static TaskHandle_t s_task = nullptr;
+static SemaphoreHandle_t s_printLock = nullptr;  // the task vs logFlush()
+static uint32_t s_printed = 0;                   // next record to print
+
+void logCommit(LogModule module, LogLevel level, const char *fmt, const LogArgs &args) {
+  if (!s_ring) return;
+  uint32_t idx = s_head.fetch_add(1, std::memory_order_relaxed);
+  Slot &slot = s_ring[idx % s_slots];
+  slot.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.rec.ms = millis();
+  slot.rec.fmt = fmt;
+  slot.rec.module = module;
+  slot.rec.level = level;
+  slot.rec.len = args.len;
+  memcpy(slot.rec.args, args.buf, args.len);
+  slot.seq.store(idx + 1, std::memory_order_release);
+  if (s_task) xTaskNotifyGive(s_task);
+}
+
+// 1: copied, 0: not written yet, -1: overwritten (lost).
+static int readRecord(uint32_t idx, LogRecord &out) {
+  Slot &slot = s_ring[idx % s_slots];
+  uint32_t seq = slot.seq.load(std::memory_order_acquire);
+  if (seq == 0 || seq < idx + 1) return 0;
+  if (seq != idx + 1) return -1;
+  memcpy(&out, &slot.rec, sizeof(out));
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.seq.load(std::memory_order_relaxed) == seq ? 1 : -1;
+}
+
+// printf with the record's stored arguments, one conversion at a time.
+static void format(const LogRecord &rec, char *out, size_t cap) {
+  size_t o = 0;
+  size_t a = 0;
+  auto put = [&](const char *s, size_t n) {
+    if (o + 1 >= cap) return;
+    if (n > cap - 1 - o) n = cap - 1 - o;
+    memcpy(out + o, s, n);
+    o += n;
+  };
+  auto word = [&](uint32_t &w) {
+    if (a + 4 > rec.len) return false;
+    memcpy(&w, rec.args + a, 4);
+    a += 4;
+    return true;
+  };
+
+  for (const char *p = rec.fmt; *p;) {
+    if (*p != '%') {
+      const char *q = strchr(p, '%');
+      size_t n = q ? (size_t)(q - p) : strlen(p);
+      put(p, n);
+      p += n;
+      continue;
+    }
+    // %[flags][width][.precision][length]conversion; the length is dropped
+    // because every stored integer is 32 bits.
+    char spec[16];
+    size_t s = 0;
+    spec[s++] = *p++;
+    while (*p && strchr("-+ #0", *p) && s < 8) spec[s++] = *p++;
+    while (*p && (isdigit((unsigned char)*p) || *p == '.') && s < 14) spec[s++] = *p++;
+    while (*p && strchr("hlzjt", *p)) p++;
+    char conv = *p ? *p++ : 0;
+    char buf[48];
+    int n = 0;
+    uint32_t w = 0;
+    if (conv == '%') {
+      n = snprintf(buf, sizeof(buf), "%%");
+    } else if (conv == 's') {
+      if (a < rec.len) {
+        const char *str = (const char *)rec.args + a;
+        a += strlen(str) + 1;
+        spec[s++] = 's';
+        spec[s] = 0;
+        n = snprintf(buf, sizeof(buf), spec, str);
+      } else {
+        n = snprintf(buf, sizeof(buf), "?");
+      }
+    } else if (!conv || !strchr("diuxXocfeEgGp", conv) || !word(w)) {
+      n = snprintf(buf, sizeof(buf), "?");
+    } else if (strchr("fFeEgG", conv)) {
+      float f;
+      memcpy(&f, &w, 4);
+      spec[s++] = conv;
+      spec[s] = 0;
+      n = snprintf(buf, sizeof(buf), spec, (double)f);
+    } else if (conv == 'p') {
+      n = snprintf(buf, sizeof(buf), "0x%08x", (unsigned)w);
+    } else {
+      spec[s++] = conv;
+      spec[s] = 0;
+      n = strchr("di", conv) ? snprintf(buf, sizeof(buf), spec, (int)w) : snprintf(buf, sizeof(buf), spec, (unsigned)w);
+    }
+    if (n > 0) put(buf, (size_t)n < sizeof(buf) ? n : sizeof(buf) - 1);
+  }
+  out[o] = 0;
+}
+
+// Print records up to the head. Holding s_printLock.
+static void printNew() {
+  uint32_t head = s_head.load(std::memory_order_acquire);
+  uint32_t lost = 0;
+  if (head - s_printed > s_slots) {
+    lost = head - s_printed - s_slots;
+    s_printed = head - s_slots;
+  }
+  char text[160];
+  char line[200];
+  while (s_printed != head) {
+    LogRecord rec;
+    int r = readRecord(s_printed, rec);
+    if (r == 0) break;  // still being written; its writer notifies again
+    s_printed++;
+    if (r < 0) {
+      lost++;
+      continue;
+    }
+    if (lost) {
+      Serial.printf("[log] %u records lost (Serial too slow)\n", (unsigned)lost);
+      lost = 0;
+    }
+    format(rec, text, sizeof(text));
+    // Into a stack buffer and out with write(): Print::printf() heap-allocates
+    // lines longer than its own 64-byte buffer.
+    int n = snprintf(line, sizeof(line), "%7lu %c [%s] %s\n", (unsigned long)rec.ms, LEVEL_CHARS[rec.level],
+                     MODULE_NAMES[rec.module], text);
+    if (n > (int)sizeof(line) - 1) {
+      n = sizeof(line) - 1;
+      line[n - 1] = '\n';
+    }
+    Serial.write((const uint8_t *)line, n);
+  }
+}
+
+static void logTask(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    xSemaphoreTake(s_printLock, portMAX_DELAY);
+    printNew();
+    xSemaphoreGive(s_printLock);
+  }
+}
+
+void logInit() {
+  for (auto &l : s_level) l.store(LOG_DEFAULT_LEVEL, std::memory_order_relaxed);
+  s_slots = LOG_RING_SLOTS;
+  s_ring = (Slot *)heap_caps_malloc(sizeof(Slot) * s_slots, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!s_ring) {
+    s_slots = LOG_RING_SLOTS_INTERNAL;
+    s_ring = (Slot *)heap_caps_malloc(sizeof(Slot) * s_slots, MALLOC_CAP_8BIT);
+  }
+  if (!s_ring) {
+    Serial.println("ERROR: log ring allocation failed - logging to nowhere");
+    return;
+  }
+  for (uint32_t i = 0; i < s_slots; i++) new (&s_ring[i].seq) std::atomic<uint32_t>(0);
+  s_printLock = xSemaphoreCreateMutex();
+  xTaskCreatePinnedToCore(logTask, "log", LOG_TASK_STACK, nullptr, LOG_TASK_PRIORITY, &s_task, LOG_TASK_CORE);
+}
+
+bool logEnabled(LogModule module, LogLevel level) {
+  return level <= s_level[module].load(std::memory_order_relaxed);
+}
+
+void logSetLevel(LogModule module, LogLevel level) { s_level[module].store(level, std::memory_order_relaxed); }
+
+bool logModuleFromName(const char *name, LogModule &out) {
+  for (int m = 0; name && m < LOG_MODULES; m++) {
+    if (strcmp(name, MODULE_NAMES[m]) == 0) {
+      out = (LogModule)m;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool logLevelFromName(const char *name, LogLevel &out) {
+  for (int l = 0; name && l < LOG_LEVELS; l++) {
+    if (strcmp(name, LEVEL_NAMES[l]) == 0) {
+      out = (LogLevel)l;
+      return true;
+    }
+  }
+  return false;
+}
+
+void logFlush() {
+  if (!s_ring) return;
+  xSemaphoreTake(s_printLock, portMAX_DELAY);
+  printNew();
+  xSemaphoreGive(s_printLock);
+  Serial.flush();
+}
+
+size_t logWriteRecent(JsonArray out, size_t count) {
+  if (!s_ring) return 0;
+  uint32_t head = s_head.load(std::memory_order_acquire);
+  if (count > LOG_FETCH_MAX) count = LOG_FETCH_MAX;
+  if (count > s_slots) count = s_slots;
+  if (count > head) count = head;
+  size_t n = 0;
+  char text[160];
+  for (uint32_t idx = head - count; idx != head; idx++) {
+    LogRecord rec;
+    if (readRecord(idx, rec) != 1) continue;
+    format(rec, text, sizeof(text));
+    JsonArray r = out.add<JsonArray>();
+    r.add(rec.ms);
+    r.add(LEVEL_NAMES[rec.level]);
+    r.add(MODULE_NAMES[rec.module]);
+    r.add(text);
+    n++;
+  }
+  return n;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <type_traits>
+
+// Deferred-format logging. A log call stores the address of its format string
+// (a literal, so it stays valid) and its raw arguments in a fixed-slot RAM
+// ring: no formatting, no Serial, no lock on the caller's side. A low-priority
+// task formats new records to Serial; the server can fetch the recent ones
+// ("get_logs") and change a module's level ("set_log_level") at runtime.
+//
+// Arguments: integers up to 32 bits, float/double (kept as float) and C
+// strings (copied, truncated to what is left of the record's LOG_ARG_BYTES).
+// The format may use %d %i %u %x %X %o %c %f %e %g %s %p and %%, with flags,
+// width, precision and length modifiers; arguments that did not fit print "?".
+// Not for ISRs.
+
+enum LogModule : uint8_t {
+  LOG_SYS,      // setup, hardware init, display
+  LOG_AUDIO,    // capture, weighting, bands, percentiles
+  LOG_WS,       // websocket link and server messages
+  LOG_WIFI,     // association, fast connect, setup portal
+  LOG_OTA,      // update checks, downloads, deltas
+  LOG_MAPPER,   // on-device volume control
+  LOG_BACKLOG,
+  LOG_TLS,
+  LOG_CLOCK,    // RTC / NTP
+  LOG_MODULES
+};
+
+enum LogLevel : uint8_t { LOG_ERROR, LOG_WARN, LOG_INFO, LOG_DEBUG, LOG_LEVELS };
+
+#define LOG_ARG_BYTES 48
+
+struct LogArgs {
+  uint8_t len = 0;
+  bool full = false;  // an argument did not fit; it and the rest are dropped
+  uint8_t buf[LOG_ARG_BYTES];
+
+  void word(uint32_t v) {
+    if (full || len + 4 > LOG_ARG_BYTES) {
+      full = true;
+      return;
+    }
+    memcpy(buf + len, &v, 4);
+    len += 4;
+  }
+  void str(const char *s) {
+    if (!s) s = "(null)";
+    if (full || len + 1 > LOG_ARG_BYTES) {
+      full = true;
+      return;
+    }
+    uint8_t *d = buf + len;
+    uint8_t *end = buf + LOG_ARG_BYTES - 1;
+    while (*s && d != end) *d++ = *s++;
+    *d++ = 0;
+    len = d - buf;
+  }
+};
+
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+logArg(LogArgs &a, T v) {
+  a.word((uint32_t)v);
+}
+inline void logArg(LogArgs &a, double v) {
+  float f = (float)v;
+  uint32_t w;
+  memcpy(&w, &f, 4);
+  a.word(w);
+}
+inline void logArg(LogArgs &a, const char *s) { a.str(s); }
+inline void logArg(LogArgs &a, const void *p) { a.word((uint32_t)(uintptr_t)p); }
+
+inline void logPack(LogArgs &) {}
+template <typename T, typename... Rest>
+inline void logPack(LogArgs &a, const T &v, const Rest &...rest) {
+  logArg(a, v);
+  logPack(a, rest...);
+}
+
+void logCommit(LogModule module, LogLevel level, const char *fmt, const LogArgs &args);
+
+template <typename... Args>
+inline void logWrite(LogModule module, LogLevel level, const char *fmt, const Args &...args) {
+  LogArgs a;
+  logPack(a, args...);
+  logCommit(module, level, fmt, a);
+}
+
+// Never called: lets the compiler check format strings against their arguments.
+void logCheckFormat(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#define LOG_AT(level, module, ...)                                        \
+  do {                                                                    \
+    if (false) logCheckFormat(__VA_ARGS__);                               \
+    if (logEnabled(module, level)) logWrite(module, level, __VA_ARGS__);  \
+  } while (0)
+#define LOGE(module, ...) LOG_AT(LOG_ERROR, module, __VA_ARGS__)
+#define LOGW(module, ...) LOG_AT(LOG_WARN, module, __VA_ARGS__)
+#define LOGI(module, ...) LOG_AT(LOG_INFO, module, __VA_ARGS__)
+#define LOGD(module, ...) LOG_AT(LOG_DEBUG, module, __VA_ARGS__)
+
+// Allocate the ring and start the Serial task. First thing in setup(); records
+// logged before it are dropped.
+void logInit();
+
+// Whether `module` records `level` (LOG_DEFAULT_LEVEL and up until changed).
+bool logEnabled(LogModule module, LogLevel level);
+void logSetLevel(LogModule module, LogLevel level);
+
+// Names as used on the wire ("audio", "debug", ...). false if unknown.
+bool logModuleFromName(const char *name, LogModule &out);
+bool logLevelFromName(const char *name, LogLevel &out);
+
+// Format everything not yet printed to Serial now, from the caller (before a
+// restart, where the task would not get to it).
+void logFlush();
+
+// The newest `count` records (at most LOG_FETCH_MAX), oldest first, as
+// [ms, "level", "module", "text"] arrays appended to out. Formats them here:
+// loop() context, on request only. Returns how many were written.
+size_t logWriteRecent(JsonArray out, size_t count);
@@ -1,18 +1,37 @@
 #include <Arduino.h>
 #include <Wire.h>
 #include <WiFi.h>
-#include <driver/i2s.h>
-#include <WebSocketsClient.h>
 #include <ArduinoJson.h>
 #include <Adafruit_XCA9554.h>
 #include <Arduino_GFX_Library.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
 
 #include <Preferences.h>
+#include <esp_heap_caps.h>
 
 #include "pins.h"
 #include "config.h"
 #include "provisioning.h"
 #include "ota.h"
+#include "audio.h"
+#include "bands.h"
+#include "levelstats.h"
+#include "telemetry.h"
+#include "canvas.h"
+#include "mapper.h"
+#include "backlog.h"
+#include "wallclock.h"
+#include "boottrace.h"
+#include "tls.h"
+#include "wsclient.h"
+#include "metrics.h"
+#include "logring.h"
+#include "msgarena.h"
+#include "report.h"
+
+static_assert(MSG_FRAME_HEADER_ROOM == WEBSOCKETS_MAX_HEADER_SIZE, "frame header room must match the websocket client");
 
 // --- Display (QSPI SH8601 AMOLED) ---
 Arduino_DataBus *qspi_bus = new Arduino_ESP32QSPI(
@@ -20,28 +39,60 @@ Arduino_DataBus *qspi_bus = new Arduino_ESP32QSPI(
     PIN_LCD_DATA0, PIN_LCD_DATA1, PIN_LCD_DATA2, PIN_LCD_DATA3
 );
 Arduino_SH8601 *amoled = new Arduino_SH8601(qspi_bus, -1, 0, LCD_WIDTH, LCD_HEIGHT);
-Arduino_GFX *gfx = amoled;
+Arduino_GFX *gfx = amoled;  // provisioning/OTA pages draw straight to the panel
+DirtyCanvas *ui = new DirtyCanvas(LCD_WIDTH, LCD_HEIGHT, amoled, qspi_bus);  // status screen
 
 // --- Globals ---
 Adafruit_XCA9554 expander;
-WebSocketsClient ws;
+WsClient ws;
+static MsgArena txArena;  // the document being sent, loop() only
+static MsgArena rxArena;  // the message being handled in webSocketEvent()
 
 static String deviceId;
 static String wsHost;
 static String accountId;
 static float currentDbFS = -60.0;
 static bool wsConnected = false;
+static bool binaryTelemetry = false; // server accepted binary frames in "registered"
+static bool deviceControl = false;   // server accepted on-device volume control in "registered"
 static bool wifiConnected = false;
 static bool displayReady = false;
 static unsigned long lastDbSend = 0;
-static unsigned long lastDbCalc = 0;
+static unsigned long lastBacklogSend = 0;
+static unsigned long lastStatsSend = 0;
 static unsigned long lastDisplayUpdate = 0;
 static unsigned long lastWiFiRetry = 0;
 static int consecutiveWiFiFailures = 0;
 static bool everConnected = false; // have we ever had a working WiFi connection?
-
-#define I2S_PORT I2S_NUM_0
-#define DISPLAY_UPDATE_INTERVAL 200  // ms between display redraws
+static uint32_t wsConnectMs = 0;    // boot-to-websocket time of the first connection
+static bool registerPending = false; // connected; "register" goes out from loop()
+static bool firstLevelSent = false;  // a reading went out since the last connect
+static size_t logsRequested = 0;     // "get_logs" record count, answered from loop()
+static bool wsStarted = false;       // initWebSocket() has run since boot
+static uint32_t wsConnectingMs = 0;  // ws.loop() time spent on the connect in progress
+static volatile bool earlyConnectStop = false;
+static SemaphoreHandle_t earlyConnectDone = nullptr;  // given when the task exits
+
+#define DISPLAY_UPDATE_INTERVAL 200  // ms between display refreshes (unchanged widgets are skipped)
+
+// Level bar geometry
+#define BAR_X  12
+#define BAR_Y  145
+#define BAR_W  (LCD_WIDTH - 24)
+#define BAR_H  30
+
+// Last value drawn per status-screen widget; cleared by drawStaticUI().
+static struct {
+  bool valid;
+  int dbTenths;
+  int barW;
+  int levelClass;
+  bool wifi;
+  bool ws;
+  uint32_t ip;
+  int rssi;
+  unsigned long uptimeSec;
+} shown;
 
 // Colors
 #define COLOR_BG       0x0000  // Black
@@ -59,15 +110,20 @@ static bool everConnected = false; // have we ever had a working WiFi connection
 void initI2C();
 void initTCA9554();
 void initES8311();
-void initI2S();
 void initDisplay();
 void initWebSocket();
-void calculateDb();
+void sendRegister();
 void sendSoundLevel();
+void sendTelemetryFrame();
+void runVolumeControl(unsigned long now);
+void sendBacklogFrame();
+void sendStats();
+void sendLogs(size_t count);
 void updateDisplay();
 void drawStaticUI();
 void webSocketEvent(WStype_t type, uint8_t *payload, size_t length);
 const char* wifiStatusStr(wl_status_t status);
+Weighting loadWeighting();
 
 // OTA hooks: free the websocket before a TLS download, restore it if the update
 // fails (on success the device reboots into the new image).
@@ -90,150 +146,273 @@ uint8_t es8311Read(uint8_t reg) {
   return Wire.read();
 }
 
+// ws.loop(), timed into METRIC_WS_LOOP_US. The calls made while connecting are
+// also summed per connect: TCP, TLS and the upgrade all run inside them,
+// blocking the caller.
+static void wsLoop() {
+  bool connecting = !wsConnected;
+  unsigned long t0 = millis();
+  uint32_t us = micros();
+  ws.loop();
+  metricsObserve(METRIC_WS_LOOP_US, micros() - us);
+  if (!connecting) return;
+  wsConnectingMs += millis() - t0;
+  if (wsConnected) {
+    tlsNoteWebsocketConnect(wsConnectingMs);
+    wsConnectingMs = 0;
+  }
+}
+
+// Boot-time connect: waits for the WiFi association provisioningBegin() started,
+// then runs the websocket's TCP/TLS/upgrade handshake, all while setup() brings
+// up the codec, display and touch. It only ever touches `ws` before setup()
+// joins it (stopEarlyConnect()); loop() owns the socket from then on. The
+// CONNECTED event only flags "register" for loop(), so nothing else runs here.
+static void earlyConnectTask(void *) {
+  while (!earlyConnectStop && WiFi.status() != WL_CONNECTED) vTaskDelay(pdMS_TO_TICKS(20));
+  if (!earlyConnectStop) {
+    wallclockStartNtp();
+    initWebSocket();
+    while (!earlyConnectStop && !wsConnected) {
+      wsLoop();
+      vTaskDelay(pdMS_TO_TICKS(5));
+    }
+  }
+  xSemaphoreGive(earlyConnectDone);
+  vTaskDelete(nullptr);
+}
+
+static void stopEarlyConnect() {
+  earlyConnectStop = true;
+  xSemaphoreTake(earlyConnectDone, portMAX_DELAY);
+}
+
 // --- Setup ---
 void setup() {
   Serial.begin(115200);
-  delay(1000);
   Serial.println("\n=== Soundtrack Auto-Volume ESP32 ===");
   Serial.printf("Firmware: %s\n", FW_VERSION);
+  logInit();
+  // Message memory, before the connect task can receive anything.
+  if (!txArena.begin(MSG_TX_ARENA_BYTES) || !rxArena.begin(MSG_RX_ARENA_BYTES) || !msgTxBufferInit()) {
+    LOGE(LOG_SYS, "message memory allocation failed - websocket messages disabled");
+  }
 
   // Before anything else: if a freshly-OTA'd image has failed to reach the
   // server across several reboots, revert to the previous known-good image.
   otaBootCheck();
-
-  initI2C();
-  initTCA9554();
-  initDisplay();
-
-  // Now that the display exists, give OTA its screen + websocket teardown hooks.
-  otaInit(gfx, otaBeforeUpdate, otaAfterFailedUpdate);
+  bootMark("ota_check");
 
   // Generate device ID from MAC
   WiFi.mode(WIFI_STA);
-  delay(100);
   uint8_t mac[6];
   WiFi.macAddress(mac);
   char macStr[13];
   snprintf(macStr, sizeof(macStr), "%02x%02x%02x%02x%02x%02x",
            mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
   deviceId = String(DEVICE_ID_PREFIX) + macStr;
-  Serial.printf("Device ID: %s\n", deviceId.c_str());
+  LOGI(LOG_SYS, "Device ID: %s", deviceId.c_str());
+
+  // Server URL is hardcoded, account ID from NVS
+  wsHost = DEFAULT_WS_HOST;
+  accountId = getAccountId();
+  LOGI(LOG_SYS, "Server: %s", wsHost.c_str());
+  LOGI(LOG_SYS, "Account: %s", accountId.length() > 0 ? accountId.c_str() : "(none)");
+
+  // Start WiFi (and, once associated, the websocket handshake) now, so both run
+  // alongside the hardware init below instead of after it.
+  provisioningBegin();
+  earlyConnectDone = xSemaphoreCreateBinary();
+  xTaskCreatePinnedToCore(earlyConnectTask, "connect", EARLY_CONNECT_STACK, nullptr, 1, nullptr,
+                          EARLY_CONNECT_CORE);
+  bootMark("wifi_begin");
+
+  initI2C();
+  wallclockInit();  // RTC time until NTP answers
+  initTCA9554();
+  bootMark("i2c");
+  initDisplay();
+  bootMark("display");
+
+  // Now that the display exists, give OTA its screen + websocket teardown hooks.
+  otaInit(gfx, otaBeforeUpdate, otaAfterFailedUpdate);
 
   // Boot touch: short tap = change WiFi (Account ID preserved), long 5s hold = factory reset.
   bool changeWifiRequested = checkTouchAction(gfx);
+  bootMark("touch");
 
   initES8311();
-  initI2S();
-
-  // WiFi provisioning. A boot tap forces the setup portal while keeping the
-  // assigned account; otherwise connect with stored creds (portal only if none).
-  bool connected = changeWifiRequested ? startCaptivePortal(gfx) : provisioningInit(gfx);
+  audioInit(loadWeighting());  // starts the continuous capture task
+  backlogInit();
+  bootMark("audio");
+
+  // WiFi provisioning. A boot tap opens the setup portal while keeping the
+  // assigned account; otherwise wait for the stored network (portal only if it
+  // never comes). The portal runs from loop(), so setup() never waits on it.
+  bool connected = false;
+  if (changeWifiRequested) {
+    stopEarlyConnect();
+    portalStart(gfx, false);
+  } else {
+    connected = provisioningInit(gfx);
+    stopEarlyConnect();
+  }
   if (connected) {
     wifiConnected = true;
     everConnected = true;
     consecutiveWiFiFailures = 0;
-    Serial.printf("WiFi connected! IP: %s\n", WiFi.localIP().toString().c_str());
-
-    // Server URL is hardcoded, account ID from NVS
-    wsHost = DEFAULT_WS_HOST;
-    accountId = getAccountId();
-    Serial.printf("Server: %s\n", wsHost.c_str());
-    Serial.printf("Account: %s\n", accountId.length() > 0 ? accountId.c_str() : "(none)");
+    bootMark("wifi");
 
-    initWebSocket();
+    if (!wsStarted) {
+      wallclockStartNtp();
+      initWebSocket();
+    }
 
     // Draw normal UI
     if (displayReady) {
-      gfx->fillScreen(COLOR_BG);
       drawStaticUI();
     }
   } else {
-    Serial.println("WiFi not connected - will retry in loop");
+    LOGI(LOG_SYS, "%s", portalActive() ? "Setup portal open - serviced from loop" : "WiFi not connected - will retry in loop");
   }
 
-  Serial.println("Setup complete!");
+  bootMark("setup");
+  LOGI(LOG_SYS, "Setup complete!");
 }
 
 // --- Main loop ---
 void loop() {
   unsigned long now = millis();
+  static uint32_t lastLoopUs = 0;
+  uint32_t loopUs = micros();
+  if (lastLoopUs) metricsObserve(METRIC_LOOP_US, loopUs - lastLoopUs);
+  lastLoopUs = loopUs;
+  wallclockLoop();
 
   // Check WiFi and reconnect if needed
   if (WiFi.status() != WL_CONNECTED) {
     if (wifiConnected) {
-      Serial.println("WiFi lost!");
+      LOGW(LOG_WIFI, "WiFi lost!");
+      metricsCount(METRIC_WIFI_LOST);
       wifiConnected = false;
       wsConnected = false;
     }
 
-    if (now - lastWiFiRetry >= WIFI_RETRY_DELAY) {
+    if (portalActive()) {
+      // The portal retries the stored network itself (unless the user asked for
+      // a new one); once it times out, the STA retries below take over again.
+      if (!portalLoop(now)) {
+        lastWiFiRetry = now;
+        if (displayReady) drawStaticUI();
+      }
+    } else if (now - lastWiFiRetry >= WIFI_RETRY_DELAY) {
       lastWiFiRetry = now;
       consecutiveWiFiFailures++;
       // Be patient when creds were known-good (ride out transient outages on STA);
       // re-offer setup promptly when we have no working network yet.
       int threshold = everConnected ? WIFI_RETRIES_CONNECTED : WIFI_RETRIES_FRESH;
-      Serial.printf("WiFi retry %d/%d (status=%s)\n", consecutiveWiFiFailures, threshold, wifiStatusStr(WiFi.status()));
-      WiFi.reconnect();
+      LOGI(LOG_WIFI, "WiFi retry %d/%d (status=%s)", consecutiveWiFiFailures, threshold, wifiStatusStr(WiFi.status()));
+      wifiReconnect();
+      metricsCount(METRIC_WIFI_RETRIES);
 
       // Sustained failure → re-open the NON-DESTRUCTIVE setup portal so the device
       // is always recoverable (bad/changed creds, or a missed first-time setup
-      // window) without ever wiping known-good credentials.
+      // window) without ever wiping known-good credentials. It keeps retrying
+      // the stored network and closes the moment that connects.
       if (consecutiveWiFiFailures >= threshold) {
-        Serial.println("Sustained WiFi failure — re-opening setup portal...");
+        LOGW(LOG_WIFI, "Sustained WiFi failure — re-opening setup portal...");
         consecutiveWiFiFailures = 0;
-        bool connected = startCaptivePortal(gfx);
-        if (connected) {
-          wifiConnected = true;
-          everConnected = true;
-          wsHost = DEFAULT_WS_HOST;
-          accountId = getAccountId();
-          initWebSocket();
-          if (displayReady) {
-            gfx->fillScreen(COLOR_BG);
-            drawStaticUI();
-          }
-        }
-        return;
+        metricsCount(METRIC_PORTAL_OPENS);
+        portalStart(gfx, true);
       }
     }
 
-    // Still update display while waiting for WiFi
-    if (displayReady && now - lastDisplayUpdate >= DISPLAY_UPDATE_INTERVAL) {
+    // Still update display (and keep readings for the server) while waiting for
+    // WiFi. The setup portal owns the screen while it is open.
+    currentDbFS = audioGetDbFS();
+    if (now - lastDbSend >= DB_SEND_INTERVAL) {
+      lastDbSend = now;
+      backlogPush(now, currentDbFS);
+    }
+    if (displayReady && !portalActive() && now - lastDisplayUpdate >= DISPLAY_UPDATE_INTERVAL) {
       lastDisplayUpdate = now;
       updateDisplay();
     }
     return;
   }
 
+  // Connected with the portal still up: new creds were saved, or the stored
+  // network came back. Either way setup is done.
+  if (portalActive()) portalStop();
+
   if (!wifiConnected) {
     wifiConnected = true;
     everConnected = true;
     consecutiveWiFiFailures = 0;
-    Serial.printf("WiFi connected! IP: %s\n", WiFi.localIP().toString().c_str());
-    Serial.printf("RSSI: %d dBm\n", WiFi.RSSI());
+    LOGI(LOG_WIFI, "WiFi connected! IP: %s", WiFi.localIP().toString().c_str());
+    LOGI(LOG_WIFI, "RSSI: %d dBm", WiFi.RSSI());
+    wifiOnConnected();
 
     wsHost = DEFAULT_WS_HOST;
     accountId = getAccountId();
+    wallclockStartNtp();
     initWebSocket();
 
     if (displayReady) {
-      gfx->fillScreen(COLOR_BG);
       drawStaticUI();
     }
   }
 
-  ws.loop();
-
-  // Calculate dB periodically
-  if (now - lastDbCalc >= DB_CALC_INTERVAL) {
-    lastDbCalc = now;
-    calculateDb();
+  wsLoop();
+  if (registerPending) {
+    registerPending = false;
+    if (wsConnected) sendRegister();
   }
 
-  // Send sound level to server periodically
-  if (now - lastDbSend >= DB_SEND_INTERVAL && wsConnected) {
+  // Measurement runs continuously in the capture task; just pick up its level.
+  currentDbFS = audioGetDbFS();
+
+  // Send sound level to server periodically: batched binary frames when the
+  // server negotiated them, one JSON message per reading otherwise. Readings
+  // taken while the socket is down go to the backlog. While connected only the
+  // readings report.h picks go out; a batched reading is not held for a
+  // partner that may never come, so a change reaches the server at once.
+  if (now - lastDbSend >= DB_SEND_INTERVAL) {
     lastDbSend = now;
-    sendSoundLevel();
+    if (!wsConnected) {
+      backlogPush(now, currentDbFS);
+    } else {
+      LevelPercentiles pct[LEVELSTATS_WINDOWS];
+      size_t pctCount = levelStatsGet(pct);
+      bool due = reportDue(now, currentDbFS, pct, pctCount);
+      metricsCount(due ? METRIC_READINGS_SENT : METRIC_READINGS_SKIPPED);
+      if (!due) {
+        if (binaryTelemetry && telemetryPending() > 0) sendTelemetryFrame();
+      } else if (binaryTelemetry) {
+        telemetryPush(now, currentDbFS);
+        // The first reading after connecting goes out at once; batch after that.
+        if (telemetryPending() >= TELEMETRY_BATCH_SIZE || !firstLevelSent) sendTelemetryFrame();
+      } else {
+        sendSoundLevel();
+      }
+    }
+    if (wsConnected && deviceControl) runVolumeControl(now);
+  }
+
+  // Catch up on the outage backlog at a bounded rate, alongside live readings.
+  if (binaryTelemetry && backlogCount() > 0 && now - lastBacklogSend >= BACKLOG_DRAIN_INTERVAL_MS) {
+    lastBacklogSend = now;
+    sendBacklogFrame();
+  }
+
+  if (wsConnected && now - lastStatsSend >= STATS_INTERVAL_MS) {
+    lastStatsSend = now;
+    sendStats();
+  }
+
+  if (wsConnected && logsRequested > 0) {
+    sendLogs(logsRequested);
+    logsRequested = 0;
   }
 
   // Update display
@@ -248,17 +427,17 @@ void loop() {
 
 // --- I2C Init ---
 void initI2C() {
-  Serial.println("Init I2C...");
+  LOGI(LOG_SYS, "Init I2C...");
   Wire.begin(PIN_I2C_SDA, PIN_I2C_SCL);
   Wire.setClock(400000);
-  Serial.println("I2C OK");
+  LOGI(LOG_SYS, "I2C OK");
 }
 
 // --- TCA9554 IO Expander Init ---
 void initTCA9554() {
-  Serial.println("Init TCA9554...");
+  LOGI(LOG_SYS, "Init TCA9554...");
   if (!expander.begin(ADDR_TCA9554, &Wire)) {
-    Serial.println("ERROR: TCA9554 not found!");
+    LOGE(LOG_SYS, "TCA9554 not found!");
     return;
   }
 
@@ -275,209 +454,240 @@ void initTCA9554() {
   expander.digitalWrite(EXIO_DISPLAY_RST, HIGH);
   delay(100);
 
-  Serial.println("TCA9554 OK");
+  LOGI(LOG_SYS, "TCA9554 OK");
 }
 
 // --- AMOLED Display Init ---
 void initDisplay() {
-  Serial.println("Init AMOLED display...");
+  LOGI(LOG_SYS, "Init AMOLED display...");
 
   if (!gfx->begin()) {
-    Serial.println("ERROR: Display init failed!");
+    LOGE(LOG_SYS, "Display init failed!");
     return;
   }
 
   amoled->setBrightness(255);
   gfx->fillScreen(COLOR_BG);
+  if (!ui->begin()) return;  // no framebuffer: leave the display off
   displayReady = true;
 
-  Serial.println("AMOLED display OK");
+  LOGI(LOG_SYS, "AMOLED display OK");
 }
 
 // --- Draw static parts of the UI (called once after WiFi connects) ---
 void drawStaticUI() {
+  // The panel may be showing a provisioning/OTA page drawn around the canvas:
+  // repaint everything on the next flush and redraw every widget.
+  ui->fillScreen(COLOR_BG);
+  ui->invalidate();
+  shown.valid = false;
+
   // Header bar
-  gfx->fillRect(0, 0, LCD_WIDTH, 40, COLOR_HEADER);
-  gfx->setTextColor(COLOR_TEXT);
-  gfx->setTextSize(2);
-  gfx->setCursor(12, 10);
-  gfx->print("Auto-Volume");
+  ui->fillRect(0, 0, LCD_WIDTH, 40, COLOR_HEADER);
+  ui->setTextColor(COLOR_TEXT);
+  ui->setTextSize(2);
+  ui->setCursor(12, 10);
+  ui->print("Auto-Volume");
 
   // Divider
-  gfx->drawFastHLine(0, 40, LCD_WIDTH, COLOR_DIM);
+  ui->drawFastHLine(0, 40, LCD_WIDTH, COLOR_DIM);
 
   // Section: Sound Level
-  gfx->setTextColor(COLOR_DIM);
-  gfx->setTextSize(1);
-  gfx->setCursor(12, 54);
-  gfx->print("SOUND LEVEL");
+  ui->setTextColor(COLOR_DIM);
+  ui->setTextSize(1);
+  ui->setCursor(12, 54);
+  ui->print("SOUND LEVEL");
+
+  // Level bar scale markers
+  ui->setCursor(BAR_X, BAR_Y + BAR_H + 4);
+  ui->print("-90");
+  ui->setCursor(BAR_X + BAR_W / 2 - 12, BAR_Y + BAR_H + 4);
+  ui->print("-45");
+  ui->setCursor(BAR_X + BAR_W - 8, BAR_Y + BAR_H + 4);
+  ui->print("0");
 
   // Section: Status
-  gfx->setCursor(12, 258);
-  gfx->print("STATUS");
-  gfx->drawFastHLine(12, 270, LCD_WIDTH - 24, COLOR_HEADER);
+  ui->setCursor(12, 258);
+  ui->print("STATUS");
+  ui->drawFastHLine(12, 270, LCD_WIDTH - 24, COLOR_HEADER);
 
   // Section: Device
-  gfx->setCursor(12, 360);
-  gfx->print("DEVICE");
-  gfx->drawFastHLine(12, 372, LCD_WIDTH - 24, COLOR_HEADER);
+  ui->setCursor(12, 360);
+  ui->print("DEVICE");
+  ui->drawFastHLine(12, 372, LCD_WIDTH - 24, COLOR_HEADER);
 
   // Device ID (static)
-  gfx->setTextColor(COLOR_DIM);
-  gfx->setTextSize(1);
-  gfx->setCursor(12, 382);
-  gfx->print("ID: ");
-  gfx->setTextColor(COLOR_TEXT);
-  gfx->print(deviceId.c_str());
+  ui->setTextColor(COLOR_DIM);
+  ui->setTextSize(1);
+  ui->setCursor(12, 382);
+  ui->print("ID: ");
+  ui->setTextColor(COLOR_TEXT);
+  ui->print(deviceId.c_str());
 
   // Account ID (if set)
   if (accountId.length() > 0) {
-    gfx->setTextColor(COLOR_DIM);
-    gfx->setCursor(12, 398);
-    gfx->print("Acct: ");
-    gfx->setTextColor(COLOR_CYAN);
+    ui->setTextColor(COLOR_DIM);
+    ui->setCursor(12, 398);
+    ui->print("Acct: ");
+    ui->setTextColor(COLOR_CYAN);
     // Truncate long account IDs for display
     if (accountId.length() > 30) {
-      gfx->print(accountId.substring(0, 27).c_str());
-      gfx->print("...");
+      ui->print(accountId.substring(0, 27).c_str());
+      ui->print("...");
     } else {
-      gfx->print(accountId.c_str());
+      ui->print(accountId.c_str());
     }
   }
+
+  ui->flush();
 }
 
 // --- Update dynamic parts of the display ---
+// Each widget is redrawn only when the value it shows has changed, and the
+// canvas then pushes only the tiles whose pixels actually differ.
 void updateDisplay() {
+  int dbTenths = (int)lroundf(currentDbFS * 10.0f);
+  int levelClass = currentDbFS > -15 ? 3 : currentDbFS > -30 ? 2 : currentDbFS > -50 ? 1 : 0;
+  static const uint16_t levelColors[] = {COLOR_DIM, COLOR_GREEN, COLOR_ORANGE, COLOR_RED};
+  static const char *levelNames[] = {"SILENT", "QUIET", "MODERATE", "LOUD"};
+  uint16_t dbColor = levelColors[levelClass];
+
   // --- dB value (large) ---
-  gfx->fillRect(12, 72, 344, 60, COLOR_BG);
-  gfx->setTextSize(5);
-
-  uint16_t dbColor;
-  if (currentDbFS > -15) {
-    dbColor = COLOR_RED;
-  } else if (currentDbFS > -30) {
-    dbColor = COLOR_ORANGE;
-  } else if (currentDbFS > -50) {
-    dbColor = COLOR_GREEN;
-  } else {
-    dbColor = COLOR_DIM;
+  if (!shown.valid || dbTenths != shown.dbTenths) {
+    shown.dbTenths = dbTenths;
+    ui->fillRect(12, 72, 344, 60, COLOR_BG);
+    ui->setTextSize(5);
+    ui->setTextColor(dbColor);
+    ui->setCursor(12, 74);
+    char dbStr[16];
+    snprintf(dbStr, sizeof(dbStr), "%.1f", dbTenths / 10.0f);
+    ui->print(dbStr);
+
+    // Unit label
+    ui->setTextSize(2);
+    ui->setTextColor(COLOR_DIM);
+    ui->setCursor(280, 90);
+    ui->print("dBFS");
   }
 
-  gfx->setTextColor(dbColor);
-  gfx->setCursor(12, 74);
-  char dbStr[16];
-  snprintf(dbStr, sizeof(dbStr), "%.1f", currentDbFS);
-  gfx->print(dbStr);
-
-  // Unit label
-  gfx->setTextSize(2);
-  gfx->setTextColor(COLOR_DIM);
-  gfx->setCursor(280, 90);
-  gfx->print("dBFS");
-
   // --- Level bar ---
-  int barX = 12;
-  int barY = 145;
-  int barW = LCD_WIDTH - 24;
-  int barH = 30;
-
   float normalized = (currentDbFS + 90.0f) / 90.0f;
   if (normalized < 0) normalized = 0;
   if (normalized > 1) normalized = 1;
-  int fillW = (int)(normalized * barW);
-
-  gfx->fillRect(barX, barY, barW, barH, COLOR_BAR_BG);
-
-  if (fillW > 0) {
-    uint16_t barColor;
-    if (normalized > 0.83f) barColor = COLOR_RED;
-    else if (normalized > 0.67f) barColor = COLOR_ORANGE;
-    else if (normalized > 0.44f) barColor = COLOR_YELLOW;
-    else barColor = COLOR_GREEN;
-    gfx->fillRect(barX, barY, fillW, barH, barColor);
+  int fillW = (int)(normalized * BAR_W);
+
+  if (!shown.valid || fillW != shown.barW) {
+    shown.barW = fillW;
+    ui->fillRect(BAR_X, BAR_Y, BAR_W, BAR_H, COLOR_BAR_BG);
+    if (fillW > 0) {
+      uint16_t barColor;
+      if (normalized > 0.83f) barColor = COLOR_RED;
+      else if (normalized > 0.67f) barColor = COLOR_ORANGE;
+      else if (normalized > 0.44f) barColor = COLOR_YELLOW;
+      else barColor = COLOR_GREEN;
+      ui->fillRect(BAR_X, BAR_Y, fillW, BAR_H, barColor);
+    }
   }
 
-  // Scale markers
-  gfx->setTextSize(1);
-  gfx->setTextColor(COLOR_DIM);
-  gfx->setCursor(barX, barY + barH + 4);
-  gfx->print("-90");
-  gfx->setCursor(barX + barW / 2 - 12, barY + barH + 4);
-  gfx->print("-45");
-  gfx->setCursor(barX + barW - 8, barY + barH + 4);
-  gfx->print("0");
-
   // --- Peak indicator ---
-  gfx->fillRect(12, 200, 344, 40, COLOR_BG);
-  gfx->setTextSize(2);
-  gfx->setTextColor(COLOR_DIM);
-  gfx->setCursor(12, 210);
-  gfx->print("Level: ");
-  gfx->setTextColor(dbColor);
-  if (currentDbFS > -15) gfx->print("LOUD");
-  else if (currentDbFS > -30) gfx->print("MODERATE");
-  else if (currentDbFS > -50) gfx->print("QUIET");
-  else gfx->print("SILENT");
+  if (!shown.valid || levelClass != shown.levelClass) {
+    shown.levelClass = levelClass;
+    ui->fillRect(12, 200, 344, 40, COLOR_BG);
+    ui->setTextSize(2);
+    ui->setTextColor(COLOR_DIM);
+    ui->setCursor(12, 210);
+    ui->print("Level: ");
+    ui->setTextColor(dbColor);
+    ui->print(levelNames[levelClass]);
+  }
 
   // --- Status section ---
-  gfx->fillRect(12, 278, 344, 70, COLOR_BG);
-  gfx->setTextSize(2);
-
-  // WiFi status
-  gfx->setCursor(12, 280);
-  gfx->setTextColor(COLOR_DIM);
-  gfx->print("WiFi ");
-  if (wifiConnected) {
-    gfx->setTextColor(COLOR_GREEN);
-    gfx->print("Connected");
-    gfx->setTextSize(1);
-    gfx->setTextColor(COLOR_DIM);
-    gfx->setCursor(12, 300);
-    gfx->printf("%s  %d dBm", WiFi.localIP().toString().c_str(), WiFi.RSSI());
-  } else {
-    gfx->setTextColor(COLOR_RED);
-    gfx->print("Disconnected");
-  }
+  int rssi = WiFi.RSSI();
+  uint32_t ip = wifiConnected ? (uint32_t)WiFi.localIP() : 0;
+  if (!shown.valid || wifiConnected != shown.wifi || wsConnected != shown.ws ||
+      ip != shown.ip || rssi != shown.rssi) {
+    shown.wifi = wifiConnected;
+    shown.ws = wsConnected;
+    shown.ip = ip;
+    shown.rssi = rssi;
+    ui->fillRect(12, 278, 344, 70, COLOR_BG);
+    ui->setTextSize(2);
+
+    // WiFi status
+    ui->setCursor(12, 280);
+    ui->setTextColor(COLOR_DIM);
+    ui->print("WiFi ");
+    if (wifiConnected) {
+      ui->setTextColor(COLOR_GREEN);
+      ui->print("Connected");
+      ui->setTextSize(1);
+      ui->setTextColor(COLOR_DIM);
+      ui->setCursor(12, 300);
+      ui->printf("%u.%u.%u.%u  %d dBm", ip & 0xFF, (ip >> 8) & 0xFF, (ip >> 16) & 0xFF, ip >> 24, rssi);
+    } else {
+      ui->setTextColor(COLOR_RED);
+      ui->print("Disconnected");
+    }
 
-  // WebSocket status
-  gfx->setTextSize(2);
-  gfx->setCursor(12, 320);
-  gfx->setTextColor(COLOR_DIM);
-  gfx->print("Server ");
-  if (wsConnected) {
-    gfx->setTextColor(COLOR_GREEN);
-    gfx->print("Online");
-  } else {
-    gfx->setTextColor(COLOR_YELLOW);
-    gfx->print("Offline");
+    // WebSocket status
+    ui->setTextSize(2);
+    ui->setCursor(12, 320);
+    ui->setTextColor(COLOR_DIM);
+    ui->print("Server ");
+    if (wsConnected) {
+      ui->setTextColor(COLOR_GREEN);
+      ui->print("Online");
+    } else {
+      ui->setTextColor(COLOR_YELLOW);
+      ui->print("Offline");
+    }
   }
 
   // --- Uptime ---
-  int uptimeY = accountId.length() > 0 ? 416 : 398;
-  gfx->fillRect(12, uptimeY, 344, 30, COLOR_BG);
-  gfx->setTextSize(1);
-  gfx->setTextColor(COLOR_DIM);
-  gfx->setCursor(12, uptimeY);
   unsigned long uptimeSec = millis() / 1000;
-  unsigned long h = uptimeSec / 3600;
-  unsigned long m = (uptimeSec % 3600) / 60;
-  unsigned long s = uptimeSec % 60;
-  gfx->printf("Up: %02lu:%02lu:%02lu  FW: %s  %ddBm", h, m, s, FW_VERSION, WiFi.RSSI());
+  if (!shown.valid || uptimeSec != shown.uptimeSec) {
+    shown.uptimeSec = uptimeSec;
+    int uptimeY = accountId.length() > 0 ? 416 : 398;
+    ui->fillRect(12, uptimeY, 344, 30, COLOR_BG);
+    ui->setTextSize(1);
+    ui->setTextColor(COLOR_DIM);
+    ui->setCursor(12, uptimeY);
+    unsigned long h = uptimeSec / 3600;
+    unsigned long m = (uptimeSec % 3600) / 60;
+    unsigned long s = uptimeSec % 60;
+    ui->printf("Up: %02lu:%02lu:%02lu  FW: %s  %ddBm", h, m, s, FW_VERSION, rssi);
+  }
+
+  shown.valid = true;
+  ui->flush();
+
+  // Light diagnostics: QSPI traffic the status screen actually costs.
+  static uint32_t flushes = 0, bytes = 0, maxUs = 0;
+  static unsigned long lastReport = 0;
+  flushes++;
+  bytes += ui->lastFlushBytes();
+  if (ui->lastFlushMicros() > maxUs) maxUs = ui->lastFlushMicros();
+  if (millis() - lastReport >= 60000) {
+    lastReport = millis();
+    LOGD(LOG_SYS, "display: %u frames, %u B/frame avg, max %u us/frame",
+                  (unsigned)flushes, (unsigned)(bytes / flushes), (unsigned)maxUs);
+    flushes = bytes = maxUs = 0;
+  }
 }
 
 // --- ES8311 Codec Init ---
 void initES8311() {
-  Serial.println("Init ES8311...");
+  LOGI(LOG_SYS, "Init ES8311...");
 
   Wire.beginTransmission(ADDR_ES8311);
   if (Wire.endTransmission() != 0) {
-    Serial.println("ERROR: ES8311 not found on I2C!");
+    LOGE(LOG_SYS, "ES8311 not found on I2C!");
     return;
   }
 
   uint8_t id1 = es8311Read(0xFD);
   uint8_t id2 = es8311Read(0xFE);
-  Serial.printf("ES8311 Chip ID: 0x%02X 0x%02X\n", id1, id2);
+  LOGI(LOG_SYS, "ES8311 Chip ID: 0x%02X 0x%02X", id1, id2);
 
   es8311Write(0x00, 0x1F);
   delay(20);
@@ -513,51 +723,19 @@ void initES8311() {
   es8311Write(0x32, 0xBF);
   es8311Write(0x37, 0x08);
 
-  Serial.println("ES8311 OK");
+  LOGI(LOG_SYS, "ES8311 OK");
 }
 
-// --- I2S Init (ESP-IDF driver) ---
-void initI2S() {
-  Serial.println("Init I2S...");
-
-  i2s_config_t i2s_config = {
-    .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_TX),
-    .sample_rate = SAMPLE_RATE,
-    .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
-    .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,
-    .communication_format = I2S_COMM_FORMAT_STAND_I2S,
-    .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-    .dma_buf_count = 4,
-    .dma_buf_len = 256,
-    .use_apll = false,
-    .tx_desc_auto_clear = true,
-    .fixed_mclk = 0,
-    .mclk_multiple = I2S_MCLK_MULTIPLE_256,
-    .bits_per_chan = I2S_BITS_PER_CHAN_16BIT,
-  };
-
-  i2s_pin_config_t pin_config = {
-    .mck_io_num = PIN_I2S_MCLK,
-    .bck_io_num = PIN_I2S_BCLK,
-    .ws_io_num = PIN_I2S_LRCK,
-    .data_out_num = PIN_I2S_DOUT,
-    .data_in_num = PIN_I2S_DIN,
-  };
-
-  esp_err_t err = i2s_driver_install(I2S_PORT, &i2s_config, 0, NULL);
-  if (err != ESP_OK) {
-    Serial.printf("ERROR: I2S driver install failed: %d\n", err);
-    return;
-  }
-
-  err = i2s_set_pin(I2S_PORT, &pin_config);
-  if (err != ESP_OK) {
-    Serial.printf("ERROR: I2S set pin failed: %d\n", err);
-    return;
-  }
-
-  i2s_zero_dma_buffer(I2S_PORT);
-  Serial.println("I2S OK");
+// --- Level weighting from NVS (server-selected), else the compiled default ---
+Weighting loadWeighting() {
+  Preferences prefs;
+  prefs.begin("autovolume", true);
+  String name = prefs.getString(NVS_KEY_WEIGHTING, AUDIO_DEFAULT_WEIGHTING);
+  prefs.end();
+  Weighting w = WEIGHTING_Z;
+  weightingFromName(name.c_str(), w);
+  LOGI(LOG_AUDIO, "Level weighting: %s", weightingName(w));
+  return w;
 }
 
 // --- WiFi status to string ---
@@ -576,7 +754,8 @@ const char* wifiStatusStr(wl_status_t status) {
 
 // --- WebSocket Init ---
 void initWebSocket() {
-  Serial.printf("Init WebSocket to %s...\n", wsHost.c_str());
+  LOGI(LOG_WS, "Init WebSocket to %s...", wsHost.c_str());
+  wsStarted = true;
 
   if (WS_USE_SSL) {
     ws.beginSSL(wsHost.c_str(), WS_PORT, WS_PATH);
@@ -586,54 +765,206 @@ void initWebSocket() {
 
   ws.onEvent(webSocketEvent);
   ws.setReconnectInterval(WS_RETRY_DELAY);
-  Serial.println("WebSocket init done");
+  LOGI(LOG_WS, "WebSocket init done");
+}
+
+// --- Sends, counted into the metrics. Neither allocates: documents live in
+// txArena, text is serialized into the fixed tx buffer, and both kinds of frame
+// keep MSG_FRAME_HEADER_ROOM bytes in front for the websocket header (the
+// client would otherwise mask a copy of each frame). ---
+static void wsSendJson(const JsonDocument &doc) {
+  char *buf = msgTxBuffer();
+  size_t len = measureJson(doc);
+  if (!buf || doc.overflowed() || len >= msgTxBufferCap()) {
+    metricsCount(METRIC_WS_SEND_FAILED);
+    LOGW(LOG_WS, "%s not sent: %u bytes%s", doc["type"] | "?", (unsigned)len,
+         doc.overflowed() ? ", document overflowed" : "");
+    return;
+  }
+  serializeJson(doc, buf + MSG_FRAME_HEADER_ROOM, msgTxBufferCap());
+  if (ws.sendTXT((uint8_t *)buf, len, true)) metricsCount(METRIC_WS_SENT_BYTES, len);
+  else metricsCount(METRIC_WS_SEND_FAILED);
+}
+
+// frame: MSG_FRAME_HEADER_ROOM bytes of room, then len bytes of payload.
+static void wsSendBinary(uint8_t *frame, size_t len) {
+  if (ws.sendBIN(frame, len, true)) metricsCount(METRIC_WS_SENT_BYTES, len);
+  else metricsCount(METRIC_WS_SEND_FAILED);
+}
+
+// --- Register (sent from loop() after each connect) ---
+void sendRegister() {
+  JsonDocument doc(&txArena);
+  doc["type"] = "register";
+  doc["deviceId"] = deviceId;
+  doc["firmware"] = FW_VERSION;
+  JsonArray encodings = doc["encodings"].to<JsonArray>();
+  encodings.add(TELEMETRY_ENCODING);
+  encodings.add("json");
+  doc["mapper"] = MAPPER_VERSION;
+  // Boot-to-online latency of this boot (same on every register until reboot):
+  // first WiFi / websocket connection, and when each setup() phase finished.
+  JsonObject connect = doc["connect"].to<JsonObject>();
+  connect["wifiMs"] = wifiConnectMs();
+  connect["wsMs"] = wsConnectMs;
+  connect["fast"] = wifiFastConnected();
+  JsonObject boot = doc["boot"].to<JsonObject>();
+  for (size_t i = 0; i < bootPhaseCount(); i++) {
+    boot[bootPhaseName(i)] = bootPhaseMs(i);
+  }
+  // TLS handshakes since boot: OTA connections (session cache) and websocket connects.
+  const TlsStats &t = tlsStats();
+  JsonObject tls = doc["tls"].to<JsonObject>();
+  tls["full"] = t.full;
+  tls["resumed"] = t.resumed;
+  tls["failed"] = t.failed;
+  tls["fullMs"] = t.fullMs;
+  tls["resumedMs"] = t.resumedMs;
+  tls["wsConnects"] = t.wsConnects;
+  tls["wsMs"] = t.wsMs;
+  if (accountId.length() > 0) {
+    doc["accountId"] = accountId;
+  }
+  wsSendJson(doc);
+  LOGI(LOG_WS, "Sent register message (account: %s)",
+                 accountId.length() > 0 ? accountId.c_str() : "none");
+
+  // Reaching the server proves a freshly-OTA'd image is healthy.
+  otaMarkValidIfPending();
+}
+
+// --- Zone configs for on-device volume control ("registered" / "zone_configs") ---
+static void applyZoneConfigs(JsonDocument &msg) {
+  MapperZoneConfig zones[MAPPER_MAX_ZONES];
+  size_t n = 0;
+  bool devicePaused = msg["paused"] | false;
+  for (JsonObjectConst c : msg["configs"].as<JsonArrayConst>()) {
+    const char* zoneId = c["soundtrackZoneId"];
+    if (!zoneId || n == MAPPER_MAX_ZONES) continue;
+    MapperZoneConfig &z = zones[n++];
+    snprintf(z.zoneId, sizeof(z.zoneId), "%s", zoneId);
+    z.active = (c["isEnabled"] | false) && !(c["isPaused"] | false) && !devicePaused;
+    z.minVolume = c["minVolume"] | 4;
+    z.maxVolume = c["maxVolume"] | 12;
+    z.quietThresholdDb = c["quietThresholdDb"] | -74.0;
+    z.loudThresholdDb = c["loudThresholdDb"] | -45.0;
+    z.smoothingFactor = c["smoothingFactor"] | 0.2;
+    z.sustainCount = c["sustainCount"] | 2;
+    z.metric = mapperMetricFromName(c["levelMetric"]);
+  }
+  mapperSetZones(zones, n);
+  LOGI(LOG_MAPPER, "%u zone(s)%s", (unsigned)n, devicePaused ? ", device paused" : "");
+}
+
+// --- Send-on-delta parameters ("registered" / "set_reporting"); missing fields
+// keep their current value. Not persisted: the server sends them on every connect. ---
+static void applyReporting(JsonObjectConst r) {
+  ReportParams p = reportParams();
+  p.deadbandDb = constrain(r["deadbandDb"] | p.deadbandDb, 0.0f, 20.0f);
+  p.slopeDbPerS = constrain(r["slopeDbPerS"] | p.slopeDbPerS, 0.0f, 20.0f);
+  p.holdMs = constrain(r["holdS"] | p.holdMs / 1000.0f, 0.0f, 600.0f) * 1000;
+  p.heartbeatMs = constrain(r["heartbeatS"] | p.heartbeatMs / 1000.0f, 1.0f, 600.0f) * 1000;
+  reportSetParams(p);
+  LOGI(LOG_WS, "Reporting: deadband %.1f dB, slope %.1f dB/s, hold %u ms, heartbeat %u ms", p.deadbandDb,
+       p.slopeDbPerS, (unsigned)p.holdMs, (unsigned)p.heartbeatMs);
 }
 
 // --- WebSocket Event Handler ---
 void webSocketEvent(WStype_t type, uint8_t *payload, size_t length) {
   switch (type) {
     case WStype_DISCONNECTED:
-      Serial.println("WS disconnected");
+      LOGI(LOG_WS, "disconnected");
+      if (wsConnected) metricsCount(METRIC_WS_DISCONNECTS);
       wsConnected = false;
+      binaryTelemetry = false;
+      deviceControl = false;
+      telemetryDrain(backlogPush);
       break;
 
     case WStype_CONNECTED:
-      Serial.printf("WS connected to %s\n", (char *)payload);
+      LOGI(LOG_WS, "connected to %s", (char *)payload);
       wsConnected = true;
-      {
-        JsonDocument doc;
-        doc["type"] = "register";
-        doc["deviceId"] = deviceId;
-        doc["firmware"] = FW_VERSION;
-        if (accountId.length() > 0) {
-          doc["accountId"] = accountId;
-        }
-        String json;
-        serializeJson(doc, json);
-        ws.sendTXT(json);
-        Serial.printf("Sent register message (account: %s)\n",
-                       accountId.length() > 0 ? accountId.c_str() : "none");
-      }
-      // Reaching the server proves a freshly-OTA'd image is healthy.
-      otaMarkValidIfPending();
+      metricsCount(METRIC_WS_CONNECTS);
+      binaryTelemetry = false; // JSON until the server accepts binary frames
+      if (wsConnectMs == 0) wsConnectMs = millis();
+      firstLevelSent = false;
+      reportReset();
+      // May run on the boot-time connect task: loop() sends "register" (with
+      // the complete boot trace) right after its next ws.loop().
+      registerPending = true;
       break;
 
     case WStype_TEXT:
-      Serial.printf("WS received: %s\n", (char *)payload);
+      LOGD(LOG_WS, "received: %s", (char *)payload);
       {
-        JsonDocument rxDoc;
+        JsonDocument rxDoc(&rxArena);
         if (deserializeJson(rxDoc, payload, length) == DeserializationError::Ok) {
           const char* msgType = rxDoc["type"];
+          if (msgType && strcmp(msgType, "registered") == 0) {
+            const char* encoding = rxDoc["telemetry"];
+            binaryTelemetry = encoding && strcmp(encoding, TELEMETRY_ENCODING) == 0;
+            LOGI(LOG_WS, "Telemetry encoding: %s", binaryTelemetry ? TELEMETRY_ENCODING : "json");
+            if (backlogCount() > 0) {
+              LOGI(LOG_BACKLOG, "%u readings to replay%s", (unsigned)backlogCount(),
+                            binaryTelemetry ? "" : " - server takes no bin1, discarded");
+              if (!binaryTelemetry) backlogClear();
+            }
+            const char* control = rxDoc["control"];
+            deviceControl = control && strcmp(control, "device") == 0;
+            if (deviceControl) applyZoneConfigs(rxDoc);
+            LOGI(LOG_WS, "Volume control: %s", deviceControl ? "device" : "server");
+            if (rxDoc["reporting"].is<JsonObjectConst>()) applyReporting(rxDoc["reporting"]);
+          }
+          if (msgType && strcmp(msgType, "set_reporting") == 0) {
+            applyReporting(rxDoc.as<JsonObjectConst>());
+          }
+          if (msgType && strcmp(msgType, "zone_configs") == 0 && deviceControl) {
+            applyZoneConfigs(rxDoc);
+          }
+          if (msgType && strcmp(msgType, "volume_ack") == 0) {
+            JsonVariantConst online = rxDoc["playerOnline"];
+            mapperAck(rxDoc["seq"] | 0u, rxDoc["ok"] | false, online.is<bool>() && !online.as<bool>());
+          }
           if (msgType && strcmp(msgType, "factory_reset") == 0) {
-            Serial.println("Factory reset command received!");
+            LOGW(LOG_SYS, "Factory reset command received!");
             resetProvisioning();
+            logFlush();
             delay(500);
             ESP.restart();
           }
           if (msgType && strcmp(msgType, "ota_check") == 0) {
-            Serial.println("OTA check requested by server");
+            LOGI(LOG_OTA, "OTA check requested by server");
             otaRequestCheck(); // honored on next loop, never inside this callback
           }
+          if (msgType && strcmp(msgType, "set_weighting") == 0) {
+            const char* name = rxDoc["weighting"];
+            Weighting w;
+            if (weightingFromName(name, w)) {
+              Preferences prefs;
+              prefs.begin("autovolume", false);
+              prefs.putString(NVS_KEY_WEIGHTING, weightingName(w));
+              prefs.end();
+              audioSetWeighting(w);
+              LOGI(LOG_AUDIO, "Level weighting set via server: %s", weightingName(w));
+            }
+          }
+          if (msgType && strcmp(msgType, "get_logs") == 0) {
+            logsRequested = rxDoc["count"] | LOG_FETCH_MAX;
+            if (logsRequested == 0) logsRequested = 1;
+          }
+          if (msgType && strcmp(msgType, "set_log_level") == 0) {
+            // {"module": "audio" or "*", "level": "debug"}
+            const char* moduleName = rxDoc["module"] | "*";
+            LogModule module;
+            LogLevel level;
+            bool all = strcmp(moduleName, "*") == 0;
+            if (logLevelFromName(rxDoc["level"], level) && (all || logModuleFromName(moduleName, module))) {
+              for (int m = 0; m < LOG_MODULES; m++) {
+                if (all || m == module) logSetLevel((LogModule)m, level);
+              }
+              LOGI(LOG_SYS, "Log level set via server: %s %s", moduleName, (const char*)rxDoc["level"]);
+            }
+          }
           if (msgType && strcmp(msgType, "set_account") == 0) {
             const char* newAccountId = rxDoc["accountId"];
             if (newAccountId) {
@@ -642,9 +973,8 @@ void webSocketEvent(WStype_t type, uint8_t *payload, size_t length) {
               prefs.putString(NVS_KEY_ACCOUNT, newAccountId);
               prefs.end();
               accountId = String(newAccountId);
-              Serial.printf("Account assigned via server: %s\n", newAccountId);
+              LOGI(LOG_SYS, "Account assigned via server: %s", newAccountId);
               if (displayReady) {
-                gfx->fillScreen(COLOR_BG);
                 drawStaticUI();
               }
             }
@@ -654,7 +984,7 @@ void webSocketEvent(WStype_t type, uint8_t *payload, size_t length) {
       break;
 
     case WStype_ERROR:
-      Serial.println("WS error");
+      LOGW(LOG_WS, "error");
       break;
 
     default:
@@ -662,51 +992,130 @@ void webSocketEvent(WStype_t type, uint8_t *payload, size_t length) {
   }
 }
 
-// --- Calculate dBFS from I2S mic data ---
-void calculateDb() {
-  static int16_t buf[I2S_READ_BUF_SIZE / 2];
-  size_t bytesRead = 0;
+// --- Octave-band levels (63 Hz .. 4 kHz, whole dBFS), at a lower rate than dB ---
+static bool takeBandsIfDue(int8_t bands[BANDS_COUNT]) {
+  static unsigned long lastBandsSend = 0;
+  if (millis() - lastBandsSend < BANDS_REPORT_INTERVAL || !bandsTake(bands)) return false;
+  lastBandsSend = millis();
+  return true;
+}
 
-  esp_err_t err = i2s_read(I2S_PORT, buf, I2S_READ_BUF_SIZE, &bytesRead, 10);
-  if (err != ESP_OK || bytesRead == 0) return;
+// --- Percentile levels, refreshed with every reading sent. The mapper follows the
+// ones last reported, exactly as the server sees them. ---
+static LevelPercentiles reportedPct[LEVELSTATS_WINDOWS];
+static size_t reportedPctCount = 0;
 
-  int numFrames = bytesRead / 4;  // RIGHT_LEFT 16-bit => 4 bytes/frame
-  if (numFrames == 0) return;
+static void takePercentiles() { reportedPctCount = levelStatsGet(reportedPct); }
 
-  // Mono mic: the ES8311 mirrors its ADC to both I2S slots, so reading the left
-  // slot is sufficient. (The ADC only produces signal once reg 0x00 de-asserts
-  // the ADC reset — see initES8311.)
-  double sumSquares = 0;
-  for (int i = 0; i < numFrames; i++) {
-    int16_t sample = buf[i * 2];
-    sumSquares += (double)sample * sample;
+// --- Send sound level via WebSocket ---
+void sendSoundLevel() {
+  JsonDocument doc(&txArena);
+  doc["type"] = "sound_level";
+  doc["deviceId"] = deviceId;
+  doc["dbFS"] = roundf(currentDbFS * 10.0f) / 10.0;  // same tenths as bin1 and the mapper
+  doc["weighting"] = weightingName(audioGetWeighting());
+  doc["overruns"] = audioGetOverruns();
+
+  int8_t bands[BANDS_COUNT];
+  if (takeBandsIfDue(bands)) {
+    JsonArray arr = doc["bands"].to<JsonArray>();
+    for (int b = 0; b < BANDS_COUNT; b++) arr.add(bands[b]);
   }
-  double meanSquare = sumSquares / numFrames;
 
-  // Smooth in the ENERGY domain (short Leq) so the reported level reflects
-  // sustained loudness rather than individual loud/quiet samples within music.
-  static double avgMeanSquare = 0;
-  if (avgMeanSquare <= 0) avgMeanSquare = meanSquare;  // seed on first reading
-  avgMeanSquare = AUDIO_ENERGY_ALPHA * meanSquare + (1.0 - AUDIO_ENERGY_ALPHA) * avgMeanSquare;
+  // {"10": [L10, L50, L90], "60": [...], ...}: window seconds -> dBFS
+  takePercentiles();
+  if (reportedPctCount > 0) {
+    JsonObject pct = doc["percentiles"].to<JsonObject>();
+    for (size_t i = 0; i < reportedPctCount; i++) {
+      char window[8];
+      snprintf(window, sizeof(window), "%u", (unsigned)reportedPct[i].windowS);
+      JsonArray w = pct[window].to<JsonArray>();
+      w.add(reportedPct[i].l10 / 10.0);
+      w.add(reportedPct[i].l50 / 10.0);
+      w.add(reportedPct[i].l90 / 10.0);
+    }
+  }
 
-  double rms = sqrt(avgMeanSquare);
-  if (rms < 1.0) rms = 1.0;
-  currentDbFS = 20.0f * log10f((float)(rms / 32767.0));
+  wsSendJson(doc);
+}
 
-  static uint8_t dbgCount = 0;
-  if (++dbgCount % 20 == 0) {  // ~every 2s, light field-diagnostic logging
-    Serial.printf("[audio] %.1f dBFS\n", currentDbFS);
+// --- On-device volume control: run the mapper on the reading just reported ---
+void runVolumeControl(unsigned long now) {
+  MapperIntent intents[MAPPER_MAX_ZONES];
+  MapperLevels levels = {};
+  levels.db10 = (int16_t)roundf(currentDbFS * 10.0f);  // as telemetry reports it
+  for (size_t i = 0; i < reportedPctCount; i++) {
+    if (reportedPct[i].windowS != MAPPER_PERCENTILE_WINDOW_S) continue;
+    levels.havePercentiles = true;
+    levels.l10 = reportedPct[i].l10;
+    levels.l50 = reportedPct[i].l50;
+    levels.l90 = reportedPct[i].l90;
+  }
+  size_t n = mapperProcess(levels, now, intents, MAPPER_MAX_ZONES);
+  for (size_t i = 0; i < n; i++) {
+    JsonDocument doc(&txArena);
+    doc["type"] = "volume_intent";
+    doc["deviceId"] = deviceId;
+    doc["zoneId"] = mapperZoneId(intents[i].zone);
+    doc["volume"] = intents[i].volume;
+    doc["seq"] = intents[i].seq;
+    wsSendJson(doc);
+    LOGI(LOG_MAPPER, "%s -> volume %u", mapperZoneId(intents[i].zone), intents[i].volume);
   }
 }
 
-// --- Send sound level via WebSocket ---
-void sendSoundLevel() {
-  JsonDocument doc;
-  doc["type"] = "sound_level";
+// --- Send the batched readings as one binary telemetry frame (see telemetry.h) ---
+void sendTelemetryFrame() {
+  uint8_t frame[MSG_FRAME_HEADER_ROOM + TELEMETRY_FRAME_MAX];
+  int8_t bands[BANDS_COUNT];
+  bool haveBands = takeBandsIfDue(bands);
+  takePercentiles();
+  size_t len = telemetryEncode(frame + MSG_FRAME_HEADER_ROOM, TELEMETRY_FRAME_MAX, audioGetWeighting(), haveBands ? bands : nullptr,
+                               audioGetOverruns(), reportedPct, reportedPctCount);
+  if (len > 0) wsSendBinary(frame, len);
+  firstLevelSent = true;
+}
+
+// --- Replay the oldest backlog readings as one binary frame (see backlog.h) ---
+void sendBacklogFrame() {
+  uint8_t frame[MSG_FRAME_HEADER_ROOM + TELEMETRY_FRAME_MAX];
+  size_t len = backlogEncode(frame + MSG_FRAME_HEADER_ROOM, TELEMETRY_FRAME_MAX, audioGetWeighting());
+  if (len > 0) wsSendBinary(frame, len);
+  if (backlogCount() == 0) LOGI(LOG_BACKLOG, "replayed (%u dropped)", (unsigned)backlogDropped());
+}
+
+// --- Runtime metrics (metrics.h), with the gauges sampled now ---
+void sendStats() {
+  metricsSet(METRIC_HEAP_FREE, heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+  metricsSet(METRIC_HEAP_MIN_FREE, heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+  metricsSet(METRIC_HEAP_LARGEST, heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+  metricsSet(METRIC_PSRAM_FREE, heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+  metricsSet(METRIC_PSRAM_LARGEST, heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
+  metricsSet(METRIC_WIFI_RSSI, WiFi.RSSI());
+  metricsSet(METRIC_I2S_OVERRUNS, audioGetOverruns());
+  FrameBusStats bands = audioGetBandsBusStats();
+  metricsSet(METRIC_BANDS_MISSED, bands.overruns);
+  metricsSet(METRIC_BANDS_LAG_MAX, bands.maxLag);
+  metricsSet(METRIC_TELEMETRY_PENDING, telemetryPending());
+  metricsSet(METRIC_BACKLOG_QUEUED, backlogCount());
+  metricsSet(METRIC_TX_ARENA_PEAK, txArena.peak());
+  metricsSet(METRIC_RX_ARENA_PEAK, rxArena.peak());
+  metricsSet(METRIC_ARENA_FAILURES, txArena.failures() + rxArena.failures());
+
+  JsonDocument doc(&txArena);
+  doc["type"] = "stats";
   doc["deviceId"] = deviceId;
-  doc["dbFS"] = round(currentDbFS * 10.0) / 10.0;
+  doc["uptimeS"] = millis() / 1000;
+  metricsWrite(doc.as<JsonObject>());
+  wsSendJson(doc);
+}
 
-  String json;
-  serializeJson(doc, json);
-  ws.sendTXT(json);
+// --- Recent log records (logring.h), formatted on request ---
+void sendLogs(size_t count) {
+  JsonDocument doc(&txArena);
+  doc["type"] = "logs";
+  doc["deviceId"] = deviceId;
+  doc["uptimeMs"] = millis();
+  logWriteRecent(doc["records"].to<JsonArray>(), count);
+  wsSendJson(doc);
 }
@@ -0,0 +1,197 @@
+#include <Arduino.h>
+#include <math.h>
+
+#include "config.h"
+#include "mapper.h"
+#include "logring.h"
+
+// Same constants as volume-mapper.ts.
+#define MAPPER_RATE_LIMIT_MS      2000   // max one setVolume per zone per 2 s
+#define MAPPER_MAX_STEP           2      // volume steps per change
+#define MAPPER_RUNAWAY_SETTLE_MS  6000   // no further increase this soon after one
+#define MAPPER_OFFLINE_BACKOFF_MS 30000  // player offline: wait before retrying
+
+// Control state per zone. The server's timestamps start at 0 (= the epoch, so
+// "long ago"); millis() starts near 0 too, hence explicit "ever happened" flags.
+// The loop runs twice a second, so double costs nothing here and keeps the
+// arithmetic identical to the JavaScript numbers it mirrors.
+struct ZoneState {
+  bool started;  // first reading above the noise gate seen
+  double smoothedDb;
+  int currentVolume;
+  bool called;
+  uint32_t lastCallMs;
+  bool increased;
+  uint32_t lastIncreaseMs;
+  bool offline;
+  uint32_t offlineUntilMs;
+  int sustainCount;
+  int pendingVolume;     // -1: none
+  int pendingDirection;  // 1 up, -1 down, 0 none
+
+  // Intent awaiting its volume_ack (seq 0: none).
+  uint32_t inflightSeq;
+  uint32_t inflightMs;
+  int inflightVolume;
+  bool prevCalled;  // rate-limit slot to give back if it fails
+  uint32_t prevCallMs;
+};
+
+static MapperZoneConfig s_cfg[MAPPER_MAX_ZONES];
+static ZoneState s_state[MAPPER_MAX_ZONES];
+static size_t s_count = 0;
+static uint32_t s_seq = 0;
+
+void mapperSetZones(const MapperZoneConfig *zones, size_t count) {
+  if (count > MAPPER_MAX_ZONES) count = MAPPER_MAX_ZONES;
+  ZoneState next[MAPPER_MAX_ZONES] = {};
+  for (size_t i = 0; i < count; i++) {
+    for (size_t j = 0; j < s_count; j++) {
+      if (strcmp(s_cfg[j].zoneId, zones[i].zoneId) == 0) next[i] = s_state[j];
+    }
+  }
+  memcpy(s_cfg, zones, count * sizeof(MapperZoneConfig));
+  memcpy(s_state, next, sizeof(next));
+  s_count = count;
+}
+
+MapperMetric mapperMetricFromName(const char *name) {
+  if (!name) return MAPPER_METRIC_LEVEL;
+  if (strcmp(name, "l10") == 0) return MAPPER_METRIC_L10;
+  if (strcmp(name, "l50") == 0) return MAPPER_METRIC_L50;
+  if (strcmp(name, "l90") == 0) return MAPPER_METRIC_L90;
+  return MAPPER_METRIC_LEVEL;
+}
+
+// mapperInput() in volume-mapper.ts.
+static int16_t metricDb10(MapperMetric metric, const MapperLevels &in) {
+  if (!in.havePercentiles) return in.db10;
+  switch (metric) {
+    case MAPPER_METRIC_L10: return in.l10;
+    case MAPPER_METRIC_L50: return in.l50;
+    case MAPPER_METRIC_L90: return in.l90;
+    default: return in.db10;
+  }
+}
+
+size_t mapperZoneCount() { return s_count; }
+
+const char *mapperZoneId(uint8_t zone) { return zone < s_count ? s_cfg[zone].zoneId : ""; }
+
+static int mapDbToVolume(double db, const MapperZoneConfig &c) {
+  if (db <= c.quietThresholdDb) return c.minVolume;
+  if (db >= c.loudThresholdDb) return c.maxVolume;
+  double ratio = (db - c.quietThresholdDb) / (c.loudThresholdDb - c.quietThresholdDb);
+  return (int)floor(c.minVolume + ratio * (c.maxVolume - c.minVolume) + 0.5);  // Math.round
+}
+
+static void finishIntent(ZoneState &s, bool ok, bool playerOffline) {
+  if (ok) {
+    if (s.inflightVolume > s.currentVolume) {
+      s.increased = true;
+      s.lastIncreaseMs = s.inflightMs;
+    }
+    s.currentVolume = s.inflightVolume;
+    s.offline = false;
+  } else {
+    s.called = s.prevCalled;
+    s.lastCallMs = s.prevCallMs;
+    if (playerOffline) {
+      s.offline = true;
+      s.offlineUntilMs = s.inflightMs + MAPPER_OFFLINE_BACKOFF_MS;
+    }
+  }
+  s.inflightSeq = 0;
+}
+
+void mapperAck(uint32_t seq, bool ok, bool playerOffline) {
+  for (size_t i = 0; i < s_count; i++) {
+    if (seq != 0 && s_state[i].inflightSeq == seq) {
+      finishIntent(s_state[i], ok, playerOffline);
+      if (!ok) LOGW(LOG_MAPPER, "%s: intent %u failed%s", s_cfg[i].zoneId, (unsigned)seq,
+                             playerOffline ? " (player offline)" : "");
+    }
+  }
+}
+
+// One zone's step of VolumeMapper.processReading(). Returns the volume to
+// request, or -1.
+static int step(const MapperZoneConfig &c, ZoneState &s, double db, uint32_t now) {
+  if (!c.active) return -1;
+  if (db < c.quietThresholdDb - 3) return -1;  // noise floor gate
+
+  if (!s.started) {
+    s = ZoneState{};
+    s.started = true;
+    s.smoothedDb = db;
+    s.currentVolume = (int)floor((c.minVolume + c.maxVolume) / 2.0 + 0.5);
+    s.pendingVolume = -1;
+  }
+
+  // 1. Asymmetric EMA: faster attack, slower release.
+  double sf = c.smoothingFactor;
+  double alpha = db > s.smoothedDb ? fmin(sf * 1.5, 0.9) : sf * 0.5;
+  s.smoothedDb = alpha * db + (1 - alpha) * s.smoothedDb;
+
+  // 2. Map to volume.
+  int mapped = mapDbToVolume(s.smoothedDb, c);
+
+  // 3. Direction hysteresis.
+  if (abs(mapped - s.currentVolume) >= 1) {
+    int direction = mapped > s.currentVolume ? 1 : -1;
+    if (s.pendingDirection == direction) {
+      s.sustainCount++;
+    } else {
+      s.pendingDirection = direction;
+      s.sustainCount = 1;
+    }
+    s.pendingVolume = mapped;
+  } else {
+    s.pendingVolume = -1;
+    s.pendingDirection = 0;
+    s.sustainCount = 0;
+  }
+
+  if (s.sustainCount < c.sustainCount || s.pendingVolume < 0) return -1;
+  if (s.offline && (int32_t)(now - s.offlineUntilMs) < 0) return -1;
+  if (s.pendingVolume > s.currentVolume && s.increased && now - s.lastIncreaseMs < MAPPER_RUNAWAY_SETTLE_MS) {
+    return -1;  // runaway-gain guard; keep the pending target
+  }
+
+  int diff = s.pendingVolume - s.currentVolume;
+  if (abs(diff) > MAPPER_MAX_STEP) s.pendingVolume = s.currentVolume + (diff > 0 ? MAPPER_MAX_STEP : -MAPPER_MAX_STEP);
+
+  if (s.inflightSeq != 0 || (s.called && now - s.lastCallMs < MAPPER_RATE_LIMIT_MS)) return -1;
+
+  // Claim the rate-limit slot now; mapperAck() gives it back on failure.
+  int volume = s.pendingVolume;
+  s.prevCalled = s.called;
+  s.prevCallMs = s.lastCallMs;
+  s.called = true;
+  s.lastCallMs = now;
+  s.inflightMs = now;
+  s.inflightVolume = volume;
+  s.pendingVolume = -1;
+  s.pendingDirection = 0;
+  s.sustainCount = 0;
+  return volume;
+}
+
+size_t mapperProcess(const MapperLevels &levels, uint32_t nowMs, MapperIntent *out, size_t max) {
+  size_t n = 0;
+  for (size_t i = 0; i < s_count; i++) {
+    ZoneState &s = s_state[i];
+    if (s.inflightSeq != 0 && nowMs - s.inflightMs >= MAPPER_ACK_TIMEOUT_MS) {
+      LOGW(LOG_MAPPER, "%s: intent %u unanswered", s_cfg[i].zoneId, (unsigned)s.inflightSeq);
+      finishIntent(s, false, false);
+    }
+    if (n == max) continue;
+    double db = metricDb10(s_cfg[i].metric, levels) / 10.0;  // the same double the server parses from "-45.3"
+    int volume = step(s_cfg[i], s, db, nowMs);
+    if (volume < 0) continue;
+    if (++s_seq == 0) s_seq = 1;
+    s.inflightSeq = s_seq;
+    out[n++] = MapperIntent{(uint8_t)i, (uint8_t)volume, s_seq};
+  }
+  return n;
+}
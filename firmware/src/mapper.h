@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Arduino.h>
+
+// On-device volume control loop: a port of server/src/services/volume-mapper.ts
+// (asymmetric EMA, dB -> volume map, direction hysteresis with a sustain count,
+// 2-step clamp, runaway-gain settle window, per-zone rate limit and player-offline
+// backoff). Fed the zone configs from the server's "registered"/"zone_configs"
+// messages and one level reading per DB_SEND_INTERVAL; emits "set zone X to Y"
+// intents that the server forwards to Soundtrack and acknowledges.
+//
+// Decisions must stay identical to the TypeScript mapper for the same readings:
+// keep the two in step (check with server/scripts/mapper-trace.ts).
+
+#define MAPPER_MAX_ZONES   8
+#define MAPPER_ZONE_ID_MAX 64
+
+// What a zone's loop follows (ZoneConfig.levelMetric): the level itself, or one
+// of its percentiles over the MAPPER_PERCENTILE_WINDOW_S window (levelstats.h),
+// e.g. L90 to track the ambient floor and ignore the venue's own music peaks.
+enum MapperMetric : uint8_t { MAPPER_METRIC_LEVEL, MAPPER_METRIC_L10, MAPPER_METRIC_L50, MAPPER_METRIC_L90 };
+
+// Parse "level" / "l10" / "l50" / "l90"; anything else is the level.
+MapperMetric mapperMetricFromName(const char *name);
+
+// One zone's tuning, as stored in the server's ZoneConfig.
+struct MapperZoneConfig {
+  char zoneId[MAPPER_ZONE_ID_MAX];
+  bool active;  // enabled, not paused, device not paused
+  uint8_t minVolume, maxVolume;
+  double quietThresholdDb, loudThresholdDb;  // double, like the server's numbers
+  double smoothingFactor;
+  uint8_t sustainCount;
+  MapperMetric metric;
+};
+
+// One reading's inputs, in tenths of a dB exactly as reported to the server (so
+// both mappers see the same numbers). The percentiles are the ones last
+// reported for the MAPPER_PERCENTILE_WINDOW_S window; without them every zone
+// follows the level.
+struct MapperLevels {
+  int16_t db10;
+  bool havePercentiles;
+  int16_t l10, l50, l90;
+};
+
+struct MapperIntent {
+  uint8_t zone;  // index into the configured zones (mapperZoneId)
+  uint8_t volume;
+  uint32_t seq;  // echoed back in the server's volume_ack
+};
+
+// Replace the zone list. Zones whose id is already known keep their control
+// state (smoothed level, current volume, timers), as on the server.
+void mapperSetZones(const MapperZoneConfig *zones, size_t count);
+
+size_t mapperZoneCount();
+const char *mapperZoneId(uint8_t zone);
+
+// Feed one reading taken at nowMs. Writes at most one intent per zone into out
+// and returns how many.
+size_t mapperProcess(const MapperLevels &levels, uint32_t nowMs, MapperIntent *out, size_t max);
+
+// Outcome of intent seq: applied (ok), or refused/failed — playerOffline when
+// Soundtrack reported the zone's player offline. Unanswered intents count as
+// failed after MAPPER_ACK_TIMEOUT_MS.
+void mapperAck(uint32_t seq, bool ok, bool playerOffline);
@@ -0,0 +1,69 @@
+#include <Arduino.h>
+#include <atomic>
+
+#include "metrics.h"
+
+const uint32_t METRIC_BUCKET_US[METRIC_BUCKETS - 1] = {
+  50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000,
+};
+
+// Names as sent to the server, in enum order.
+static const char *const COUNTER_NAMES[METRIC_COUNTERS] = {
+  "wifi_lost", "wifi_retries", "portal_opens", "ws_connects", "ws_disconnects", "ws_send_failed",
+  "ws_sent_bytes", "readings_sent", "readings_skipped",
+};
+static const char *const GAUGE_NAMES[METRIC_GAUGES] = {
+  "heap_free", "heap_min_free", "heap_largest", "psram_free", "psram_largest", "wifi_rssi",
+  "i2s_overruns", "bands_missed", "bands_lag_max", "telemetry_pending", "backlog_queued",
+  "tx_arena_peak", "rx_arena_peak", "arena_failures",
+};
+static const char *const HISTOGRAM_NAMES[METRIC_HISTOGRAMS] = {"loop_us", "ws_loop_us", "dsp_us"};
+
+struct Histogram {
+  std::atomic<uint32_t> counts[METRIC_BUCKETS];
+  std::atomic<uint32_t> max;
+};
+
+static std::atomic<uint32_t> s_counters[METRIC_COUNTERS];
+static std::atomic<int32_t> s_gauges[METRIC_GAUGES];
+static Histogram s_hist[METRIC_HISTOGRAMS];
+
+void metricsCount(MetricCounter c, uint32_t n) { s_counters[c].fetch_add(n, std::memory_order_relaxed); }
+
+void metricsSet(MetricGauge g, int32_t value) { s_gauges[g].store(value, std::memory_order_relaxed); }
+
+void metricsObserve(MetricHistogram h, uint32_t us) {
+  int b = 0;
+  while (b < METRIC_BUCKETS - 1 && us > METRIC_BUCKET_US[b]) b++;
+  Histogram &hist = s_hist[h];
+  hist.counts[b].fetch_add(1, std::memory_order_relaxed);
+  uint32_t max = hist.max.load(std::memory_order_relaxed);
+  while (us > max && !hist.max.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+  }
+}
+
+void metricsWrite(JsonObject out) {
+  JsonObject counters = out["counters"].to<JsonObject>();
+  for (int c = 0; c < METRIC_COUNTERS; c++) counters[COUNTER_NAMES[c]] = s_counters[c].load(std::memory_order_relaxed);
+
+  JsonObject gauges = out["gauges"].to<JsonObject>();
+  for (int g = 0; g < METRIC_GAUGES; g++) gauges[GAUGE_NAMES[g]] = s_gauges[g].load(std::memory_order_relaxed);
+
+  JsonArray bounds = out["bucketsUs"].to<JsonArray>();
+  for (int b = 0; b < METRIC_BUCKETS - 1; b++) bounds.add(METRIC_BUCKET_US[b]);
+
+  JsonObject hists = out["histograms"].to<JsonObject>();
+  for (int h = 0; h < METRIC_HISTOGRAMS; h++) {
+    Histogram &hist = s_hist[h];
+    uint32_t counts[METRIC_BUCKETS];
+    int used = 0;
+    for (int b = 0; b < METRIC_BUCKETS; b++) {
+      counts[b] = hist.counts[b].load(std::memory_order_relaxed);
+      if (counts[b]) used = b + 1;
+    }
+    JsonObject o = hists[HISTOGRAM_NAMES[h]].to<JsonObject>();
+    JsonArray arr = o["counts"].to<JsonArray>();
+    for (int b = 0; b < used; b++) arr.add(counts[b]);
+    o["max"] = hist.max.exchange(0, std::memory_order_relaxed);
+  }
+}
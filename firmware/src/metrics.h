@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Runtime metrics for the field: counters, gauges and fixed-bucket latency
+// histograms in a static registry. Updates are single relaxed atomic ops, so
+// hot paths (loop(), ws.loop(), the capture task's DSP) record from any task
+// without a lock. Every STATS_INTERVAL_MS loop() sends them all as a "stats"
+// message, which the server keeps per device (Device.lastStats).
+//
+// Counters and histogram buckets count since boot (the server diffs
+// consecutive reports); histogram maxima cover the time since the last report.
+
+enum MetricCounter : uint8_t {
+  METRIC_WIFI_LOST,        // association dropped
+  METRIC_WIFI_RETRIES,     // STA reconnect attempts
+  METRIC_PORTAL_OPENS,     // setup portal re-opened after sustained failure
+  METRIC_WS_CONNECTS,
+  METRIC_WS_DISCONNECTS,
+  METRIC_WS_SEND_FAILED,   // sendTXT / sendBIN refused
+  METRIC_WS_SENT_BYTES,
+  METRIC_READINGS_SENT,    // live readings sent (report.h)
+  METRIC_READINGS_SKIPPED, // live readings the send-on-delta gate held back
+  METRIC_COUNTERS
+};
+
+enum MetricGauge : uint8_t {
+  METRIC_HEAP_FREE,        // internal RAM, bytes
+  METRIC_HEAP_MIN_FREE,    // internal RAM low-water mark since boot
+  METRIC_HEAP_LARGEST,     // largest free internal block (fragmentation)
+  METRIC_PSRAM_FREE,
+  METRIC_PSRAM_LARGEST,
+  METRIC_WIFI_RSSI,        // dBm
+  METRIC_I2S_OVERRUNS,     // since boot (audio.h)
+  METRIC_BANDS_MISSED,     // frame-bus blocks the band analyzer missed, since boot
+  METRIC_BANDS_LAG_MAX,    // its worst frame-bus lag, blocks
+  METRIC_TELEMETRY_PENDING,  // readings batched for the next bin1 frame
+  METRIC_BACKLOG_QUEUED,   // readings waiting in the outage backlog (backlog.h)
+  METRIC_TX_ARENA_PEAK,    // most bytes a sent / received document used (msgarena.h)
+  METRIC_RX_ARENA_PEAK,
+  METRIC_ARENA_FAILURES,   // message-arena allocations refused since boot
+  METRIC_GAUGES
+};
+
+enum MetricHistogram : uint8_t {
+  METRIC_LOOP_US,          // loop() start to start
+  METRIC_WS_LOOP_US,       // one ws.loop() call
+  METRIC_DSP_US,           // capture task weighting + energy per DMA block
+  METRIC_HISTOGRAMS
+};
+
+// Upper bucket bounds in microseconds (1-2-5 steps); one more bucket catches
+// everything slower.
+#define METRIC_BUCKETS 15
+extern const uint32_t METRIC_BUCKET_US[METRIC_BUCKETS - 1];
+
+void metricsCount(MetricCounter c, uint32_t n = 1);
+void metricsSet(MetricGauge g, int32_t value);
+void metricsObserve(MetricHistogram h, uint32_t us);
+
+// Everything as JSON: {"counters":{..},"gauges":{..},"bucketsUs":[..],
+// "histograms":{"loop_us":{"counts":[..],"max":N},..}}. Counts are trimmed
+// after the last non-empty bucket. Resets the histogram maxima.
+void metricsWrite(JsonObject out);
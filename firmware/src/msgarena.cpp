@@ -0,0 +1,96 @@
+#include <Arduino.h>
+#include <cstddef>
+#include <esp_heap_caps.h>
+
+#include "config.h"
+#include "msgarena.h"
+
+static const size_t ALIGN = alignof(std::max_align_t);
+
+// In front of every block: its size and the block that was newest before it,
+// so frees in reverse order can walk the top back down.
+struct alignas(std::max_align_t) MsgArena::Header {
+  size_t size;
+  size_t prev;
+};
+
+static size_t roundUp(size_t n) { return (n + ALIGN - 1) & ~(ALIGN - 1); }
+
+static void *capsAlloc(size_t bytes) {
+  void *p = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  return p ? p : heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+}
+
+bool MsgArena::begin(size_t bytes) {
+  _base = (uint8_t *)capsAlloc(bytes);
+  _cap = _base ? bytes : 0;
+  return _base != nullptr;
+}
+
+MsgArena::Header *MsgArena::header(void *ptr) const { return (Header *)ptr - 1; }
+
+void *MsgArena::allocate(size_t size) {
+  size_t need = sizeof(Header) + roundUp(size);
+  if (!_base || need > _cap - _top) {
+    _failures++;
+    return nullptr;
+  }
+  Header *h = (Header *)(_base + _top);
+  h->size = size;
+  h->prev = _last;
+  _last = _top;
+  _top += need;
+  _live++;
+  if (_top > _peak) _peak = _top;
+  return h + 1;
+}
+
+void MsgArena::deallocate(void *ptr) {
+  if (!ptr) return;
+  Header *h = header(ptr);
+  if ((uint8_t *)h - _base == (ptrdiff_t)_last) {
+    _top = _last;
+    _last = h->prev;
+  }
+  if (--_live == 0) {
+    _top = 0;
+    _last = SIZE_MAX;
+  }
+}
+
+void *MsgArena::reallocate(void *ptr, size_t newSize) {
+  if (!ptr) return allocate(newSize);
+  Header *h = header(ptr);
+  size_t offset = (uint8_t *)h - _base;
+  if (offset == _last) {  // the newest block grows or shrinks in place
+    size_t need = sizeof(Header) + roundUp(newSize);
+    if (need > _cap - offset) {
+      _failures++;
+      return nullptr;
+    }
+    h->size = newSize;
+    _top = offset + need;
+    if (_top > _peak) _peak = _top;
+    return ptr;
+  }
+  if (newSize <= h->size) {
+    h->size = newSize;
+    return ptr;
+  }
+  void *moved = allocate(newSize);
+  if (!moved) return nullptr;
+  memcpy(moved, ptr, h->size);
+  deallocate(ptr);
+  return moved;
+}
+
+static char *s_txBuffer = nullptr;
+
+bool msgTxBufferInit() {
+  s_txBuffer = (char *)capsAlloc(MSG_TX_BUFFER_BYTES);
+  return s_txBuffer != nullptr;
+}
+
+char *msgTxBuffer() { return s_txBuffer; }
+
+size_t msgTxBufferCap() { return s_txBuffer ? MSG_TX_BUFFER_BYTES - MSG_FRAME_HEADER_ROOM : 0; }
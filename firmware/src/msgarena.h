@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Fixed memory for websocket messages, so steady-state messaging does no heap
+// allocation: the internal heap stays unfragmented for the large contiguous
+// blocks TLS needs (OTA).
+//
+// MsgArena is an ArduinoJson allocator over one block carved out at boot
+// (PSRAM when there is some). Allocation bumps a pointer. Frees in reverse
+// order give the space back at once, and the whole block is reclaimed whenever
+// nothing in it is live, i.e. when the document using it is destroyed. One
+// document at a time per arena:
+//
+//   JsonDocument doc(&txArena);
+//
+// A document that outgrows the block fails like any ArduinoJson allocation
+// (doc.overflowed()); the arena counts it.
+class MsgArena : public ArduinoJson::Allocator {
+public:
+  // Reserve `bytes`, once, in setup(). Returns false if there is no memory (every
+  // allocation then fails).
+  bool begin(size_t bytes);
+
+  void *allocate(size_t size) override;
+  void deallocate(void *ptr) override;
+  void *reallocate(void *ptr, size_t newSize) override;
+
+  size_t capacity() const { return _cap; }
+  size_t peak() const { return _peak; }          // most bytes in use at once, since boot
+  uint32_t failures() const { return _failures; }  // allocations refused (block full)
+
+private:
+  struct Header;
+  Header *header(void *ptr) const;
+
+  uint8_t *_base = nullptr;
+  size_t _cap = 0;
+  size_t _top = 0;         // first free byte
+  size_t _last = SIZE_MAX;  // offset of the newest block still live, or none
+  size_t _live = 0;        // blocks allocated and not freed
+  size_t _peak = 0;
+  uint32_t _failures = 0;
+};
+
+// Serialization buffer for outgoing text frames. The first
+// MSG_FRAME_HEADER_ROOM bytes stay free: the websocket client (wsclient.h) writes
+// the frame header there and masks the payload in place.
+bool msgTxBufferInit();
+char *msgTxBuffer();        // MSG_TX_BUFFER_BYTES, header room included
+size_t msgTxBufferCap();    // bytes available after the header room
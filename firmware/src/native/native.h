@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+// Hooks between the host shims (shims.cpp) and the replay driver (replay.cpp).
+
+// Advance the virtual clock behind millis()/micros().
+void nativeAdvanceMicros(uint64_t us);
+
+// Queue mono samples on the I2S RX channel, fire its on-receive "ISR", and wait
+// until the capture task has drained them (lockstep: no overruns, deterministic).
+void nativeI2sFeed(const int16_t *samples, size_t count);
+
+// Where the websocket stand-in writes what the firmware sends: one line per
+// message, "<ms>\t<json>" for text and "<ms>\tbin <hex>" for binary frames.
+void nativeSetOutput(FILE *out);
+
+// Whether the stand-in server accepts binary telemetry in "registered".
+void nativeSetBinaryTelemetry(bool accept);
+
+// JSON array of zone configs (server ZoneConfig objects) to hand the firmware
+// in "registered", turning on on-device volume control; every volume_intent is
+// then acknowledged as applied. Null or empty: server-side control.
+void nativeSetZoneConfigs(const char *json);
+
+// JSON object of send-on-delta parameters (as the server's "reporting") to
+// hand the firmware in "registered". Null or empty: the firmware's defaults.
+void nativeSetReporting(const char *json);
+
+// Take the websocket link down (the firmware sees a disconnect) or back up.
+void nativeSetLinkDown(bool down);
+
+// Messages written so far.
+uint32_t nativeMessagesSent();
+
+// Allocations on the calling thread while a NativeHarnessScope lives are the
+// harness's own (the websocket stand-in's bookkeeping), not the firmware's:
+// replay --soak leaves them out of its counts.
+struct NativeHarnessScope {
+  NativeHarnessScope();
+  ~NativeHarnessScope();
+};
+bool nativeInHarness();
@@ -0,0 +1,336 @@
+// Host replay harness: runs the real firmware (setup()/loop(), capture task,
+// weighting, bands, telemetry, display) against recorded WAV files on a virtual
+// clock, as fast as the host allows, and writes what it sends to the server.
+//
+//   .pio/build/native/program [--out FILE] [--binary] [--weighting Z|A|C|K]
+//                             [--account ID] [--realtime] [--max-error DB]
+//                             [--zones FILE] [--outage START:SECONDS]
+//                             [--soak MINUTES] [--reporting JSON] file.wav [...]
+//
+// --outage drops the websocket link for SECONDS of audio from START (seconds
+// into the replay), to exercise the store-and-forward backlog.
+//
+// --zones hands the firmware a JSON array of zone configs (as the server's
+// ZoneConfig rows) in "registered", so it runs the volume control loop itself;
+// its volume_intent messages land in the output next to the readings, ready for
+// server/scripts/mapper-trace.ts to replay through the server's mapper.
+//
+// --reporting hands the firmware send-on-delta parameters in "registered" (as
+// the server's "reporting" object, e.g. '{"deadbandDb":0}' to send every
+// reading); without it the firmware's defaults apply (report.h).
+//
+// Alongside the firmware, a reference meter runs the original double-precision
+// level path (per-sample double sum, double EMA, sqrt, log10) on the same
+// samples; the summary reports the largest difference from the firmware's
+// level. --max-error makes the run fail (exit 1) when that exceeds DB.
+//
+// --soak replays the files over and over until MINUTES of audio have passed
+// and counts the heap allocations the firmware makes (the websocket stand-in's
+// own are left out, see native.h). After a warm-up of two stats intervals the
+// steady state must allocate nothing: the run fails (exit 1) on any allocation.
+// The summary shows the per-minute counts and, as a fragmentation check, the
+// host heap's in-use and free-but-held bytes (glibc). Allocations are counted
+// through malloc on glibc, through operator new elsewhere.
+//
+// WAVs must be 16-bit PCM at SAMPLE_RATE; the left channel is used, as on the
+// device. Convert with e.g.  sox in.wav -b 16 -r 16000 -c 1 out.wav
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include <Arduino.h>
+#include <Arduino_GFX_Library.h>
+#include <Preferences.h>
+
+#include "../config.h"
+#include "../audio.h"
+#include "../weighting.h"
+#include "native.h"
+
+void setup();
+void loop();
+extern Arduino_DataBus *qspi_bus;
+
+static uint32_t le32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+
+// Left-channel samples of a 16-bit PCM WAV at SAMPLE_RATE, or false with a message.
+static bool loadWav(const char *path, std::vector<int16_t> &out) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "replay: cannot open %s\n", path);
+    return false;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+
+  if (data.size() < 12 || memcmp(data.data(), "RIFF", 4) != 0 || memcmp(data.data() + 8, "WAVE", 4) != 0) {
+    fprintf(stderr, "replay: %s is not a WAV file\n", path);
+    return false;
+  }
+  uint16_t channels = 0, bits = 0, format = 0;
+  uint32_t rate = 0;
+  for (size_t pos = 12; pos + 8 <= data.size();) {
+    const uint8_t *chunk = data.data() + pos;
+    uint32_t len = le32(chunk + 4);
+    if (pos + 8 + len > data.size()) len = data.size() - pos - 8;  // tolerate truncated data chunk
+    if (memcmp(chunk, "fmt ", 4) == 0 && len >= 16) {
+      format = le16(chunk + 8);
+      channels = le16(chunk + 10);
+      rate = le32(chunk + 12);
+      bits = le16(chunk + 22);
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      if (format != 1 || bits != 16 || rate != SAMPLE_RATE || channels == 0) {
+        fprintf(stderr, "replay: %s must be 16-bit PCM at %d Hz (got format %u, %u-bit, %u Hz)\n",
+                path, SAMPLE_RATE, format, bits, rate);
+        return false;
+      }
+      size_t frames = len / (2 * channels);
+      out.resize(frames);
+      for (size_t i = 0; i < frames; i++) out[i] = (int16_t)le16(chunk + 8 + i * 2 * channels);
+      return true;
+    }
+    pos += 8 + len + (len & 1);
+  }
+  fprintf(stderr, "replay: %s has no data chunk\n", path);
+  return false;
+}
+
+// The level meter as it was before the single-precision/integer kernels:
+// the accuracy reference for audio.cpp.
+struct ReferenceMeter {
+  BiquadCascade filter;
+  double sumSquares = 0;
+  uint32_t windowFrames = 0;
+  double avgMeanSquare = 0;
+  float dbFS = -90.0f;
+  uint32_t windows = 0;
+
+  void feed(const int16_t *x, size_t n) {
+    const uint32_t windowSize = (uint32_t)SAMPLE_RATE * DB_CALC_INTERVAL / 1000;
+    for (size_t i = 0; i < n; i++) {
+      float y = filter.process((float)x[i]);
+      sumSquares += (double)(y * y);
+      if (++windowFrames >= windowSize) {
+        double meanSquare = sumSquares / windowFrames;
+        if (avgMeanSquare <= 0) avgMeanSquare = meanSquare;
+        avgMeanSquare = AUDIO_ENERGY_ALPHA * meanSquare + (1.0 - AUDIO_ENERGY_ALPHA) * avgMeanSquare;
+        double rms = sqrt(avgMeanSquare);
+        if (rms < 1.0) rms = 1.0;
+        dbFS = (float)(20.0 * log10(rms / 32767.0));
+        sumSquares = 0;
+        windowFrames = 0;
+        windows++;
+      }
+    }
+  }
+};
+
+// --- Allocation counting for --soak ---
+
+static std::atomic<bool> s_countAllocs{false};
+static std::atomic<uint64_t> s_allocs{0};
+static std::atomic<uint64_t> s_allocBytes{0};
+
+static void countAlloc(size_t n) {
+  if (!s_countAllocs.load(std::memory_order_relaxed) || nativeInHarness()) return;
+  s_allocs.fetch_add(1, std::memory_order_relaxed);
+  s_allocBytes.fetch_add(n, std::memory_order_relaxed);
+}
+
+#if defined(__GLIBC__)
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+extern "C" void *malloc(size_t n) {
+  countAlloc(n);
+  return __libc_malloc(n);
+}
+extern "C" void *calloc(size_t count, size_t n) {
+  countAlloc(count * n);
+  return __libc_calloc(count, n);
+}
+extern "C" void *realloc(void *p, size_t n) {
+  countAlloc(n);
+  return __libc_realloc(p, n);
+}
+#else
+void *operator new(size_t n) {
+  countAlloc(n);
+  if (void *p = malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t n) { return operator new(n); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+#endif
+
+struct HeapFigures {
+  size_t inUse = 0;  // bytes handed out
+  size_t held = 0;   // free bytes the allocator keeps (not returned to the OS)
+};
+
+static HeapFigures heapFigures() {
+  HeapFigures h;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 mi = mallinfo2();
+  h.inUse = mi.uordblks + mi.hblkhd;
+  h.held = mi.fordblks;
+#endif
+  return h;
+}
+
+int main(int argc, char **argv) {
+  std::vector<const char *> files;
+  const char *outPath = nullptr;
+  bool realtime = false;
+  double maxError = -1;
+  double outageStart = -1, outageLen = 0;
+  double soakMinutes = 0;
+  Preferences prefs;
+  prefs.begin("autovolume", false);
+
+  for (int i = 1; i < argc; i++) {
+    String a(argv[i]);
+    if (a == "--out" && i + 1 < argc) outPath = argv[++i];
+    else if (a == "--binary") nativeSetBinaryTelemetry(true);
+    else if (a == "--weighting" && i + 1 < argc) prefs.putString(NVS_KEY_WEIGHTING, argv[++i]);
+    else if (a == "--account" && i + 1 < argc) prefs.putString(NVS_KEY_ACCOUNT, argv[++i]);
+    else if (a == "--realtime") realtime = true;
+    else if (a == "--max-error" && i + 1 < argc) maxError = atof(argv[++i]);
+    else if (a == "--outage" && i + 1 < argc) sscanf(argv[++i], "%lf:%lf", &outageStart, &outageLen);
+    else if (a == "--soak" && i + 1 < argc) soakMinutes = atof(argv[++i]);
+    else if (a == "--reporting" && i + 1 < argc) nativeSetReporting(argv[++i]);
+    else if (a == "--zones" && i + 1 < argc) {
+      std::ifstream f(argv[++i]);
+      if (!f) {
+        fprintf(stderr, "replay: cannot open %s\n", argv[i]);
+        return 2;
+      }
+      std::stringstream json;
+      json << f.rdbuf();
+      nativeSetZoneConfigs(json.str().c_str());
+    }
+    else if (a.startsWith("--")) {
+      fprintf(stderr, "replay: unknown option %s\n", argv[i]);
+      return 2;
+    } else files.push_back(argv[i]);
+  }
+  prefs.end();
+  if (files.empty()) {
+    fprintf(stderr, "usage: %s [--out FILE] [--binary] [--weighting Z|A|C|K] [--account ID] "
+                    "[--realtime] [--max-error DB] [--zones FILE] [--outage START:SECONDS] [--soak MINUTES] "
+                    "[--reporting JSON] file.wav [...]\n", argv[0]);
+    return 2;
+  }
+
+  FILE *out = stdout;
+  if (outPath && !(out = fopen(outPath, "w"))) {
+    fprintf(stderr, "replay: cannot write %s\n", outPath);
+    return 1;
+  }
+  nativeSetOutput(out);
+
+  setup();
+
+  ReferenceMeter ref;
+  uint8_t count;
+  const Biquad *sections = weightingSections(audioGetWeighting(), count);
+  ref.filter.set(sections, count);
+  double worst = 0;
+
+  std::vector<std::vector<int16_t>> wavs(files.size());
+  for (size_t f = 0; f < files.size(); f++) {
+    if (!loadWav(files[f], wavs[f])) return 1;
+  }
+
+  // --soak: allocations counted per minute of audio after the warm-up.
+  const uint64_t soakUs = (uint64_t)(soakMinutes * 60e6);
+  const uint64_t warmupUs = 2ull * STATS_INTERVAL_MS * 1000;
+  std::vector<uint64_t> soakMinuteAllocs;
+  soakMinuteAllocs.reserve((size_t)soakMinutes + 1);  // its own growth would be counted
+  uint64_t warmupAllocs = 0, warmupBytes = 0;
+  HeapFigures heapStart, heapEnd;
+  s_countAllocs = soakUs > 0;
+
+  using Clock = std::chrono::steady_clock;
+  const uint64_t blockUs = (uint64_t)I2S_DMA_FRAME_NUM * 1000000 / SAMPLE_RATE;
+  uint64_t audioUs = 0;
+  auto wall0 = Clock::now();
+  // One pass over the files, or as many as the soak needs.
+  for (bool more = true; more;) {
+    for (const std::vector<int16_t> &samples : wavs) {
+      for (size_t off = 0; off + I2S_DMA_FRAME_NUM <= samples.size(); off += I2S_DMA_FRAME_NUM) {
+        if (soakUs && audioUs >= soakUs) break;
+        nativeAdvanceMicros(blockUs);
+        audioUs += blockUs;
+        if (outageStart >= 0) {
+          double t = audioUs / 1e6;
+          nativeSetLinkDown(t >= outageStart && t < outageStart + outageLen);
+        }
+        nativeI2sFeed(&samples[off], I2S_DMA_FRAME_NUM);
+        ref.feed(&samples[off], I2S_DMA_FRAME_NUM);
+        if (ref.windows > 0) worst = fmax(worst, fabs((double)audioGetDbFS() - ref.dbFS));
+        loop();
+        if (realtime) std::this_thread::sleep_until(wall0 + std::chrono::microseconds(audioUs));
+        if (!soakUs) continue;
+        if (audioUs - blockUs < warmupUs && audioUs >= warmupUs) {
+          warmupAllocs = s_allocs.exchange(0);
+          warmupBytes = s_allocBytes.exchange(0);
+          heapStart = heapFigures();
+        } else if (audioUs > warmupUs && (audioUs - warmupUs) % 60000000 < blockUs) {
+          soakMinuteAllocs.push_back(s_allocs.exchange(0));
+        }
+      }
+    }
+    more = audioUs < soakUs;
+  }
+  s_countAllocs = false;
+  heapEnd = heapFigures();
+  double wall = std::chrono::duration<double>(Clock::now() - wall0).count();
+
+  fflush(out);
+  double audioSec = audioUs / 1e6;
+  fprintf(stderr, "\n[replay] %.1f s of audio in %.3f s (%.0fx realtime)\n", audioSec, wall,
+          wall > 0 ? audioSec / wall : 0.0);
+  fprintf(stderr, "[replay] frames %u, overruns %u, messages %u, display %.1f KB/s\n",
+          (unsigned)audioGetFrames(), (unsigned)audioGetOverruns(), (unsigned)nativeMessagesSent(),
+          audioSec > 0 ? qspi_bus->bytes / 1024.0 / audioSec : 0.0);
+  fprintf(stderr, "[replay] level vs double reference: max error %.5f dB over %u windows\n", worst,
+          (unsigned)ref.windows);
+  if (out != stdout) fclose(out);
+  bool ok = maxError < 0 || worst <= maxError;
+  if (!ok) fprintf(stderr, "[replay] FAIL: error exceeds %.5f dB\n", maxError);
+
+  if (soakUs) {
+    uint64_t steady = s_allocs.load();  // the part-minute at the end
+    uint64_t worstMinute = 0;
+    for (uint64_t n : soakMinuteAllocs) {
+      steady += n;
+      worstMinute = std::max(worstMinute, n);
+    }
+    fprintf(stderr, "[soak] warm-up (%u s): %llu allocations, %.1f KB\n", (unsigned)(warmupUs / 1000000),
+            (unsigned long long)warmupAllocs, warmupBytes / 1024.0);
+    fprintf(stderr, "[soak] steady state (%u min): %llu allocations, worst minute %llu\n",
+            (unsigned)soakMinuteAllocs.size(), (unsigned long long)steady, (unsigned long long)worstMinute);
+    fprintf(stderr, "[soak] host heap: in use %.1f -> %.1f KB, free but held %.1f -> %.1f KB\n",
+            heapStart.inUse / 1024.0, heapEnd.inUse / 1024.0, heapStart.held / 1024.0, heapEnd.held / 1024.0);
+    if (steady > 0) {
+      fprintf(stderr, "[soak] FAIL: the steady state allocates\n");
+      ok = false;
+    }
+  }
+  std::quick_exit(ok ? 0 : 1);  // the capture task is still parked in ulTaskNotifyTake()
+}
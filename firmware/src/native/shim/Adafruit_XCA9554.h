@@ -0,0 +1,10 @@
+#pragma once
+
+#include <Wire.h>
+
+class Adafruit_XCA9554 {
+public:
+  bool begin(uint8_t, TwoWire *) { return true; }
+  void pinMode(uint8_t, uint8_t) {}
+  void digitalWrite(uint8_t, uint8_t) {}
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+// Host stand-in for the Arduino core — only what the firmware uses. Time is
+// virtual (advanced by the replay driver and by delay()), so runs are
+// deterministic and as fast as the host allows.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#define IRAM_ATTR
+#define HIGH   1
+#define LOW    0
+#define INPUT  0
+#define OUTPUT 1
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+using std::round;
+
+class String {
+public:
+  String() {}
+  String(const char *s) : _s(s ? s : "") {}
+  String(const std::string &s) : _s(s) {}
+  String(char c) : _s(1, c) {}
+  explicit String(int v) : _s(std::to_string(v)) {}
+  explicit String(unsigned v) : _s(std::to_string(v)) {}
+  explicit String(long v) : _s(std::to_string(v)) {}
+  explicit String(unsigned long v) : _s(std::to_string(v)) {}
+
+  const char *c_str() const { return _s.c_str(); }
+  unsigned length() const { return _s.length(); }
+  String substring(unsigned from) const { return from < _s.size() ? String(_s.substr(from)) : String(); }
+  String substring(unsigned from, unsigned to) const {
+    return from < _s.size() && to > from ? String(_s.substr(from, to - from)) : String();
+  }
+  bool startsWith(const String &p) const { return _s.compare(0, p._s.size(), p._s) == 0; }
+  bool endsWith(const String &p) const {
+    return _s.size() >= p._s.size() && _s.compare(_s.size() - p._s.size(), p._s.size(), p._s) == 0;
+  }
+  int indexOf(char c) const { auto i = _s.find(c); return i == std::string::npos ? -1 : (int)i; }
+  long toInt() const { return strtol(_s.c_str(), nullptr, 10); }
+  void trim() {
+    size_t a = _s.find_first_not_of(" \t\r\n"), b = _s.find_last_not_of(" \t\r\n");
+    _s = a == std::string::npos ? "" : _s.substr(a, b - a + 1);
+  }
+  char operator[](unsigned i) const { return i < _s.size() ? _s[i] : 0; }
+
+  String &operator+=(const String &o) { _s += o._s; return *this; }
+  String &operator+=(const char *o) { _s += o; return *this; }
+  String &operator+=(char c) { _s += c; return *this; }
+  friend String operator+(const String &a, const String &b) { return String(a._s + b._s); }
+  friend String operator+(const String &a, const char *b) { return String(a._s + b); }
+  friend String operator+(const char *a, const String &b) { return String(a + b._s); }
+  bool operator==(const String &o) const { return _s == o._s; }
+  bool operator==(const char *o) const { return _s == o; }
+  bool operator!=(const String &o) const { return _s != o._s; }
+  bool operator!=(const char *o) const { return _s != o; }
+
+  // ArduinoJson's String support (reader/writer) looks for these.
+  size_t write(uint8_t c) { _s += (char)c; return 1; }
+  size_t write(const uint8_t *p, size_t n) { _s.append((const char *)p, n); return n; }
+  bool concat(const char *p) { _s += p; return true; }
+  bool concat(const char *p, unsigned n) { _s.append(p, n); return true; }
+  bool concat(char c) { _s += c; return true; }
+  bool reserve(unsigned n) { _s.reserve(n); return true; }
+
+private:
+  std::string _s;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t n) {
+    size_t done = 0;
+    while (n--) done += write(*buf++);
+    return done;
+  }
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return printf("%d", v); }
+  size_t print(unsigned v) { return printf("%u", v); }
+  size_t print(long v) { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+  size_t println() { return write("\n"); }
+  template <typename T> size_t println(const T &v) { return print(v) + println(); }
+
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    return write((const uint8_t *)buf, std::min((size_t)n, sizeof(buf) - 1));
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  virtual int peek() { return -1; }
+  void setTimeout(unsigned long ms) { _timeout = ms; }
+  size_t readBytes(char *buf, size_t n) {
+    size_t got = 0;
+    for (int c; got < n && (c = read()) >= 0;) buf[got++] = (char)c;
+    return got;
+  }
+  size_t readBytes(uint8_t *buf, size_t n) { return readBytes((char *)buf, n); }
+
+protected:
+  unsigned long _timeout = 1000;
+};
+
+// Serial goes to stderr so stdout stays free for the replay output.
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t c) override { return fputc(c, stderr) == EOF ? 0 : 1; }
+  size_t write(const uint8_t *buf, size_t n) override { return fwrite(buf, 1, n, stderr); }
+  void flush() { fflush(stderr); }
+  using Print::write;
+};
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+inline void yield() {}
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return LOW; }
+
+class EspClass {
+public:
+  uint32_t getCycleCount();  // host CPU time scaled to getCpuFreqMHz()
+  uint32_t getCpuFreqMHz() { return 240; }
+  uint32_t getFreeHeap() { return 256 * 1024; }
+  [[noreturn]] void restart();
+};
+extern EspClass ESP;
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Stand-in for moononournation/GFX Library for Arduino: the same virtual
+// drawing hooks (so DirtyCanvas runs unmodified), a synthetic 5x7 glyph per
+// character instead of the real font, and a bus that only counts bytes.
+
+#define GFX_NOT_DEFINED -1
+
+class Arduino_DataBus {
+public:
+  virtual ~Arduino_DataBus() {}
+  virtual void writePixels(uint16_t *data, uint32_t len) { (void)data; bytes += len * 2; }
+  uint64_t bytes = 0;  // pixel bytes that would have crossed the bus
+};
+
+class Arduino_ESP32QSPI : public Arduino_DataBus {
+public:
+  Arduino_ESP32QSPI(int8_t, int8_t, int8_t, int8_t, int8_t, int8_t) {}
+};
+
+class Arduino_GFX : public Print {
+public:
+  Arduino_GFX(int16_t w, int16_t h) : WIDTH(w), HEIGHT(h) {}
+
+  virtual bool begin(int32_t speed = GFX_NOT_DEFINED) = 0;
+  virtual void startWrite() {}
+  virtual void endWrite() {}
+  virtual void writePixelPreclipped(int16_t x, int16_t y, uint16_t color) = 0;
+
+  virtual void writeFillRectPreclipped(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    for (int16_t r = y; r < y + h; r++)
+      for (int16_t c = x; c < x + w; c++) writePixelPreclipped(c, r, color);
+  }
+  virtual void writeFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) { writeFillRect(x, y, w, 1, color); }
+  virtual void writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) { writeFillRect(x, y, 1, h, color); }
+
+  void writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > WIDTH) w = WIDTH - x;
+    if (y + h > HEIGHT) h = HEIGHT - y;
+    if (w > 0 && h > 0) writeFillRectPreclipped(x, y, w, h, color);
+  }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    startWrite();
+    writeFillRect(x, y, w, h, color);
+    endWrite();
+  }
+  void fillScreen(uint16_t color) { fillRect(0, 0, WIDTH, HEIGHT, color); }
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+    startWrite();
+    writeFastHLine(x, y, w, color);
+    endWrite();
+  }
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+    startWrite();
+    writeFastVLine(x, y, h, color);
+    endWrite();
+  }
+
+  void setCursor(int16_t x, int16_t y) { _cx = x; _cy = y; }
+  void setTextColor(uint16_t c) { _fg = c; }
+  void setTextSize(uint8_t s) { _size = s ? s : 1; }
+
+  size_t write(uint8_t c) override {
+    if (c == '\n') {
+      _cx = 0;
+      _cy += 8 * _size;
+      return 1;
+    }
+    startWrite();
+    uint32_t bits = (c * 2654435761u) ^ (c << 7);  // stable pseudo-glyph per character
+    for (int col = 0; col < 5; col++)
+      for (int row = 0; row < 7; row++)
+        if (c != ' ' && (bits >> ((col * 7 + row) % 32) & 1))
+          writeFillRect(_cx + col * _size, _cy + row * _size, _size, _size, _fg);
+    endWrite();
+    _cx += 6 * _size;
+    return 1;
+  }
+  using Print::write;
+
+protected:
+  int16_t WIDTH, HEIGHT;
+  int16_t _cx = 0, _cy = 0;
+  uint16_t _fg = 0xFFFF;
+  uint8_t _size = 1;
+};
+
+class Arduino_TFT : public Arduino_GFX {
+public:
+  Arduino_TFT(Arduino_DataBus *bus, int16_t w, int16_t h) : Arduino_GFX(w, h), _bus(bus) {}
+  bool begin(int32_t = GFX_NOT_DEFINED) override { return true; }
+  virtual void writeAddrWindow(int16_t, int16_t, uint16_t, uint16_t) {}
+  void writePixelPreclipped(int16_t, int16_t, uint16_t) override { _bus->bytes += 2; }
+  void writeFillRectPreclipped(int16_t, int16_t, int16_t w, int16_t h, uint16_t) override {
+    _bus->bytes += (uint64_t)w * h * 2;
+  }
+
+protected:
+  Arduino_DataBus *_bus;
+};
+
+class Arduino_SH8601 : public Arduino_TFT {
+public:
+  Arduino_SH8601(Arduino_DataBus *bus, int8_t, uint8_t, int16_t w, int16_t h) : Arduino_TFT(bus, w, h) {}
+  void setBrightness(uint8_t) {}
+};
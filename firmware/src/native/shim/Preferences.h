@@ -0,0 +1,51 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include <Arduino.h>
+
+// In-memory NVS: starts empty every run (the replay driver may pre-seed keys).
+class Preferences {
+public:
+  bool begin(const char *ns, bool readOnly = false) { _ns = ns; (void)readOnly; return true; }
+  void end() {}
+  bool isKey(const char *key) { return store().count(k(key)) > 0; }
+  bool remove(const char *key) { return store().erase(k(key)) > 0; }
+  bool clear();
+
+  String getString(const char *key, const String &def = String()) {
+    auto it = store().find(k(key));
+    return it == store().end() ? def : String(it->second);
+  }
+  size_t putString(const char *key, const String &v) { store()[k(key)] = v.c_str(); return v.length(); }
+
+  uint8_t getUChar(const char *key, uint8_t def = 0) { return getNum<uint8_t>(key, def); }
+  size_t putUChar(const char *key, uint8_t v) { return putBytes(key, &v, sizeof(v)); }
+  uint32_t getUInt(const char *key, uint32_t def = 0) { return getNum<uint32_t>(key, def); }
+  size_t putUInt(const char *key, uint32_t v) { return putBytes(key, &v, sizeof(v)); }
+
+  size_t getBytesLength(const char *key) {
+    auto it = store().find(k(key));
+    return it == store().end() ? 0 : it->second.size();
+  }
+  size_t getBytes(const char *key, void *buf, size_t len) {
+    auto it = store().find(k(key));
+    if (it == store().end() || it->second.size() > len) return 0;
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+  }
+  size_t putBytes(const char *key, const void *buf, size_t len) {
+    store()[k(key)] = std::string((const char *)buf, len);
+    return len;
+  }
+
+private:
+  static std::map<std::string, std::string> &store();
+  std::string k(const char *key) const { return _ns + "/" + key; }
+  template <typename T> T getNum(const char *key, T def) {
+    T v;
+    return getBytes(key, &v, sizeof(v)) == sizeof(v) ? v : def;
+  }
+  std::string _ns;
+};
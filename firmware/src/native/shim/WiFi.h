@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Always-connected station: the replay is about the measurement path.
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+
+class IPAddress {
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : _b{a, b, c, d} {}
+  operator uint32_t() const { return _b[0] | (_b[1] << 8) | (_b[2] << 16) | ((uint32_t)_b[3] << 24); }
+  uint8_t operator[](int i) const { return _b[i]; }
+  String toString() const {
+    char s[16];
+    snprintf(s, sizeof(s), "%u.%u.%u.%u", _b[0], _b[1], _b[2], _b[3]);
+    return String(s);
+  }
+
+private:
+  uint8_t _b[4];
+};
+
+// Base class only (TlsClient derives from it); nothing connects natively.
+class WiFiClient {
+public:
+  virtual ~WiFiClient() {}
+  virtual int connect(IPAddress, uint16_t) { return 0; }
+  virtual int connect(const char *, uint16_t) { return 0; }
+  virtual size_t write(uint8_t) { return 0; }
+  virtual size_t write(const uint8_t *, size_t) { return 0; }
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+  virtual int read(uint8_t *, size_t) { return -1; }
+  virtual int peek() { return -1; }
+  virtual void flush() {}
+  virtual void stop() {}
+  virtual uint8_t connected() { return 0; }
+};
+
+class WiFiClass {
+public:
+  bool mode(wifi_mode_t) { return true; }
+  void macAddress(uint8_t mac[6]) {
+    static const uint8_t fixed[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    memcpy(mac, fixed, 6);
+  }
+  wl_status_t status() { return WL_CONNECTED; }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  int8_t RSSI() { return -55; }
+  bool reconnect() { return true; }
+  bool disconnect(bool = false) { return true; }
+};
+extern WiFiClass WiFi;
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Portable versions of the esp-dsp calls bands.cpp uses, with the same
+// conventions: interleaved re/im, fft2r leaves bins in bit-reversed order.
+
+typedef int esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK 0
+#endif
+
+inline esp_err_t dsps_fft2r_init_fc32(float *, int) { return ESP_OK; }
+
+inline void dsps_wind_hann_f32(float *w, int len) {
+  for (int i = 0; i < len; i++) w[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / len);
+}
+
+// Radix-2 decimation in frequency: natural-order in, bit-reversed out.
+inline esp_err_t dsps_fft2r_fc32(float *data, int n) {
+  for (int half = n / 2; half >= 1; half /= 2) {
+    for (int start = 0; start < n; start += 2 * half) {
+      for (int k = 0; k < half; k++) {
+        float ang = -(float)M_PI * k / half;
+        float wr = cosf(ang), wi = sinf(ang);
+        float *a = &data[(start + k) * 2], *b = &data[(start + k + half) * 2];
+        float dr = a[0] - b[0], di = a[1] - b[1];
+        a[0] += b[0];
+        a[1] += b[1];
+        b[0] = dr * wr - di * wi;
+        b[1] = dr * wi + di * wr;
+      }
+    }
+  }
+  return ESP_OK;
+}
+
+inline esp_err_t dsps_bit_rev_fc32(float *data, int n) {
+  for (int i = 1, j = 0; i < n; i++) {
+    int bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      float tr = data[i * 2], ti = data[i * 2 + 1];
+      data[i * 2] = data[j * 2];
+      data[i * 2 + 1] = data[j * 2 + 1];
+      data[j * 2] = tr;
+      data[j * 2 + 1] = ti;
+    }
+  }
+  return ESP_OK;
+}
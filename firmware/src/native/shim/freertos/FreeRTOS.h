@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+typedef int BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portMAX_DELAY     ((TickType_t)0xFFFFFFFF)
+
+// Critical sections become a plain mutex (tasks are host threads).
+struct portMUX_TYPE {
+  std::mutex m;
+};
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) (mux)->m.lock()
+#define portEXIT_CRITICAL(mux)  (mux)->m.unlock()
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)  portEXIT_CRITICAL(mux)
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+
+#include "FreeRTOS.h"
+
+// Binary semaphores, and mutexes as binary semaphores created given (no
+// priority inheritance; host threads have no priorities). Takes block on the host thread without advancing
+// virtual time; the timeout is ignored (like ulTaskNotifyTake, nothing here
+// waits on time passing).
+struct NativeSemaphore {
+  std::mutex m;
+  std::condition_variable cv;
+  bool given = false;
+};
+typedef NativeSemaphore *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() { return new NativeSemaphore; }
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+  SemaphoreHandle_t s = new NativeSemaphore;
+  s->given = true;
+  return s;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+  std::lock_guard<std::mutex> lock(s->m);
+  s->given = true;
+  s->cv.notify_all();
+  return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t) {
+  std::unique_lock<std::mutex> lock(s->m);
+  s->cv.wait(lock, [s] { return s->given; });
+  s->given = false;
+  return pdTRUE;
+}
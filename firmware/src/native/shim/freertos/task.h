@@ -0,0 +1,20 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+// Tasks run as host threads. Notifications are what the replay driver syncs
+// on: a task blocked in ulTaskNotifyTake() with nothing pending is "idle".
+typedef struct NativeTask *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core);
+inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                              UBaseType_t prio, TaskHandle_t *handle) {
+  return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, handle, 0);
+}
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken);
+void xTaskNotifyGive(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelete(TaskHandle_t task);  // nullptr (the calling task) only
@@ -0,0 +1,367 @@
+// Host implementations behind the native/shim headers, plus API-level
+// stand-ins for the modules that are not built natively (OTA, provisioning).
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <pthread.h>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <Wire.h>
+#include <driver/i2s_std.h>
+#include <freertos/task.h>
+
+#include "../config.h"
+#include "../ota.h"
+#include "../provisioning.h"
+#include "../tls.h"
+#include "../wallclock.h"
+#include "../wsclient.h"
+#include "native.h"
+
+HardwareSerial Serial;
+TwoWire Wire;
+WiFiClass WiFi;
+EspClass ESP;
+
+// --- Virtual clock ---
+
+static std::atomic<uint64_t> s_nowUs{0};
+
+void nativeAdvanceMicros(uint64_t us) { s_nowUs += us; }
+unsigned long millis() { return (unsigned long)(s_nowUs / 1000); }
+unsigned long micros() { return (unsigned long)s_nowUs; }
+void delay(unsigned long ms) { s_nowUs += (uint64_t)ms * 1000; }
+
+uint32_t EspClass::getCycleCount() {
+  using namespace std::chrono;
+  uint64_t ns = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+  return (uint32_t)(ns * getCpuFreqMHz() / 1000);
+}
+
+void EspClass::restart() {
+  fflush(nullptr);
+  std::quick_exit(0);
+}
+
+// --- Tasks ---
+
+// One lock for every task's state, so waitAllIdle() sees a consistent snapshot:
+// a task woken by another after being checked could otherwise be missed.
+struct NativeTask {
+  uint32_t notified = 0;
+  bool waiting = false;
+};
+
+static std::mutex s_taskMutex;
+static std::condition_variable s_taskCv;
+static thread_local NativeTask *t_self = nullptr;
+static std::vector<NativeTask *> s_tasks;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *, uint32_t, void *arg,
+                                   UBaseType_t, TaskHandle_t *handle, BaseType_t) {
+  NativeTask *task = new NativeTask;
+  {
+    std::lock_guard<std::mutex> lock(s_taskMutex);
+    s_tasks.push_back(task);
+  }
+  if (handle) *handle = task;
+  std::thread([task, fn, arg] {
+    t_self = task;
+    fn(arg);
+  }).detach();
+  return pdTRUE;
+}
+
+// Virtual time: the timeout never expires, the driver always feeds more audio.
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t) {
+  NativeTask *task = t_self;
+  std::unique_lock<std::mutex> lock(s_taskMutex);
+  task->waiting = true;
+  s_taskCv.notify_all();
+  s_taskCv.wait(lock, [task] { return task->notified > 0; });
+  task->waiting = false;
+  uint32_t n = task->notified;
+  task->notified = clearOnExit ? 0 : n - 1;
+  return n;
+}
+
+void xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(s_taskMutex);
+  task->notified++;
+  s_taskCv.notify_all();
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+  xTaskNotifyGive(task);
+  if (woken) *woken = pdTRUE;
+}
+
+void vTaskDelay(TickType_t ticks) { delay(ticks); }
+
+// A finished task counts as idle for waitAllIdle().
+void vTaskDelete(TaskHandle_t) {
+  {
+    std::lock_guard<std::mutex> lock(s_taskMutex);
+    t_self->waiting = true;
+    s_taskCv.notify_all();
+  }
+  pthread_exit(nullptr);
+}
+
+// Block until every task is parked in ulTaskNotifyTake() with nothing pending.
+static void waitAllIdle() {
+  std::unique_lock<std::mutex> lock(s_taskMutex);
+  s_taskCv.wait(lock, [] {
+    for (NativeTask *task : s_tasks)
+      if (!task->waiting || task->notified > 0) return false;
+    return true;
+  });
+}
+
+// --- I2S RX channel ---
+
+struct i2s_channel_obj_t {
+  std::mutex m;
+  std::deque<int16_t> queue;
+  i2s_event_callbacks_t cbs = {};
+  void *user = nullptr;
+  bool enabled = false;
+};
+
+static i2s_channel_obj_t s_rx;
+
+esp_err_t i2s_new_channel(const i2s_chan_config_t *, i2s_chan_handle_t *tx, i2s_chan_handle_t *rx) {
+  if (tx) *tx = nullptr;
+  if (rx) *rx = &s_rx;
+  return ESP_OK;
+}
+
+esp_err_t i2s_channel_init_std_mode(i2s_chan_handle_t, const i2s_std_config_t *cfg) {
+  return cfg->clk_cfg.sample_rate_hz == SAMPLE_RATE ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t i2s_channel_register_event_callback(i2s_chan_handle_t h, const i2s_event_callbacks_t *cbs, void *user) {
+  h->cbs = *cbs;
+  h->user = user;
+  return ESP_OK;
+}
+
+esp_err_t i2s_channel_enable(i2s_chan_handle_t h) {
+  h->enabled = true;
+  return ESP_OK;
+}
+
+esp_err_t i2s_channel_read(i2s_chan_handle_t h, void *dest, size_t size, size_t *bytesRead, uint32_t) {
+  std::lock_guard<std::mutex> lock(h->m);
+  size_t n = std::min(size / sizeof(int16_t), h->queue.size());
+  int16_t *out = (int16_t *)dest;
+  for (size_t i = 0; i < n; i++) {
+    out[i] = h->queue.front();
+    h->queue.pop_front();
+  }
+  *bytesRead = n * sizeof(int16_t);
+  return n > 0 ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void nativeI2sFeed(const int16_t *samples, size_t count) {
+  if (!s_rx.enabled) return;
+  {
+    NativeHarnessScope harness;  // the DMA ring is fixed memory on the device
+    std::lock_guard<std::mutex> lock(s_rx.m);
+    s_rx.queue.insert(s_rx.queue.end(), samples, samples + count);
+  }
+  if (s_rx.cbs.on_recv) s_rx.cbs.on_recv(&s_rx, nullptr, s_rx.user);
+  waitAllIdle();
+}
+
+// --- NVS ---
+
+std::map<std::string, std::string> &Preferences::store() {
+  static std::map<std::string, std::string> s;
+  return s;
+}
+
+bool Preferences::clear() {
+  std::string prefix = _ns + "/";
+  for (auto it = store().begin(); it != store().end();)
+    it = it->first.compare(0, prefix.size(), prefix) == 0 ? store().erase(it) : std::next(it);
+  return true;
+}
+
+// --- Harness allocations (native.h) ---
+
+static thread_local int s_harnessDepth = 0;
+
+NativeHarnessScope::NativeHarnessScope() { s_harnessDepth++; }
+NativeHarnessScope::~NativeHarnessScope() { s_harnessDepth--; }
+bool nativeInHarness() { return s_harnessDepth > 0; }
+
+// --- Websocket loopback ---
+
+static FILE *s_out = stdout;
+static bool s_acceptBinary = false;
+static std::string s_zoneConfigs;
+static std::string s_reporting;
+static bool s_linkDown = false;
+static uint32_t s_sent = 0;
+
+void nativeSetOutput(FILE *out) { s_out = out; }
+void nativeSetBinaryTelemetry(bool accept) { s_acceptBinary = accept; }
+void nativeSetZoneConfigs(const char *json) { s_zoneConfigs = json ? json : ""; }
+void nativeSetReporting(const char *json) { s_reporting = json ? json : ""; }
+void nativeSetLinkDown(bool down) { s_linkDown = down; }
+uint32_t nativeMessagesSent() { return s_sent; }
+
+// Connects on the first loop(), answers "register" and "volume_intent" like the
+// server would, and hands everything the firmware sends to the replay output.
+struct WsState {
+  String url;
+  bool begun = false;
+  std::deque<String> replies;  // delivered on the next loop(), never inside a send
+};
+
+WsClient::~WsClient() { delete _s; }
+
+void WsClient::begin(const char *host, uint16_t port, const char *url) { start(host, port, url, false); }
+void WsClient::beginSSL(const char *host, uint16_t port, const char *url) { start(host, port, url, true); }
+
+void WsClient::start(const char *host, uint16_t port, const char *url, bool) {
+  if (!_s) _s = new WsState;
+  _s->url = String(host) + ":" + String((unsigned)port) + url;
+  _s->begun = true;
+}
+
+void WsClient::closed() {
+  _s->replies.clear();
+  if (!_connected) return;
+  _connected = false;
+  if (_cb) _cb(WStype_DISCONNECTED, nullptr, 0);
+}
+
+void WsClient::loop() {
+  if (!_s || !_s->begun || !_cb) return;
+  if (s_linkDown) {
+    closed();
+    return;
+  }
+  if (!_connected) {
+    _connected = true;
+    _cb(WStype_CONNECTED, (uint8_t *)_s->url.c_str(), _s->url.length());
+  }
+  while (!_s->replies.empty()) {
+    String msg;
+    {
+      NativeHarnessScope harness;
+      msg = _s->replies.front();
+      _s->replies.pop_front();
+    }
+    _cb(WStype_TEXT, (uint8_t *)msg.c_str(), msg.length());
+  }
+}
+
+void WsClient::disconnect() {
+  if (!_s) return;
+  closed();
+  _s->begun = false;
+}
+
+bool WsClient::sendTXT(const char *payload, size_t length) {
+  if (!_connected) return false;
+  NativeHarnessScope harness;
+  if (length == 0) length = strlen(payload);
+  if (strstr(payload, "\"type\":\"register\"")) {
+    std::string reply = "{\"type\":\"registered\"";
+    if (s_acceptBinary) reply += ",\"telemetry\":\"bin1\"";
+    if (!s_zoneConfigs.empty()) reply += ",\"control\":\"device\",\"configs\":" + s_zoneConfigs;
+    if (!s_reporting.empty()) reply += ",\"reporting\":" + s_reporting;
+    _s->replies.push_back(String((reply + "}").c_str()));
+  }
+  // Every intent succeeds, as if Soundtrack applied it at once.
+  if (const char *seq = strstr(payload, "\"type\":\"volume_intent\"") ? strstr(payload, "\"seq\":") : nullptr) {
+    char ack[80];
+    snprintf(ack, sizeof(ack), "{\"type\":\"volume_ack\",\"seq\":%lu,\"ok\":true,\"playerOnline\":true}",
+             strtoul(seq + 6, nullptr, 10));
+    _s->replies.push_back(String(ack));
+  }
+  fprintf(s_out, "%lu\t%.*s\n", millis(), (int)length, payload);
+  s_sent++;
+  return true;
+}
+
+bool WsClient::sendBIN(const uint8_t *payload, size_t length) {
+  if (!_connected) return false;
+  NativeHarnessScope harness;
+  fprintf(s_out, "%lu\tbin ", millis());
+  for (size_t i = 0; i < length; i++) fprintf(s_out, "%02x", payload[i]);
+  fputc('\n', s_out);
+  s_sent++;
+  return true;
+}
+
+bool WsClient::sendTXT(uint8_t *payload, size_t length, bool headerToPayload) {
+  return sendTXT((const char *)payload + (headerToPayload ? WEBSOCKETS_MAX_HEADER_SIZE : 0), length);
+}
+
+bool WsClient::sendBIN(uint8_t *payload, size_t length, bool headerToPayload) {
+  return sendBIN((const uint8_t *)payload + (headerToPayload ? WEBSOCKETS_MAX_HEADER_SIZE : 0), length);
+}
+
+// --- Wall clock: the virtual clock, starting 2026-01-01T00:00:00Z ---
+
+bool wallclockInit() { return true; }
+void wallclockStartNtp() {}
+void wallclockLoop() {}
+bool wallclockNow(uint32_t &unixSec, uint16_t &ms) {
+  uint64_t now = millis();
+  unixSec = 1767225600u + (uint32_t)(now / 1000);
+  ms = (uint16_t)(now % 1000);
+  return true;
+}
+
+// --- Provisioning / OTA / TLS: network- and touch-bound, not built natively ---
+
+void provisioningBegin() {}
+bool provisioningInit(Arduino_GFX *) { return true; }
+void wifiReconnect() {}
+void wifiOnConnected() {}
+uint32_t wifiConnectMs() { return 0; }
+bool wifiFastConnected() { return false; }
+void portalStart(Arduino_GFX *, bool) {}
+bool portalActive() { return false; }
+bool portalLoop(unsigned long) { return false; }
+void portalStop() {}
+bool checkTouchAction(Arduino_GFX *) { return false; }
+void resetProvisioning() {
+  Preferences prefs;
+  prefs.begin("autovolume", false);
+  prefs.clear();
+  prefs.end();
+}
+
+String getAccountId() {
+  Preferences prefs;
+  prefs.begin("autovolume", true);
+  String id = prefs.getString(NVS_KEY_ACCOUNT, "");
+  prefs.end();
+  return id;
+}
+
+static TlsStats s_tlsStats = {};
+const TlsStats &tlsStats() { return s_tlsStats; }
+void tlsNoteWebsocketConnect(uint32_t ms) {
+  s_tlsStats.wsConnects++;
+  s_tlsStats.wsMs += ms;
+}
+void tlsClearSessions() {}
+
+void otaInit(Arduino_GFX *, OtaHook, OtaHook) {}
+void otaBootCheck() {}
+void otaMarkValidIfPending() {}
+void otaLoop(unsigned long, bool, const String &) {}
+void otaRequestCheck() {}
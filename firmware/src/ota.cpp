@@ -1,8 +1,6 @@
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WiFiClientSecure.h>
 #include <HTTPClient.h>
-#include <HTTPUpdate.h>
 #include <Preferences.h>
 #include <ArduinoJson.h>
 #include <esp_ota_ops.h>
@@ -10,6 +8,10 @@
 
 #include "config.h"
 #include "ota.h"
+#include "delta.h"
+#include "download.h"
+#include "tls.h"
+#include "logring.h"
 
 // NVS namespace shared with provisioning (Preferences "autovolume").
 static const char *NVS_NS = "autovolume";
@@ -22,6 +24,7 @@ static volatile bool s_forceCheck = false;
 static unsigned long s_lastCheck = 0;
 static unsigned long s_firstConnect = 0;
 static bool s_didInitialCheck = false;
+static unsigned long s_resumeAt = 0;  // retry a paused download (0 = none pending)
 
 void otaInit(Arduino_GFX *gfx, OtaHook beforeUpdate, OtaHook afterFailedUpdate) {
   s_gfx = gfx;
@@ -68,7 +71,7 @@ void otaBootCheck() {
   if (pend) {
     uint8_t boots = prefs.getUChar("ota_boots", 0) + 1;
     prefs.putUChar("ota_boots", boots);
-    Serial.printf("[ota] new image on probation (boot %u/%u)\n", boots, OTA_MAX_PROBATION_BOOTS);
+    LOGI(LOG_OTA, "new image on probation (boot %u/%u)", boots, OTA_MAX_PROBATION_BOOTS);
     if (boots >= OTA_MAX_PROBATION_BOOTS) {
       // The new image never reached the server — roll back to the partition we
       // came from. This works WITHOUT a rollback-enabled bootloader because we
@@ -77,12 +80,13 @@ void otaBootCheck() {
       prefs.putUChar("ota_pend", 0);
       prefs.putUChar("ota_boots", 0);
       prefs.end();
-      Serial.printf("[ota] image failed to validate — reverting to %s\n", prev.c_str());
+      LOGW(LOG_OTA, "image failed to validate — reverting to %s", prev.c_str());
       if (prev.length() > 0) {
         const esp_partition_t *p = esp_partition_find_first(
             ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, prev.c_str());
         if (p) esp_ota_set_boot_partition(p);
       }
+      logFlush();
       delay(200);
       ESP.restart();
       return;
@@ -97,7 +101,7 @@ void otaMarkValidIfPending() {
   if (prefs.getUChar("ota_pend", 0)) {
     prefs.putUChar("ota_pend", 0);
     prefs.putUChar("ota_boots", 0);
-    Serial.println("[ota] new image validated — server reachable");
+    LOGI(LOG_OTA, "new image validated — server reachable");
   }
   prefs.end();
 
@@ -112,35 +116,66 @@ void otaMarkValidIfPending() {
   }
 }
 
-static void performUpdate(const String &binUrl) {
-  Serial.printf("[ota] downloading %s\n", binUrl.c_str());
+static void otaProgress(size_t cur, size_t total) {
+  static int lastPct = -1;
+  int pct = total > 0 ? (int)(((uint64_t)cur * 100) / total) : 0;
+  if (pct != lastPct && pct % 5 == 0) {
+    lastPct = pct;
+    LOGI(LOG_OTA, "%d%%", pct);
+    if (s_gfx) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "%d%%", pct);
+      s_gfx->fillRect(20, 230, 220, 40, 0x0000);
+      s_gfx->setTextSize(3);
+      s_gfx->setTextColor(0xFFFF);
+      s_gfx->setCursor(20, 230);
+      s_gfx->print(buf);
+    }
+  }
+}
+
+// Rebuild the new image from the running one plus a patch. Any failure leaves
+// the inactive slot uncommitted, so the caller can fall back to the full image.
+static bool deltaUpdate(const String &url, const uint8_t *sha256) {
+  LOGI(LOG_OTA, "downloading delta %s", url.c_str());
+  TlsClient client;  // resumes the manifest check's TLS session
+  HTTPClient http;
+  http.setConnectTimeout(8000);
+  http.setTimeout(8000);
+  if (!http.begin(client, url)) return false;
+  int code = http.GET();
+  int size = http.getSize();
+  if (code != HTTP_CODE_OK || size <= 0) {
+    LOGI(LOG_OTA, "delta HTTP %d (size %d)", code, size);
+    http.end();
+    return false;
+  }
+  unsigned long t0 = millis();
+  bool ok = deltaApply(*http.getStreamPtr(), size, sha256, otaProgress);
+  http.end();
+  if (ok) LOGI(LOG_OTA, "delta applied: %d bytes downloaded in %lu ms", size, millis() - t0);
+  return ok;
+}
+
+// deltaUrl may be empty (no patch from this version).
+static void performUpdate(const String &binUrl, size_t size, const String &deltaUrl,
+                          const uint8_t sha256[32]) {
   otaShowScreen("Updating", "Please wait...", 0x07FF);
 
   if (s_before) s_before(); // drop the websocket so TLS has the heap it needs
 
-  WiFiClientSecure client;
-  client.setInsecure(); // TODO: pin Render's CA or enforce manifest md5 for stronger integrity
-  httpUpdate.rebootOnUpdate(false);
-  httpUpdate.onProgress([](int cur, int total) {
-    static int lastPct = -1;
-    int pct = total > 0 ? (cur * 100) / total : 0;
-    if (pct != lastPct && pct % 5 == 0) {
-      lastPct = pct;
-      Serial.printf("[ota] %d%%\n", pct);
-      if (s_gfx) {
-        char buf[8];
-        snprintf(buf, sizeof(buf), "%d%%", pct);
-        s_gfx->fillRect(20, 230, 220, 40, 0x0000);
-        s_gfx->setTextSize(3);
-        s_gfx->setTextColor(0xFFFF);
-        s_gfx->setCursor(20, 230);
-        s_gfx->print(buf);
-      }
-    }
-  });
+  // A half-finished full download of this image is worth more than a fresh
+  // delta attempt, which would overwrite the slot it is resuming into.
+  bool ok = false;
+  bool resuming = downloadPending(sha256);
+  if (deltaUrl.length() > 0 && !resuming) {
+    downloadReset();
+    ok = deltaUpdate(deltaUrl, sha256);
+    if (!ok) LOGI(LOG_OTA, "delta unusable — falling back to full image");
+  }
+  if (!ok) ok = downloadImage(binUrl, size, sha256, otaProgress);
 
-  t_httpUpdate_return ret = httpUpdate.update(client, binUrl);
-  if (ret == HTTP_UPDATE_OK) {
+  if (ok) {
     // Image written and set as boot partition. Mark it on probation: it must
     // reach the server within OTA_MAX_PROBATION_BOOTS reboots or otaBootCheck()
     // reverts to the partition we are running right now.
@@ -151,36 +186,48 @@ static void performUpdate(const String &binUrl) {
     prefs.putUChar("ota_pend", 1);
     prefs.putUChar("ota_boots", 0);
     prefs.end();
-    Serial.println("[ota] update written — rebooting into new image");
+    LOGI(LOG_OTA, "update written — rebooting into new image");
     otaShowScreen("Updated", "Restarting...", 0x07E0);
+    logFlush();
     delay(800);
     ESP.restart();
   } else {
-    Serial.printf("[ota] update failed (%d): %s\n", ret,
-                  httpUpdate.getLastErrorString().c_str());
+    // A paused download keeps its checkpoint; come back for it soon rather
+    // than at the next 6-hourly check.
+    if (downloadPending(sha256)) s_resumeAt = millis() + OTA_RESUME_DELAY_MS;
     otaShowScreen("Update failed", "Staying on current", 0xFD20);
     delay(1500);
     if (s_after) s_after(); // bring the websocket back up
   }
 }
 
+// "ab12..." (64 hex chars) -> 32 bytes. False if absent or malformed.
+static bool parseSha256(const char *hex, uint8_t out[32]) {
+  if (strlen(hex) != 64) return false;
+  for (int i = 0; i < 32; i++) {
+    unsigned v;
+    if (sscanf(hex + i * 2, "%2x", &v) != 1) return false;
+    out[i] = (uint8_t)v;
+  }
+  return true;
+}
+
 static void otaCheckNow(const String &host) {
   if (WiFi.status() != WL_CONNECTED || host.length() == 0) return;
-  String url = String("https://") + host + OTA_VERSION_PATH;
-  Serial.printf("[ota] checking %s\n", url.c_str());
+  String url = String("https://") + host + (WS_PORT != 443 ? ":" + String(WS_PORT) : "") + OTA_VERSION_PATH;
+  LOGI(LOG_OTA, "checking %s", url.c_str());
 
-  WiFiClientSecure client;
-  client.setInsecure();
+  TlsClient client;  // after the first check, a resumed (abbreviated) handshake
   HTTPClient http;
   http.setConnectTimeout(8000);
   http.setTimeout(8000);
   if (!http.begin(client, url)) {
-    Serial.println("[ota] http.begin failed");
+    LOGW(LOG_OTA, "http.begin failed");
     return;
   }
   int code = http.GET();
   if (code != HTTP_CODE_OK) {
-    Serial.printf("[ota] version check HTTP %d\n", code);
+    LOGW(LOG_OTA, "version check HTTP %d", code);
     http.end();
     return;
   }
@@ -189,21 +236,35 @@ static void otaCheckNow(const String &host) {
 
   JsonDocument doc;
   if (deserializeJson(doc, body) != DeserializationError::Ok) {
-    Serial.println("[ota] bad manifest JSON");
+    LOGW(LOG_OTA, "bad manifest JSON");
     return;
   }
   const char *remoteVer = doc["version"] | "";
   const char *binUrl = doc["url"] | "";
   bool available = doc["available"] | true;
   if (!available || strlen(remoteVer) == 0 || strlen(binUrl) == 0) {
-    Serial.println("[ota] no image published");
+    LOGI(LOG_OTA, "no image published");
     return;
   }
   if (otaVersionNewer(String(remoteVer), String(FW_VERSION))) {
-    Serial.printf("[ota] update available: %s -> %s\n", FW_VERSION, remoteVer);
-    performUpdate(String(binUrl));
+    LOGI(LOG_OTA, "update available: %s -> %s", FW_VERSION, remoteVer);
+    // Prefer a patch made against exactly the version we are running.
+    const char *deltaUrl = "";
+    for (JsonObject d : doc["deltas"].as<JsonArray>()) {
+      if (strcmp(d["from"] | "", FW_VERSION) == 0) {
+        deltaUrl = d["url"] | "";
+        break;
+      }
+    }
+    uint8_t sha[32];
+    size_t size = doc["size"] | 0;
+    if (!parseSha256(doc["sha256"] | "", sha) || size == 0) {
+      LOGW(LOG_OTA, "manifest has no sha256/size — refusing unverifiable image");
+      return;
+    }
+    performUpdate(String(binUrl), size, String(deltaUrl), sha);
   } else {
-    Serial.printf("[ota] up to date (local %s, remote %s)\n", FW_VERSION, remoteVer);
+    LOGI(LOG_OTA, "up to date (local %s, remote %s)", FW_VERSION, remoteVer);
   }
 }
 
@@ -222,6 +283,14 @@ void otaLoop(unsigned long now, bool wsConnected, const String &host) {
     return;
   }
 
+  // Resume a download that was paused by a flaky connection.
+  if (s_resumeAt != 0 && (long)(now - s_resumeAt) >= 0) {
+    s_resumeAt = 0;
+    s_lastCheck = now;
+    otaCheckNow(host);
+    return;
+  }
+
   // One check ~30s after settling online.
   if (!s_didInitialCheck && now - s_firstConnect >= OTA_INITIAL_DELAY_MS) {
     s_didInitialCheck = true;
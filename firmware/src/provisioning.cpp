@@ -1,16 +1,35 @@
 #include "provisioning.h"
 #include "config.h"
 #include "pins.h"
+#include "logring.h"
 
 #include <WiFi.h>
 #include <WiFiManager.h>
 #include <Preferences.h>
 #include <Wire.h>
+#include <esp_wifi.h>
 
 static Preferences prefs;
 static const char* NVS_NAMESPACE = "autovolume";
 // NVS_KEY_ACCOUNT defined in config.h
 
+// Fast connect: the AP and channel of the last successful connection. Connecting
+// straight to them skips the all-channel scan. The address still comes from
+// DHCP, so the router always knows it is in use; a stack built with
+// CONFIG_LWIP_DHCP_RESTORE_LAST_IP asks for the previous address directly
+// (INIT-REBOOT) instead of starting with a discover.
+static const char* NVS_KEY_WIFI_CACHE = "wifi_cache";
+
+struct WifiCache {
+  char ssid[33];      // cache only applies to this network
+  uint8_t bssid[6];
+  uint8_t channel;
+};
+
+static WifiCache wifiCache;
+static bool wifiFast = false;          // first connection used the fast path
+static uint32_t wifiFirstConnectMs = 0;
+
 // Colors (matching main.cpp)
 #define COLOR_BG       0x0000
 #define COLOR_TEXT     0xFFFF
@@ -120,6 +139,89 @@ static void drawWiFiFailedScreen(Arduino_GFX *gfx) {
   gfx->print("Re-entering setup mode...");
 }
 
+static bool wifiCacheLoad(WifiCache &c) {
+  prefs.begin(NVS_NAMESPACE, true);
+  bool ok = prefs.getBytesLength(NVS_KEY_WIFI_CACHE) == sizeof(WifiCache) &&
+            prefs.getBytes(NVS_KEY_WIFI_CACHE, &c, sizeof(WifiCache)) == sizeof(WifiCache);
+  prefs.end();
+  return ok;
+}
+
+static void wifiCacheSave(const WifiCache &c) {
+  prefs.begin(NVS_NAMESPACE, false);
+  prefs.putBytes(NVS_KEY_WIFI_CACHE, &c, sizeof(WifiCache));
+  prefs.end();
+}
+
+static void wifiCacheClear() {
+  memset(&wifiCache, 0, sizeof(wifiCache));
+  prefs.begin(NVS_NAMESPACE, false);
+  if (prefs.isKey(NVS_KEY_WIFI_CACHE)) prefs.remove(NVS_KEY_WIFI_CACHE);
+  prefs.end();
+}
+
+// SSID/password WiFiManager (or the last WiFi.begin) stored in the WiFi driver's NVS.
+static bool storedCredentials(wifi_config_t &conf) {
+  memset(&conf, 0, sizeof(conf));
+  return esp_wifi_get_config(WIFI_IF_STA, &conf) == ESP_OK && conf.sta.ssid[0] != 0;
+}
+
+// Full connect to the stored network: any AP, any channel, DHCP.
+static void wifiBeginStored() {
+  wifi_config_t conf;
+  if (storedCredentials(conf)) {
+    WiFi.begin((const char*)conf.sta.ssid, (const char*)conf.sta.password);
+  } else {
+    WiFi.begin(); // nothing stored: no-op until the portal saves a network
+  }
+}
+
+// Start a connection straight to the cached AP/channel. Returns false if there is
+// no usable cache for the stored network.
+static bool wifiBeginFast() {
+  wifi_config_t conf;
+  if (!storedCredentials(conf) || !wifiCacheLoad(wifiCache) || wifiCache.channel == 0 ||
+      strncmp(wifiCache.ssid, (const char*)conf.sta.ssid, sizeof(wifiCache.ssid)) != 0) {
+    return false;
+  }
+
+  LOGI(LOG_WIFI, "Fast connect: %02X:%02X:%02X:%02X:%02X:%02X ch %u", wifiCache.bssid[0],
+                wifiCache.bssid[1], wifiCache.bssid[2], wifiCache.bssid[3], wifiCache.bssid[4],
+                wifiCache.bssid[5], wifiCache.channel);
+  // Not persisted: the stored config must stay "any AP" for the full scan.
+  WiFi.persistent(false);
+  WiFi.begin((const char*)conf.sta.ssid, (const char*)conf.sta.password, wifiCache.channel,
+             wifiCache.bssid);
+  WiFi.persistent(true);
+  return true;
+}
+
+static bool waitForWiFi(unsigned long timeoutMs) {
+  unsigned long start = millis();
+  while (WiFi.status() != WL_CONNECTED && millis() - start < timeoutMs) delay(50);
+  return WiFi.status() == WL_CONNECTED;
+}
+
+void wifiReconnect() { wifiBeginStored(); }
+
+void wifiOnConnected() {
+  if (wifiFirstConnectMs == 0) wifiFirstConnectMs = millis();
+
+  WifiCache c;
+  memset(&c, 0, sizeof(c));
+  snprintf(c.ssid, sizeof(c.ssid), "%s", WiFi.SSID().c_str());
+  memcpy(c.bssid, WiFi.BSSID(), sizeof(c.bssid));
+  c.channel = WiFi.channel();
+  if (memcmp(&c, &wifiCache, sizeof(c)) != 0) {
+    wifiCache = c;
+    wifiCacheSave(wifiCache);
+  }
+}
+
+uint32_t wifiConnectMs() { return wifiFirstConnectMs; }
+
+bool wifiFastConnected() { return wifiFast; }
+
 String getAccountId() {
   prefs.begin(NVS_NAMESPACE, true); // read-only
   String id = prefs.getString(NVS_KEY_ACCOUNT, "");
@@ -128,111 +230,186 @@ String getAccountId() {
 }
 
 void resetProvisioning() {
-  Serial.println("Factory reset: erasing WiFi + account ID");
+  LOGW(LOG_WIFI, "Factory reset: erasing WiFi + account ID");
   prefs.begin(NVS_NAMESPACE, false);
   prefs.clear();
   prefs.end();
 
-  // Also clear WiFiManager stored creds
+  // Also clear WiFiManager stored creds (the fast-connect cache went with prefs)
+  memset(&wifiCache, 0, sizeof(wifiCache));
   WiFi.disconnect(true, true); // disconnect + erase
   delay(100);
 }
 
-bool startCaptivePortal(Arduino_GFX *gfx) {
+// Portal state. The portal runs alongside loop(): WiFiManager is driven in
+// non-blocking mode from portalLoop(), so measurement, backlog and reconnect
+// logic keep running while the AP is up.
+static WiFiManager wm;
+static enum { PORTAL_CLOSED, PORTAL_SCANNING, PORTAL_OPEN } portalState = PORTAL_CLOSED;
+static char portalApName[32];
+static bool portalRetryStored = false;
+static unsigned long portalSince = 0;
+static unsigned long portalLastStaRetry = 0;
+static Arduino_GFX *portalGfx = nullptr;
+
+void portalStart(Arduino_GFX *gfx, bool retryStored) {
+  if (portalState != PORTAL_CLOSED) return;
+
   // Generate AP name from MAC
   uint8_t mac[6];
   WiFi.macAddress(mac);
-  char apName[32];
-  snprintf(apName, sizeof(apName), "%s%02X%02X", AP_NAME_PREFIX, mac[4], mac[5]);
-
-  Serial.printf("Starting captive portal: %s\n", apName);
+  snprintf(portalApName, sizeof(portalApName), "%s%02X%02X", AP_NAME_PREFIX, mac[4], mac[5]);
+  LOGI(LOG_WIFI, "Starting captive portal: %s", portalApName);
 
   // IMPORTANT: do NOT erase stored WiFi credentials here. Wiping creds before we
   // have working new ones is what previously stranded the device when the portal
   // timed out. startConfigPortal() opens the AP WITHOUT clearing NVS and only
   // overwrites the saved network if the user submits new creds that connect.
 
-  // Pre-scan networks for iOS/Android captive portal detection
-  Serial.println("Pre-scanning WiFi networks...");
+  // Pre-scan networks for iOS/Android captive portal detection. The AP opens
+  // from portalLoop() once the scan finishes (or after 3s).
+  // A user-requested portal must not let the stored network (possibly already
+  // joined by the early boot connect) close it again.
+  if (!retryStored) WiFi.disconnect();
+
+  LOGI(LOG_WIFI, "Pre-scanning WiFi networks...");
   WiFi.mode(WIFI_STA);
   WiFi.scanNetworks(true); // async scan
-  delay(3000); // Wait for scan to complete (critical for iOS)
-  WiFi.scanDelete();
 
-  // Draw provisioning screen
-  if (gfx) {
-    drawProvisioningScreen(gfx, apName);
-  }
+  portalGfx = gfx;
+  portalRetryStored = retryStored;
+  portalSince = millis();
+  portalLastStaRetry = portalSince;
+  portalState = PORTAL_SCANNING;
+}
 
-  WiFiManager wm;
-  wm.setConfigPortalTimeout(PORTAL_TIMEOUT);
-  wm.setConnectTimeout(20);
+bool portalActive() { return portalState != PORTAL_CLOSED; }
 
-  // Open the setup portal. Returns true only if the user entered credentials
-  // that successfully connected (WiFiManager persists them on success).
-  bool connected = wm.startConfigPortal(apName);
+void portalStop() {
+  if (portalState == PORTAL_CLOSED) return;
+  if (wm.getConfigPortalActive()) wm.stopConfigPortal();
+  WiFi.scanDelete();
+  WiFi.mode(WIFI_STA);
+  portalState = PORTAL_CLOSED;
+  LOGI(LOG_WIFI, "Setup portal closed");
+}
 
-  if (connected) {
-    Serial.println("WiFi connected via portal!");
+bool portalLoop(unsigned long now) {
+  if (portalState == PORTAL_SCANNING) {
+    // Wait for scan to complete (critical for iOS)
+    if (WiFi.scanComplete() == WIFI_SCAN_RUNNING && now - portalSince < 3000) return true;
+    WiFi.scanDelete();
+
+    if (portalGfx) {
+      drawProvisioningScreen(portalGfx, portalApName);
+    }
+    wm.setConfigPortalBlocking(false);
+    wm.setConfigPortalTimeout(PORTAL_TIMEOUT);  // counts from the last phone on the AP
+    wm.setConnectTimeout(20);
+    wm.startConfigPortal(portalApName);
+    portalState = PORTAL_OPEN;
     return true;
   }
 
-  // Portal timed out or was cancelled. Any previously stored credentials are
-  // still intact — fall back to them so a transient setup attempt never leaves
-  // the device with no network.
-  Serial.println("Portal timed out; falling back to stored credentials...");
-  if (gfx) {
-    drawConnectingScreen(gfx, WiFi.SSID().c_str(), 1, 0);
+  // Serves DNS/HTTP. Returns true once the user's new creds have connected
+  // (WiFiManager persists them on success); the caller sees WL_CONNECTED.
+  if (wm.process()) {
+    LOGI(LOG_WIFI, "WiFi connected via portal!");
   }
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(); // uses stored creds, if any
-  unsigned long start = millis();
-  while (WiFi.status() != WL_CONNECTED && millis() - start < 15000) {
-    delay(500);
-    Serial.print(".");
+
+  if (!wm.getConfigPortalActive()) {
+    // Timed out with nobody on it (or closed after a successful save). Any
+    // previously stored credentials are still intact — loop() keeps retrying
+    // them on STA.
+    if (WiFi.status() != WL_CONNECTED) {
+      LOGI(LOG_WIFI, "Portal timed out; falling back to stored credentials...");
+      WiFi.mode(WIFI_STA);
+      wifiBeginStored(); // uses stored creds, if any
+    }
+    portalState = PORTAL_CLOSED;
+    return false;
   }
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.printf("\nReconnected to stored WiFi: %s\n", WiFi.SSID().c_str());
-    return true;
+
+  // Outage case: keep trying the stored network so the portal closes the moment
+  // it returns. A STA attempt makes the radio leave the AP's channel, so only
+  // try while no phone is connected to the portal.
+  if (portalRetryStored && now - portalLastStaRetry >= PORTAL_STA_RETRY_MS &&
+      WiFi.softAPgetStationNum() == 0) {
+    portalLastStaRetry = now;
+    LOGI(LOG_WIFI, "Portal open; retrying stored WiFi...");
+    wifiBeginStored();
   }
-  Serial.println("\nNo working credentials after portal.");
-  return false;
+  return true;
 }
 
-bool provisioningInit(Arduino_GFX *gfx) {
+static bool wifiBegun = false;
+static bool wifiTryingFast = false;
+static unsigned long wifiBeginMs = 0;
+
+void provisioningBegin() {
+  if (wifiBegun) return;
+  wifiBegun = true;
   WiFi.mode(WIFI_STA);
-  delay(100);
+  WiFi.onEvent([](arduino_event_id_t, arduino_event_info_t) {
+    if (wifiFirstConnectMs == 0) wifiFirstConnectMs = millis();
+  }, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+
+  // Always attempt to reconnect with persisted credentials first: the SSID and
+  // password saved in NVS by the last successful connection — this is what lets
+  // the device come back automatically after a reboot or power-cycle.
+  // (Previously we gated on WiFi.SSID(), but that returns empty on a cold boot
+  // even when valid creds are stored, so the device opened the portal on EVERY
+  // reboot instead of reconnecting.) Try the cached AP and channel first (no
+  // scan; DHCP as usual); provisioningInit() falls back to a full scan if that
+  // AP is gone.
+  wifiTryingFast = wifiBeginFast();
+  if (!wifiTryingFast) {
+    LOGI(LOG_WIFI, "Trying stored WiFi credentials...");
+    wifiBeginStored();
+  }
+  wifiBeginMs = millis();
+}
 
-  // Always attempt to reconnect with persisted credentials first. WiFi.begin()
-  // with no args uses the SSID/password saved in NVS by the last successful
-  // connection — this is what lets the device come back automatically after a
-  // reboot or power-cycle. (Previously we gated on WiFi.SSID(), but that returns
-  // empty on a cold boot even when valid creds are stored, so the device opened
-  // the portal on EVERY reboot instead of reconnecting.)
-  Serial.println("Trying stored WiFi credentials...");
-  WiFi.begin();
-  if (gfx) {
+// Wait what is left of timeoutMs since wifiBeginMs.
+static bool waitForWiFiSinceBegin(unsigned long timeoutMs) {
+  unsigned long spent = millis() - wifiBeginMs;
+  return waitForWiFi(spent < timeoutMs ? timeoutMs - spent : 0);
+}
+
+bool provisioningInit(Arduino_GFX *gfx) {
+  provisioningBegin();
+  if (gfx && WiFi.status() != WL_CONNECTED) {
     drawConnectingScreen(gfx, WiFi.SSID().c_str(), 1, 0);
   }
 
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 30) {  // up to ~15s
-    delay(500);
-    Serial.print(".");
-    attempts++;
+  if (wifiTryingFast) {
+    wifiTryingFast = false;
+    if (waitForWiFiSinceBegin(WIFI_FAST_TIMEOUT_MS)) {
+      wifiFast = true;
+    } else {
+      LOGI(LOG_WIFI, "Fast connect failed; scanning...");
+      wifiCacheClear();
+      WiFi.disconnect();
+      LOGI(LOG_WIFI, "Trying stored WiFi credentials...");
+      wifiBeginStored();
+      wifiBeginMs = millis();
+    }
   }
 
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.printf("\nWiFi connected! IP: %s\n", WiFi.localIP().toString().c_str());
+  if (wifiFast || waitForWiFiSinceBegin(15000)) {
+    wifiOnConnected();
+    LOGI(LOG_WIFI, "WiFi connected at %lu ms%s! IP: %s", (unsigned long)wifiFirstConnectMs,
+                  wifiFast ? " (fast)" : "", WiFi.localIP().toString().c_str());
     return true;
   }
 
-  Serial.println("\nNo working stored credentials — starting captive portal...");
+  LOGI(LOG_WIFI, "No working stored credentials — starting captive portal...");
   if (gfx) {
     drawWiFiFailedScreen(gfx);
     delay(1500);
   }
-  return startCaptivePortal(gfx);
+  portalStart(gfx, true);
+  return false;
 }
 
 // Returns true if the user did a short tap at boot to request a WiFi change
@@ -271,7 +448,7 @@ bool checkTouchAction(Arduino_GFX *gfx) {
     if (Wire.available()) {
       touchCount = Wire.read();
       int intPin = digitalRead(PIN_TOUCH_INT);
-      Serial.printf("Touch poll %d: count=%d INT=%d\n", i, touchCount, intPin);
+      LOGD(LOG_SYS, "Touch poll %d: count=%d INT=%d", i, touchCount, intPin);
       // FT3168 INT goes LOW on touch
       if (touchCount > 0 || intPin == LOW) {
         touchCount = touchCount > 0 ? touchCount : 1;
@@ -287,7 +464,7 @@ bool checkTouchAction(Arduino_GFX *gfx) {
   }
 
   if (touchCount > 0) {
-      Serial.println("Touch detected at boot: hold 5s = factory reset, release = change WiFi");
+      LOGI(LOG_SYS, "Touch detected at boot: hold 5s = factory reset, release = change WiFi");
 
       if (gfx) {
         gfx->fillScreen(COLOR_BG);
@@ -338,7 +515,7 @@ bool checkTouchAction(Arduino_GFX *gfx) {
       }
 
       if (held) {
-        Serial.println("Factory reset triggered!");
+        LOGW(LOG_SYS, "Factory reset triggered!");
         if (gfx) {
           gfx->fillScreen(COLOR_BG);
           gfx->setTextSize(2);
@@ -351,12 +528,13 @@ bool checkTouchAction(Arduino_GFX *gfx) {
           gfx->print("Restarting...");
         }
         resetProvisioning();
+        logFlush();
         delay(1500);
         ESP.restart();
         return false; // won't reach here (device restarts)
       }
 
-      Serial.println("Touch released before 5s - entering WiFi change mode");
+      LOGI(LOG_SYS, "Touch released before 5s - entering WiFi change mode");
       return true; // request the WiFi setup portal (Account ID preserved)
   }
 
@@ -11,12 +11,46 @@ enum DisplayState {
   DISPLAY_WIFI_FAILED,
 };
 
+// Start connecting to the stored network (fast path if cached) without waiting,
+// so association and DHCP overlap the rest of setup(). Optional: provisioningInit()
+// calls it if it has not run.
+void provisioningBegin();
+
 // Initialize WiFi provisioning — replaces initWiFi()
-// Returns true if WiFi connected, false if portal is running
+// Waits for the connection provisioningBegin() started (falling back to a full
+// scan if the fast path fails). Returns true if WiFi connected, false if portal
+// is running
 bool provisioningInit(Arduino_GFX *gfx);
 
-// Start captive portal for WiFi setup
-bool startCaptivePortal(Arduino_GFX *gfx);
+// Retry the stored network from scratch (full scan, DHCP). Use instead of
+// WiFi.reconnect(), which would stay pinned to the fast-connect AP.
+void wifiReconnect();
+
+// Call on every WiFi (re)connect: refreshes the fast-connect cache (AP and
+// channel) in NVS if it changed.
+void wifiOnConnected();
+
+// Boot-to-WiFi time of the first connection (ms since boot, 0 until connected)
+// and whether it used the fast-connect cache.
+uint32_t wifiConnectMs();
+bool wifiFastConnected();
+
+// Open the captive setup portal without blocking; it draws its own screen and is
+// serviced by portalLoop(). retryStored keeps retrying the stored network in the
+// background (outage case) so that network coming back connects as usual; pass
+// false when the user asked to change WiFi. Stored creds are never erased.
+void portalStart(Arduino_GFX *gfx, bool retryStored);
+
+// True from portalStart() until the portal closes.
+bool portalActive();
+
+// Service the portal. Call from loop() while WiFi is down. Returns false once the
+// portal has closed by itself (timeout), after which STA falls back to stored creds.
+bool portalLoop(unsigned long now);
+
+// Close the portal. Call as soon as WiFi is connected (new creds or the stored
+// network came back).
+void portalStop();
 
 // Get the account ID from NVS (empty string if not set)
 String getAccountId();
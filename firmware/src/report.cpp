@@ -0,0 +1,84 @@
+#include <Arduino.h>
+
+#include "config.h"
+#include "report.h"
+#include "telemetry.h"
+
+static ReportParams s_params = {REPORT_DEADBAND_DB, REPORT_SLOPE_DB_PER_S, REPORT_HOLD_MS, REPORT_HEARTBEAT_MS};
+
+// Recent readings for the slope, oldest first once full.
+static struct {
+  uint32_t ms;
+  int16_t db10;
+} s_hist[REPORT_SLOPE_READINGS + 1];
+static size_t s_histCount = 0;
+
+static bool s_sentAny = false;
+static int16_t s_sentDb10 = 0;
+static float s_sentSlope = 0;
+static uint32_t s_sentMs = 0;
+static uint32_t s_holdUntil = 0;
+static LevelPercentiles s_sentPct[LEVELSTATS_WINDOWS];
+static size_t s_sentPctCount = 0;
+
+const ReportParams &reportParams() { return s_params; }
+
+void reportSetParams(const ReportParams &p) { s_params = p; }
+
+void reportReset() {
+  s_sentAny = false;
+  s_histCount = 0;
+}
+
+// dB/s across the history, 0 until it is full.
+static float slope() {
+  if (s_histCount < REPORT_SLOPE_READINGS + 1) return 0;
+  uint32_t dt = s_hist[REPORT_SLOPE_READINGS].ms - s_hist[0].ms;
+  return dt ? (s_hist[REPORT_SLOPE_READINGS].db10 - s_hist[0].db10) * 100.0f / dt : 0;
+}
+
+static bool percentilesMoved(const LevelPercentiles *pct, size_t n, int deadband10) {
+  if (n != s_sentPctCount) return true;
+  for (size_t i = 0; i < n; i++) {
+    const LevelPercentiles &a = pct[i], &b = s_sentPct[i];
+    if (a.windowS != b.windowS || abs(a.l10 - b.l10) >= deadband10 || abs(a.l50 - b.l50) >= deadband10 ||
+        abs(a.l90 - b.l90) >= deadband10) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool reportDue(uint32_t ms, float dbFS, const LevelPercentiles *pct, size_t pctCount) {
+  // Compare in the tenths the server receives.
+  int16_t db10 = telemetryDb10(dbFS);
+  if (s_histCount == REPORT_SLOPE_READINGS + 1) {
+    memmove(s_hist, s_hist + 1, REPORT_SLOPE_READINGS * sizeof(s_hist[0]));
+    s_histCount--;
+  }
+  s_hist[s_histCount].ms = ms;
+  s_hist[s_histCount].db10 = db10;
+  s_histCount++;
+  float s = slope();
+
+  bool send;
+  if (s_params.deadbandDb <= 0 || !s_sentAny) {
+    send = true;
+  } else {
+    int deadband10 = (int)lroundf(s_params.deadbandDb * 10.0f);
+    bool changed = abs(db10 - s_sentDb10) >= deadband10 ||
+                   (s_params.slopeDbPerS > 0 && fabsf(s - s_sentSlope) >= s_params.slopeDbPerS) ||
+                   percentilesMoved(pct, pctCount, deadband10);
+    if (changed) s_holdUntil = ms + s_params.holdMs;
+    send = changed || (int32_t)(s_holdUntil - ms) > 0 || ms - s_sentMs >= s_params.heartbeatMs;
+  }
+  if (!send) return false;
+
+  s_sentAny = true;
+  s_sentDb10 = db10;
+  s_sentSlope = s;
+  s_sentMs = ms;
+  s_sentPctCount = pctCount;
+  memcpy(s_sentPct, pct, pctCount * sizeof(LevelPercentiles));
+  return true;
+}
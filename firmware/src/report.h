@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "levelstats.h"
+
+// Send-on-delta reporting: which of the readings loop() takes every
+// DB_SEND_INTERVAL go to the server. A steady room sends only a heartbeat; a
+// change is reported with the reading that shows it (no added latency), and
+// every reading is sent for a hold period after it, so the server's smoothing
+// and sustain counts see the change at full rate. Loop() only.
+//
+// A reading is sent when any of these holds:
+//   - it is the first since reportReset() (each connect)
+//   - the level moved deadbandDb from the last reading sent
+//   - the level's slope (dB/s over REPORT_SLOPE_READINGS readings) differs from
+//     the slope at the last reading sent by slopeDbPerS (a ramp starts or ends)
+//   - an L10/L50/L90 moved deadbandDb from the values last sent
+//   - a change above was seen in the last holdMs
+//   - heartbeatMs passed without a send
+// deadbandDb <= 0 turns the gate off: every reading is sent, as before.
+
+struct ReportParams {
+  float deadbandDb;
+  float slopeDbPerS;   // <= 0: slope changes alone never trigger
+  uint32_t holdMs;
+  uint32_t heartbeatMs;
+};
+
+// The config.h defaults until the server sends its own.
+const ReportParams &reportParams();
+void reportSetParams(const ReportParams &p);
+
+// Forget what was sent (after a (re)connect); the next reading goes out.
+void reportReset();
+
+// Whether the reading taken at `ms` goes out. pct holds pctCount windows'
+// current percentiles. Records it as sent when true.
+bool reportDue(uint32_t ms, float dbFS, const LevelPercentiles *pct, size_t pctCount);
@@ -0,0 +1,131 @@
+#include <Arduino.h>
+
+#include "bands.h"
+#include "telemetry.h"
+
+struct Reading {
+  uint32_t ms;
+  int16_t db10;  // dBFS x 10
+};
+
+static Reading s_batch[TELEMETRY_MAX_READINGS];
+static size_t s_count = 0;
+
+static void putU16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static void putU32(uint8_t *p, uint32_t v) {
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = v >> 24;
+}
+
+void telemetryPush(uint32_t ms, float dbFS) {
+  if (s_count == TELEMETRY_MAX_READINGS) {
+    memmove(s_batch, s_batch + 1, sizeof(Reading) * (TELEMETRY_MAX_READINGS - 1));
+    s_count--;
+  }
+  s_batch[s_count++] = {ms, telemetryDb10(dbFS)};
+}
+
+int16_t telemetryDb10(float dbFS) {
+  float db10 = roundf(dbFS * 10.0f);
+  if (db10 < -32768.0f) db10 = -32768.0f;
+  if (db10 > 32767.0f) db10 = 32767.0f;
+  return (int16_t)db10;
+}
+
+size_t telemetryPending() { return s_count; }
+
+void telemetryDrain(void (*fn)(uint32_t ms, float dbFS)) {
+  for (size_t i = 0; i < s_count; i++) fn(s_batch[i].ms, s_batch[i].db10 / 10.0f);
+  s_count = 0;
+}
+
+static size_t putHeader(uint8_t *out, Weighting weighting, uint8_t count, uint32_t t0) {
+  out[0] = TELEMETRY_VERSION;
+  out[1] = count;
+  out[2] = (uint8_t)weighting;
+  out[3] = 0;
+  putU32(out + 4, t0);
+  return 8;
+}
+
+size_t telemetryEncode(uint8_t *out, size_t cap, Weighting weighting, const int8_t *bands,
+                       uint32_t overruns, const LevelPercentiles *pct, size_t pctCount) {
+  if (s_count == 0) return 0;
+  size_t need = 8 + s_count * 4 + 6 + (bands ? 2 + BANDS_COUNT : 0) + (pctCount ? 2 + pctCount * 8 : 0);
+  if (cap < need) return 0;
+
+  uint32_t t0 = s_batch[0].ms;
+  size_t len = putHeader(out, weighting, (uint8_t)s_count, t0);
+
+  for (size_t i = 0; i < s_count; i++) {
+    uint32_t dt = s_batch[i].ms - t0;
+    putU16(out + len, dt > 0xFFFF ? 0xFFFF : (uint16_t)dt);
+    putU16(out + len + 2, (uint16_t)s_batch[i].db10);
+    len += 4;
+  }
+
+  out[len++] = TELEMETRY_TAG_OVERRUNS;
+  out[len++] = 4;
+  putU32(out + len, overruns);
+  len += 4;
+
+  if (bands) {
+    out[len++] = TELEMETRY_TAG_BANDS;
+    out[len++] = BANDS_COUNT;
+    memcpy(out + len, bands, BANDS_COUNT);
+    len += BANDS_COUNT;
+  }
+
+  if (pctCount > 0) {
+    out[len++] = TELEMETRY_TAG_PERCENTILES;
+    out[len++] = (uint8_t)(pctCount * 8);
+    for (size_t i = 0; i < pctCount; i++) {
+      putU16(out + len, pct[i].windowS);
+      putU16(out + len + 2, (uint16_t)pct[i].l10);
+      putU16(out + len + 4, (uint16_t)pct[i].l50);
+      putU16(out + len + 6, (uint16_t)pct[i].l90);
+      len += 8;
+    }
+  }
+
+  s_count = 0;
+  return len;
+}
+
+size_t telemetryEncodeReplay(uint8_t *out, size_t cap, Weighting weighting, const TelemetryReading *r,
+                             size_t n, uint32_t queued, uint32_t capacity, uint32_t dropped) {
+  if (n == 0 || n > TELEMETRY_MAX_READINGS) return 0;
+  bool clock = r[0].unixSec != 0;
+  if (cap < 8 + n * 4 + (clock ? 8 : 0) + 14) return 0;
+
+  uint32_t t0 = r[0].ms;
+  size_t len = putHeader(out, weighting, (uint8_t)n, t0);
+  for (size_t i = 0; i < n; i++) {
+    uint32_t dt = r[i].ms - t0;
+    putU16(out + len, dt > 0xFFFF ? 0xFFFF : (uint16_t)dt);
+    putU16(out + len + 2, (uint16_t)r[i].db10);
+    len += 4;
+  }
+
+  if (clock) {
+    out[len++] = TELEMETRY_TAG_WALLCLOCK;
+    out[len++] = 6;
+    putU32(out + len, r[0].unixSec);
+    putU16(out + len + 4, r[0].unixMs);
+    len += 6;
+  }
+
+  out[len++] = TELEMETRY_TAG_BACKLOG;
+  out[len++] = 12;
+  putU32(out + len, queued);
+  putU32(out + len + 4, capacity);
+  putU32(out + len + 8, dropped);
+  len += 12;
+  return len;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "levelstats.h"
+#include "weighting.h"
+
+// Compact binary sound_level telemetry, negotiated in the register handshake
+// (JSON stays the fallback). One websocket binary frame carries a batch of
+// readings; the server knows the device from its socket, so no deviceId.
+//
+// Frame layout, version 1 (all integers little-endian):
+//   u8  version        TELEMETRY_VERSION
+//   u8  count          readings in this frame (1..TELEMETRY_MAX_READINGS)
+//   u8  weighting      Weighting enum applied to the levels
+//   u8  reserved       0
+//   u32 t0             device millis() of the first reading
+//   count x { u16 dt   ms since t0
+//             i16 db   dBFS x 10 }
+//   then sections to the end of the frame: { u8 tag, u8 len, len bytes }.
+//   Decoders skip unknown tags, so new fields never break older servers.
+#define TELEMETRY_VERSION      1
+#define TELEMETRY_ENCODING     "bin1"  // name used in the register handshake
+#define TELEMETRY_MAX_READINGS 16
+#define TELEMETRY_FRAME_MAX    128
+
+// Section tags.
+#define TELEMETRY_TAG_BANDS    1  // BANDS_COUNT x i8: octave-band dBFS (bands.h)
+#define TELEMETRY_TAG_OVERRUNS 2  // u32: I2S DMA overruns since boot
+#define TELEMETRY_TAG_WALLCLOCK 3  // u32 unix seconds, u16 ms: wall-clock time of t0
+#define TELEMETRY_TAG_BACKLOG  4  // u32 queued, u32 capacity, u32 dropped: replayed readings (backlog.h)
+#define TELEMETRY_TAG_PERCENTILES 5  // per window { u16 seconds, i16 L10, i16 L50, i16 L90 (dBFS x 10) } (levelstats.h)
+
+// Queue one reading for the next frame. Drops the oldest if the batch is full.
+void telemetryPush(uint32_t ms, float dbFS);
+
+// Readings waiting to be encoded.
+size_t telemetryPending();
+
+// Hand the pending readings, oldest first, to fn and clear the batch (the
+// socket dropped mid-batch: they go to the backlog instead).
+void telemetryDrain(void (*fn)(uint32_t ms, float dbFS));
+
+// Encode the pending readings into out (TELEMETRY_FRAME_MAX bytes is always
+// enough) and clear the batch. bands may be null; pct holds pctCount windows'
+// percentiles as of the last reading. Returns the frame length, or 0 if nothing
+// was pending.
+size_t telemetryEncode(uint8_t *out, size_t cap, Weighting weighting, const int8_t *bands,
+                       uint32_t overruns, const LevelPercentiles *pct, size_t pctCount);
+
+// A reading replayed from the store-and-forward backlog: device millis(), the
+// wall-clock time it was taken (unixSec 0 when the clock was unset) and dBFS x 10.
+struct TelemetryReading {
+  uint32_t ms;
+  uint32_t unixSec;
+  uint16_t unixMs;
+  int16_t db10;
+};
+
+// dBFS in the tenths every encoding reports.
+int16_t telemetryDb10(float dbFS);
+
+// Encode n replayed readings (at most TELEMETRY_MAX_READINGS, within 65 s of
+// the first) as one frame with the WALLCLOCK and BACKLOG sections; queued,
+// capacity and dropped describe the backlog after these readings. Returns the
+// frame length, or 0 if it does not fit.
+size_t telemetryEncodeReplay(uint8_t *out, size_t cap, Weighting weighting, const TelemetryReading *r,
+                             size_t n, uint32_t queued, uint32_t capacity, uint32_t dropped);
@@ -0,0 +1,263 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl.h>
+
+#include "tls.h"
+#include "logring.h"
+
+struct TlsState {
+  WiFiClient tcp;  // the transport; the WiFiClient base of TlsClient is only its type
+  mbedtls_ssl_context ssl;
+  mbedtls_ssl_config conf;
+  mbedtls_ctr_drbg_context drbg;
+  mbedtls_entropy_context entropy;
+};
+
+static struct {
+  char host[64];
+  uint16_t port;
+  bool valid;
+  mbedtls_ssl_session session;
+} s_cache[TLS_SESSION_CACHE_SLOTS];
+static size_t s_nextSlot = 0;
+static bool s_cacheInit = false;
+static TlsStats s_stats = {};
+
+const TlsStats &tlsStats() { return s_stats; }
+
+void tlsNoteWebsocketConnect(uint32_t ms) {
+  s_stats.wsConnects++;
+  s_stats.wsMs += ms;
+  LOGI(LOG_TLS, "websocket connect blocked %lu ms", (unsigned long)ms);
+}
+
+static void cacheInit() {
+  if (s_cacheInit) return;
+  for (auto &e : s_cache) {
+    e.valid = false;
+    mbedtls_ssl_session_init(&e.session);
+  }
+  s_cacheInit = true;
+}
+
+static int cacheFind(const char *host, uint16_t port) {
+  cacheInit();
+  for (size_t i = 0; i < TLS_SESSION_CACHE_SLOTS; i++) {
+    if (s_cache[i].valid && s_cache[i].port == port && strcmp(s_cache[i].host, host) == 0) return (int)i;
+  }
+  return -1;
+}
+
+static void cacheDrop(int i) {
+  if (i < 0) return;
+  mbedtls_ssl_session_free(&s_cache[i].session);
+  mbedtls_ssl_session_init(&s_cache[i].session);
+  s_cache[i].valid = false;
+}
+
+// Keep the connection's session for the next connect to host:port.
+static void cacheStore(const char *host, uint16_t port, mbedtls_ssl_context *ssl) {
+  int i = cacheFind(host, port);
+  if (i < 0) {
+    i = (int)s_nextSlot;
+    s_nextSlot = (s_nextSlot + 1) % TLS_SESSION_CACHE_SLOTS;
+  }
+  cacheDrop(i);
+  if (mbedtls_ssl_get_session(ssl, &s_cache[i].session) != 0) return;
+  snprintf(s_cache[i].host, sizeof(s_cache[i].host), "%s", host);
+  s_cache[i].port = port;
+  s_cache[i].valid = true;
+}
+
+void tlsClearSessions() {
+  cacheInit();
+  for (size_t i = 0; i < TLS_SESSION_CACHE_SLOTS; i++) cacheDrop((int)i);
+}
+
+// --- Transport: TLS records over a plain TCP client ---
+
+int TlsClient::bioSend(void *ctx, const unsigned char *buf, size_t len) {
+  WiFiClient *tcp = (WiFiClient *)ctx;
+  size_t n = tcp->write(buf, len);
+  if (n > 0) return (int)n;
+  return tcp->connected() ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_CONN_RESET;
+}
+
+int TlsClient::bioRecv(void *ctx, unsigned char *buf, size_t len) {
+  WiFiClient *tcp = (WiFiClient *)ctx;
+  int avail = tcp->available();
+  if (avail <= 0) return tcp->connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+  int n = tcp->read(buf, len < (size_t)avail ? len : (size_t)avail);
+  return n > 0 ? n : MBEDTLS_ERR_SSL_WANT_READ;
+}
+
+TlsClient::~TlsClient() { stop(); }
+
+int TlsClient::connect(IPAddress ip, uint16_t port) { return connect(ip, port, TLS_IO_TIMEOUT_MS); }
+
+int TlsClient::connect(IPAddress ip, uint16_t port, int32_t timeoutMs) {
+  return connect(ip.toString().c_str(), port, timeoutMs);
+}
+
+int TlsClient::connect(const char *host, uint16_t port) { return connect(host, port, TLS_IO_TIMEOUT_MS); }
+
+int TlsClient::connect(const char *host, uint16_t port, int32_t timeoutMs) {
+  stop();
+  _s = new TlsState;
+  _closed = false;
+  _resumed = false;
+  mbedtls_ssl_init(&_s->ssl);
+  mbedtls_ssl_config_init(&_s->conf);
+  mbedtls_ctr_drbg_init(&_s->drbg);
+  mbedtls_entropy_init(&_s->entropy);
+  if (!_s->tcp.connect(host, port, timeoutMs) || !handshake(host, port, timeoutMs)) {
+    stop();
+    return 0;
+  }
+  return 1;
+}
+
+bool TlsClient::handshake(const char *host, uint16_t port, int32_t timeoutMs) {
+  unsigned long t0 = millis();
+  int ret = mbedtls_ctr_drbg_seed(&_s->drbg, mbedtls_entropy_func, &_s->entropy, nullptr, 0);
+  if (ret == 0) {
+    ret = mbedtls_ssl_config_defaults(&_s->conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                      MBEDTLS_SSL_PRESET_DEFAULT);
+  }
+  if (ret == 0) {
+    mbedtls_ssl_conf_authmode(&_s->conf, MBEDTLS_SSL_VERIFY_NONE);
+    mbedtls_ssl_conf_rng(&_s->conf, mbedtls_ctr_drbg_random, &_s->drbg);
+    mbedtls_ssl_conf_max_tls_version(&_s->conf, MBEDTLS_SSL_VERSION_TLS1_2);
+    mbedtls_ssl_conf_session_tickets(&_s->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    ret = mbedtls_ssl_setup(&_s->ssl, &_s->conf);
+  }
+  if (ret == 0) ret = mbedtls_ssl_set_hostname(&_s->ssl, host);
+  if (ret != 0) {
+    LOGE(LOG_TLS, "setup failed: -0x%04x", -ret);
+    s_stats.failed++;
+    return false;
+  }
+  mbedtls_ssl_set_bio(&_s->ssl, &_s->tcp, bioSend, bioRecv, nullptr);
+
+  int slot = cacheFind(host, port);
+  bool offered = slot >= 0 && mbedtls_ssl_set_session(&_s->ssl, &s_cache[slot].session) == 0;
+
+  // Step the handshake so we can see whether the server sent its certificate:
+  // a resumed TLS 1.2 handshake goes from ServerHello straight to
+  // ChangeCipherSpec (or NewSessionTicket).
+  bool sawCertificate = false;
+  while (!mbedtls_ssl_is_handshake_over(&_s->ssl)) {
+    ret = mbedtls_ssl_handshake_step(&_s->ssl);
+    if (_s->ssl.MBEDTLS_PRIVATE(state) == MBEDTLS_SSL_SERVER_CERTIFICATE) sawCertificate = true;
+    if (ret == 0) continue;
+    if ((ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) &&
+        (int32_t)(millis() - t0) < timeoutMs) {
+      delay(1);
+      continue;
+    }
+    LOGW(LOG_TLS, "%s: handshake failed: -0x%04x", host, -ret);
+    s_stats.failed++;
+    if (offered) cacheDrop(slot);  // don't offer a session that broke the handshake again
+    return false;
+  }
+
+  uint32_t ms = millis() - t0;
+  _resumed = offered && !sawCertificate;
+  if (_resumed) {
+    s_stats.resumed++;
+    s_stats.resumedMs += ms;
+  } else {
+    s_stats.full++;
+    s_stats.fullMs += ms;
+  }
+  LOGI(LOG_TLS, "%s: %s handshake in %lu ms", host, _resumed ? "resumed" : "full", (unsigned long)ms);
+  cacheStore(host, port, &_s->ssl);
+  return true;
+}
+
+// --- Application data ---
+
+size_t TlsClient::write(uint8_t b) { return write(&b, 1); }
+
+size_t TlsClient::write(const uint8_t *buf, size_t size) {
+  if (!_s || _closed) return 0;
+  size_t done = 0;
+  unsigned long t0 = millis();
+  while (done < size) {
+    int ret = mbedtls_ssl_write(&_s->ssl, buf + done, size - done);
+    if (ret > 0) {
+      done += ret;
+    } else if ((ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) &&
+               millis() - t0 < TLS_IO_TIMEOUT_MS) {
+      delay(1);
+    } else {
+      _closed = true;
+      break;
+    }
+  }
+  return done;
+}
+
+int TlsClient::available() {
+  if (!_s) return 0;
+  int n = (int)mbedtls_ssl_get_bytes_avail(&_s->ssl);
+  if (n == 0 && !_closed) {
+    int ret = mbedtls_ssl_read(&_s->ssl, nullptr, 0);  // decrypt a pending record, if any
+    if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) _closed = true;
+    n = (int)mbedtls_ssl_get_bytes_avail(&_s->ssl);
+  }
+  return n + (_peek >= 0 ? 1 : 0);
+}
+
+int TlsClient::read() {
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsClient::read(uint8_t *buf, size_t size) {
+  if (!_s || size == 0) return -1;
+  size_t off = 0;
+  if (_peek >= 0) {
+    buf[off++] = (uint8_t)_peek;
+    _peek = -1;
+    if (off == size) return (int)off;
+  }
+  if (_closed) return off > 0 ? (int)off : -1;
+  int ret = mbedtls_ssl_read(&_s->ssl, buf + off, size - off);
+  if (ret > 0) return (int)(off + ret);
+  if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) _closed = true;  // EOF, close_notify, error
+  return off > 0 ? (int)off : -1;
+}
+
+int TlsClient::peek() {
+  if (_peek < 0) {
+    uint8_t b;
+    if (available() > 0 && read(&b, 1) == 1) _peek = b;
+  }
+  return _peek;
+}
+
+void TlsClient::flush() {}  // writes go out synchronously
+
+void TlsClient::stop() {
+  if (_s) {
+    if (!_closed) mbedtls_ssl_close_notify(&_s->ssl);
+    mbedtls_ssl_free(&_s->ssl);
+    mbedtls_ssl_config_free(&_s->conf);
+    mbedtls_ctr_drbg_free(&_s->drbg);
+    mbedtls_entropy_free(&_s->entropy);
+    _s->tcp.stop();
+    delete _s;
+    _s = nullptr;
+  }
+  _peek = -1;
+}
+
+uint8_t TlsClient::connected() {
+  if (!_s) return 0;
+  if (available() > 0) return 1;
+  return !_closed && _s->tcp.connected();
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+// TLS client with a shared session cache, for the OTA manifest check and image
+// downloads (HTTPClient takes it like any WiFiClient). The first connection to a
+// host does a full handshake; later ones offer the cached session (ticket or
+// session ID) and, when the server accepts it, skip the certificate exchange and
+// the asymmetric crypto — a fraction of the CPU time and heap.
+//
+// Like WiFiClientSecure::setInsecure(), the server certificate is not verified:
+// OTA integrity comes from the manifest sha256. TLS 1.2 only (resumption there
+// works with every server we talk to). loop() context only, plus the boot-time
+// websocket connect that setup() joins before loop() starts.
+//
+// The websocket (wsclient.h) connects through TlsClient as well, so its
+// reconnects resume too; its handshakes count in full/resumed like the OTA
+// ones, and the whole connect (TCP + TLS + upgrade) in wsConnects/wsMs.
+
+#define TLS_SESSION_CACHE_SLOTS 4   // hosts remembered (round-robin replacement)
+#define TLS_IO_TIMEOUT_MS       8000
+
+struct TlsStats {
+  uint32_t full;        // full handshakes (no cached session, or the server refused it)
+  uint32_t resumed;     // abbreviated handshakes from the cache
+  uint32_t failed;      // handshakes that did not complete
+  uint32_t fullMs;      // total handshake time of each kind
+  uint32_t resumedMs;
+  uint32_t wsConnects;  // websocket connects (their handshakes are in full/resumed too)
+  uint32_t wsMs;        // total main-loop time those connects blocked (TCP + TLS + upgrade)
+};
+
+const TlsStats &tlsStats();
+
+// Record a websocket connect that blocked loop() for `ms` in total.
+void tlsNoteWebsocketConnect(uint32_t ms);
+
+// Forget every cached session (e.g. after a server certificate change).
+void tlsClearSessions();
+
+struct TlsState;  // allocated per connection
+
+class TlsClient : public WiFiClient {
+public:
+  TlsClient() {}
+  ~TlsClient();
+
+  int connect(IPAddress ip, uint16_t port);
+  int connect(IPAddress ip, uint16_t port, int32_t timeoutMs);
+  int connect(const char *host, uint16_t port);
+  int connect(const char *host, uint16_t port, int32_t timeoutMs);
+  size_t write(uint8_t b);
+  size_t write(const uint8_t *buf, size_t size);
+  int available();
+  int read();
+  int read(uint8_t *buf, size_t size);
+  int peek();
+  void flush();
+  void stop();
+  uint8_t connected();
+
+  // The last connect() resumed a cached session.
+  bool resumed() const { return _resumed; }
+
+private:
+  static int bioSend(void *ctx, const unsigned char *buf, size_t len);
+  static int bioRecv(void *ctx, unsigned char *buf, size_t len);
+  bool handshake(const char *host, uint16_t port, int32_t timeoutMs);
+
+  TlsState *_s = nullptr;  // TCP transport + mbedTLS contexts while connected
+  int _peek = -1;
+  bool _closed = false;
+  bool _resumed = false;
+};
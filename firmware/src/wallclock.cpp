@@ -0,0 +1,95 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include <esp_sntp.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "pins.h"
+#include "config.h"
+#include "wallclock.h"
+#include "logring.h"
+
+// PCF85063 registers: time/date as BCD from REG_SECONDS, in this order.
+#define REG_SECONDS 0x04  // bit 7 (OS): oscillator stopped, time invalid
+#define RTC_VALID_AFTER 1704067200UL  // 2024-01-01: anything earlier was never set
+
+static volatile bool s_ntpSynced = false;  // set in the SNTP task, handled in loop()
+
+static uint8_t bcd2bin(uint8_t v) { return (v >> 4) * 10 + (v & 0x0F); }
+static uint8_t bin2bcd(uint8_t v) { return ((v / 10) << 4) | (v % 10); }
+
+// Days since 1970-01-01 of a proleptic Gregorian date (no timegm() in newlib).
+static int32_t daysFromCivil(int y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  int32_t era = (y >= 0 ? y : y - 399) / 400;
+  unsigned yoe = (unsigned)(y - era * 400);
+  unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int32_t)doe - 719468;
+}
+
+static bool rtcRead(time_t &out) {
+  Wire.beginTransmission(ADDR_PCF85063);
+  Wire.write(REG_SECONDS);
+  if (Wire.endTransmission(false) != 0) return false;
+  if (Wire.requestFrom((uint8_t)ADDR_PCF85063, (uint8_t)7) != 7) return false;
+  uint8_t r[7];
+  for (int i = 0; i < 7; i++) r[i] = Wire.read();
+  if (r[0] & 0x80) return false;  // oscillator stopped since it was last set
+
+  int32_t days = daysFromCivil(2000 + bcd2bin(r[6]), bcd2bin(r[5] & 0x1F), bcd2bin(r[3] & 0x3F));
+  out = (time_t)days * 86400 + bcd2bin(r[2] & 0x3F) * 3600 + bcd2bin(r[1] & 0x7F) * 60 +
+        bcd2bin(r[0] & 0x7F);
+  return out >= (time_t)RTC_VALID_AFTER;
+}
+
+static bool rtcWrite(time_t t) {
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  Wire.beginTransmission(ADDR_PCF85063);
+  Wire.write(REG_SECONDS);
+  Wire.write(bin2bcd(tm.tm_sec));  // also clears OS
+  Wire.write(bin2bcd(tm.tm_min));
+  Wire.write(bin2bcd(tm.tm_hour));
+  Wire.write(bin2bcd(tm.tm_mday));
+  Wire.write(tm.tm_wday);
+  Wire.write(bin2bcd(tm.tm_mon + 1));
+  Wire.write(bin2bcd(tm.tm_year - 100));
+  return Wire.endTransmission() == 0;
+}
+
+bool wallclockInit() {
+  time_t t;
+  if (!rtcRead(t)) {
+    LOGI(LOG_CLOCK, "RTC not set; waiting for NTP");
+    return false;
+  }
+  struct timeval tv = {t, 0};
+  settimeofday(&tv, nullptr);
+  LOGI(LOG_CLOCK, "from RTC: %lu", (unsigned long)t);
+  return true;
+}
+
+static void onNtpSync(struct timeval *) { s_ntpSynced = true; }
+
+void wallclockStartNtp() {
+  sntp_set_time_sync_notification_cb(onNtpSync);
+  configTime(0, 0, NTP_SERVER_1, NTP_SERVER_2);
+}
+
+void wallclockLoop() {
+  if (!s_ntpSynced) return;
+  s_ntpSynced = false;
+  time_t t = time(nullptr);
+  bool ok = rtcWrite(t);
+  LOGI(LOG_CLOCK, "NTP sync %lu%s", (unsigned long)t, ok ? ", RTC updated" : ", RTC write failed");
+}
+
+bool wallclockNow(uint32_t &unixSec, uint16_t &ms) {
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec < (time_t)RTC_VALID_AFTER) return false;
+  unixSec = (uint32_t)tv.tv_sec;
+  ms = (uint16_t)(tv.tv_usec / 1000);
+  return true;
+}
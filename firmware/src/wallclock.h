@@ -0,0 +1,22 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Wall-clock time for telemetry timestamps. NTP sets the system clock whenever
+// the network is up, and each sync is copied into the on-board PCF85063 RTC
+// (shared I2C bus). At boot the system clock is seeded from the RTC, so
+// readings taken before (or without) any network still get real timestamps.
+// loop() context only: the RTC shares the I2C bus with the codec and expander.
+
+// Seed the system clock from the RTC if it holds a valid time. Call once in
+// setup(), after initI2C(). Returns false if the RTC is absent or stopped.
+bool wallclockInit();
+
+// Start SNTP. Call whenever WiFi (re)connects.
+void wallclockStartNtp();
+
+// Copy a fresh NTP sync into the RTC. Call from loop().
+void wallclockLoop();
+
+// Current UTC time, or false if neither NTP nor the RTC has provided one.
+bool wallclockNow(uint32_t &unixSec, uint16_t &ms);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "biquad.h"
+
+// Frequency weightings for the level meter. Z is unweighted (flat), A and C
+// follow IEC 61672, K is the ITU-R BS.1770 loudness pre-filter. Every curve is
+// normalised to 0 dB at 1 kHz so a 1 kHz tone reads the same under each.
+enum Weighting : uint8_t {
+  WEIGHTING_Z = 0,
+  WEIGHTING_A = 1,
+  WEIGHTING_C = 2,
+  WEIGHTING_K = 3,
+};
+
+// Biquad sections implementing weighting w at SAMPLE_RATE (designed at compile
+// time). Sets count to 0 for Z.
+const Biquad *weightingSections(Weighting w, uint8_t &count);
+
+// Single-letter name as reported to the server ("Z", "A", "C", "K").
+const char *weightingName(Weighting w);
+
+// Parse a single-letter name (case-insensitive). Returns false if unknown.
+bool weightingFromName(const char *name, Weighting &out);
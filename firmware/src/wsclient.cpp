@@ -0,0 +1,342 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_heap_caps.h>
+#include <esp_random.h>
+#include <mbedtls/base64.h>
+#include <mbedtls/sha1.h>
+
+#include "config.h"
+#include "logring.h"
+#include "tls.h"
+#include "wsclient.h"
+
+enum : uint8_t { OP_CONT = 0x0, OP_TEXT = 0x1, OP_BIN = 0x2, OP_CLOSE = 0x8, OP_PING = 0x9, OP_PONG = 0xA };
+
+static const char *WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+static const size_t WS_CONTROL_MAX = 125;  // control frame payload limit
+
+struct WsState {
+  TlsClient tls;   // wss: resumes the cached session on reconnect
+  WiFiClient tcp;  // ws
+  bool ssl = false;
+  char host[64];
+  uint16_t port = 0;
+  char path[64];
+  bool begun = false;
+  bool attempted = false;     // a connect has been tried since begin()
+  unsigned long lastAttempt = 0;
+  uint8_t *rx = nullptr;      // WS_RX_MESSAGE_BYTES, the message being received
+  size_t rxLen = 0;
+  uint8_t rxOpcode = 0;       // OP_TEXT / OP_BIN while a message is open, else 0
+  bool rxSkip = false;        // the open message is too long and is being discarded
+
+  WiFiClient &io() { return ssl ? (WiFiClient &)tls : tcp; }
+};
+
+// --- Transport ---
+
+static bool writeAll(WsState &s, const uint8_t *buf, size_t len) {
+  return s.io().write(buf, len) == len;
+}
+
+// Block for exactly len bytes, up to TLS_IO_TIMEOUT_MS.
+static bool readAll(WsState &s, uint8_t *buf, size_t len) {
+  unsigned long t0 = millis();
+  size_t got = 0;
+  while (got < len) {
+    int n = s.io().read(buf + got, len - got);
+    if (n > 0) {
+      got += n;
+      continue;
+    }
+    if (!s.io().connected() || millis() - t0 >= TLS_IO_TIMEOUT_MS) return false;
+    delay(1);
+  }
+  return true;
+}
+
+static bool skipAll(WsState &s, uint64_t len) {
+  uint8_t scratch[64];
+  while (len > 0) {
+    size_t n = len < sizeof(scratch) ? (size_t)len : sizeof(scratch);
+    if (!readAll(s, scratch, n)) return false;
+    len -= n;
+  }
+  return true;
+}
+
+// --- Frames (client to server: always masked) ---
+
+// Write the header for a payload of len bytes ending at `end`; returns its size.
+static size_t putHeader(uint8_t *end, uint8_t opcode, size_t len, uint8_t mask[4]) {
+  size_t n = 2 + (len < 126 ? 0 : len <= 0xFFFF ? 2 : 8) + 4;
+  uint8_t *h = end - n;
+  h[0] = 0x80 | opcode;  // FIN: sends are never fragmented
+  if (len < 126) {
+    h[1] = 0x80 | (uint8_t)len;
+  } else if (len <= 0xFFFF) {
+    h[1] = 0x80 | 126;
+    h[2] = len >> 8;
+    h[3] = len;
+  } else {
+    h[1] = 0x80 | 127;
+    for (int i = 0; i < 8; i++) h[2 + i] = (uint8_t)((uint64_t)len >> (56 - 8 * i));
+  }
+  uint32_t r = esp_random();
+  memcpy(mask, &r, 4);
+  memcpy(end - 4, mask, 4);
+  return n;
+}
+
+static void applyMask(uint8_t *buf, size_t len, const uint8_t mask[4], size_t offset = 0) {
+  for (size_t i = 0; i < len; i++) buf[i] ^= mask[(offset + i) & 3];
+}
+
+// frame: WEBSOCKETS_MAX_HEADER_SIZE bytes of room, then len bytes of payload.
+static bool sendInPlace(WsState &s, uint8_t opcode, uint8_t *frame, size_t len) {
+  uint8_t mask[4];
+  uint8_t *payload = frame + WEBSOCKETS_MAX_HEADER_SIZE;
+  size_t n = putHeader(payload, opcode, len, mask);
+  applyMask(payload, len, mask);
+  return writeAll(s, payload - n, n + len);
+}
+
+// Payload the caller keeps: masked through a small buffer.
+static bool sendCopy(WsState &s, uint8_t opcode, const uint8_t *payload, size_t len) {
+  uint8_t mask[4];
+  uint8_t header[WEBSOCKETS_MAX_HEADER_SIZE];
+  size_t n = putHeader(header + sizeof(header), opcode, len, mask);
+  if (!writeAll(s, header + sizeof(header) - n, n)) return false;
+  uint8_t chunk[128];
+  for (size_t off = 0; off < len; off += sizeof(chunk)) {
+    size_t k = len - off < sizeof(chunk) ? len - off : sizeof(chunk);
+    memcpy(chunk, payload + off, k);
+    applyMask(chunk, k, mask, off);
+    if (!writeAll(s, chunk, k)) return false;
+  }
+  return true;
+}
+
+// --- Opening handshake ---
+
+// One response line, CRLF stripped. False on timeout, close or overlong line.
+static bool readLine(WsState &s, char *line, size_t cap) {
+  size_t n = 0;
+  for (;;) {
+    uint8_t c;
+    if (!readAll(s, &c, 1)) return false;
+    if (c == '\n') break;
+    if (c == '\r') continue;
+    if (n + 1 >= cap) return false;
+    line[n++] = (char)c;
+  }
+  line[n] = '\0';
+  return true;
+}
+
+static bool upgrade(WsState &s) {
+  uint8_t raw[16];
+  esp_fill_random(raw, sizeof(raw));
+  char key[32];
+  size_t keyLen = 0;
+  mbedtls_base64_encode((unsigned char *)key, sizeof(key), &keyLen, raw, sizeof(raw));
+  key[keyLen] = '\0';
+
+  char req[320];
+  int len = snprintf(req, sizeof(req),
+                     "GET %s HTTP/1.1\r\n"
+                     "Host: %s:%u\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Key: %s\r\n"
+                     "Sec-WebSocket-Version: 13\r\n"
+                     "User-Agent: arduino-WebSocket-Client\r\n"
+                     "\r\n",
+                     s.path, s.host, (unsigned)s.port, key);
+  if (len <= 0 || len >= (int)sizeof(req) || !writeAll(s, (const uint8_t *)req, len)) return false;
+
+  // Sec-WebSocket-Accept must be base64(SHA-1(key + GUID)).
+  char expect[32];
+  {
+    char joined[64];
+    unsigned char digest[20];
+    size_t n = snprintf(joined, sizeof(joined), "%s%s", key, WS_GUID);
+    mbedtls_sha1((const unsigned char *)joined, n, digest);
+    size_t out = 0;
+    mbedtls_base64_encode((unsigned char *)expect, sizeof(expect), &out, digest, sizeof(digest));
+    expect[out] = '\0';
+  }
+
+  char line[256];
+  if (!readLine(s, line, sizeof(line))) return false;
+  if (strncmp(line, "HTTP/1.1 101", 12) != 0) {
+    LOGW(LOG_WS, "upgrade refused: %s", line);
+    return false;
+  }
+  bool accepted = false;
+  while (readLine(s, line, sizeof(line))) {
+    if (line[0] == '\0') {
+      if (!accepted) LOGW(LOG_WS, "upgrade: missing or wrong Sec-WebSocket-Accept");
+      return accepted;
+    }
+    if (strncasecmp(line, "Sec-WebSocket-Accept:", 21) == 0) {
+      const char *v = line + 21;
+      while (*v == ' ') v++;
+      accepted = strcmp(v, expect) == 0;
+    }
+  }
+  return false;
+}
+
+// --- WsClient ---
+
+WsClient::~WsClient() {
+  if (!_s) return;
+  _s->io().stop();
+  free(_s->rx);
+  delete _s;
+}
+
+void WsClient::begin(const char *host, uint16_t port, const char *url) { start(host, port, url, false); }
+
+void WsClient::beginSSL(const char *host, uint16_t port, const char *url) { start(host, port, url, true); }
+
+void WsClient::start(const char *host, uint16_t port, const char *url, bool ssl) {
+  if (!_s) {
+    _s = new WsState;
+    _s->rx = (uint8_t *)heap_caps_malloc(WS_RX_MESSAGE_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!_s->rx) _s->rx = (uint8_t *)heap_caps_malloc(WS_RX_MESSAGE_BYTES, MALLOC_CAP_8BIT);
+    if (!_s->rx) LOGE(LOG_WS, "no memory for the receive buffer - incoming messages dropped");
+  }
+  if (_connected) disconnect();
+  _s->ssl = ssl;
+  snprintf(_s->host, sizeof(_s->host), "%s", host);
+  _s->port = port;
+  snprintf(_s->path, sizeof(_s->path), "%s", url);
+  _s->begun = true;
+  _s->attempted = false;
+}
+
+void WsClient::closed() {
+  _s->io().stop();
+  _s->rxOpcode = 0;
+  _s->rxLen = 0;
+  _s->rxSkip = false;
+  _s->lastAttempt = millis();
+  if (!_connected) return;
+  _connected = false;
+  if (_cb) _cb(WStype_DISCONNECTED, nullptr, 0);
+}
+
+void WsClient::loop() {
+  if (!_s || !_s->begun) return;
+  WsState &s = *_s;
+
+  if (!_connected) {
+    if (s.attempted && millis() - s.lastAttempt < _reconnectMs) return;
+    s.attempted = true;
+    if (!s.io().connect(s.host, s.port) || !upgrade(s)) {
+      LOGD(LOG_WS, "connect to %s:%u failed", s.host, (unsigned)s.port);
+      closed();
+      return;
+    }
+    _connected = true;
+    if (_cb) _cb(WStype_CONNECTED, (uint8_t *)s.path, strlen(s.path));
+    return;
+  }
+
+  if (!s.io().connected()) {
+    closed();
+    return;
+  }
+
+  // A broken frame, a timeout or a close from the server ends the link.
+  while (_connected && s.io().available() > 0) {
+    uint8_t h[2];
+    if (!readAll(s, h, 2)) return closed();
+    bool fin = h[0] & 0x80;
+    uint8_t opcode = h[0] & 0x0F;
+    uint64_t len = h[1] & 0x7F;
+    if (len >= 126) {
+      uint8_t ext[8];
+      size_t n = len == 126 ? 2 : 8;
+      if (!readAll(s, ext, n)) return closed();
+      len = 0;
+      for (size_t i = 0; i < n; i++) len = (len << 8) | ext[i];
+    }
+    uint8_t mask[4] = {0, 0, 0, 0};  // servers do not mask, but may
+    if ((h[1] & 0x80) && !readAll(s, mask, 4)) return closed();
+
+    if (opcode >= OP_CLOSE) {
+      uint8_t body[WS_CONTROL_MAX + 1];
+      if (len > WS_CONTROL_MAX || !readAll(s, body, len)) return closed();
+      applyMask(body, len, mask);
+      if (opcode == OP_CLOSE) {
+        sendCopy(s, OP_CLOSE, body, len < 2 ? len : 2);  // echo the status code
+        return closed();
+      }
+      if (opcode == OP_PING) sendCopy(s, OP_PONG, body, len);
+      body[len] = '\0';
+      if (_cb && (opcode == OP_PING || opcode == OP_PONG)) {
+        _cb(opcode == OP_PING ? WStype_PING : WStype_PONG, body, len);
+      }
+      continue;
+    }
+
+    if (opcode == OP_TEXT || opcode == OP_BIN) {
+      s.rxOpcode = opcode;
+      s.rxLen = 0;
+      s.rxSkip = false;
+    } else if (opcode != OP_CONT || s.rxOpcode == 0) {
+      LOGW(LOG_WS, "unexpected frame opcode %u", opcode);
+      return closed();
+    }
+    if (s.rxSkip || !s.rx || len >= WS_RX_MESSAGE_BYTES - s.rxLen) {
+      if (!s.rxSkip) LOGW(LOG_WS, "message over %u bytes skipped", (unsigned)WS_RX_MESSAGE_BYTES - 1);
+      s.rxSkip = true;
+      if (!skipAll(s, len)) return closed();
+    } else {
+      if (!readAll(s, s.rx + s.rxLen, len)) return closed();
+      applyMask(s.rx + s.rxLen, len, mask);
+      s.rxLen += len;
+    }
+    if (!fin) continue;
+    uint8_t type = s.rxOpcode;
+    bool skipped = s.rxSkip;
+    s.rxOpcode = 0;
+    s.rxSkip = false;
+    if (skipped || !_cb) continue;
+    s.rx[s.rxLen] = '\0';
+    _cb(type == OP_TEXT ? WStype_TEXT : WStype_BIN, s.rx, s.rxLen);
+  }
+}
+
+void WsClient::disconnect() {
+  if (!_s) return;
+  if (_connected) {
+    static const uint8_t normal[2] = {0x03, 0xE8};  // 1000
+    sendCopy(*_s, OP_CLOSE, normal, sizeof(normal));
+  }
+  closed();
+  _s->begun = false;
+}
+
+bool WsClient::sendTXT(const char *payload, size_t length) {
+  if (!_connected) return false;
+  if (length == 0) length = strlen(payload);
+  return sendCopy(*_s, OP_TEXT, (const uint8_t *)payload, length);
+}
+
+bool WsClient::sendBIN(const uint8_t *payload, size_t length) {
+  return _connected && sendCopy(*_s, OP_BIN, payload, length);
+}
+
+bool WsClient::sendTXT(uint8_t *payload, size_t length, bool headerToPayload) {
+  if (!headerToPayload) return sendTXT((const char *)payload, length);
+  return _connected && sendInPlace(*_s, OP_TEXT, payload, length);
+}
+
+bool WsClient::sendBIN(uint8_t *payload, size_t length, bool headerToPayload) {
+  if (!headerToPayload) return sendBIN((const uint8_t *)payload, length);
+  return _connected && sendInPlace(*_s, OP_BIN, payload, length);
+}
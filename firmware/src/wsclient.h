@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+
+// Websocket client (RFC 6455) over TlsClient (tls.h), so a reconnect offers the
+// cached TLS session like the OTA fetches do instead of a full handshake every
+// time. Same calls and events as links2004/WebSockets' WebSocketsClient, which
+// builds its own WiFiClientSecure and so cannot use the cache.
+//
+// Like the library, connecting blocks the loop() that does it (TCP, TLS and
+// the upgrade), and a dropped link is retried every setReconnectInterval() ms.
+// Messages fragmented by the server are reassembled; pings are answered. Text
+// and binary messages arrive whole, NUL-terminated, from a buffer reserved in
+// begin() (WS_RX_MESSAGE_BYTES); a longer message is skipped with a warning.
+// One task at a time.
+
+// Bytes in front of a headerToPayload send: the largest client frame header
+// (2 + 8-byte length + 4-byte mask).
+#define WEBSOCKETS_MAX_HEADER_SIZE 14
+
+typedef enum {
+  WStype_ERROR,
+  WStype_DISCONNECTED,
+  WStype_CONNECTED,
+  WStype_TEXT,
+  WStype_BIN,
+  WStype_PING,
+  WStype_PONG,
+} WStype_t;
+
+struct WsState;  // transport, parser and receive buffer (tls.h on the target)
+
+class WsClient {
+public:
+  typedef std::function<void(WStype_t type, uint8_t *payload, size_t length)> WebSocketClientEvent;
+
+  WsClient() {}
+  ~WsClient();
+
+  void begin(const char *host, uint16_t port, const char *url = "/");
+  void beginSSL(const char *host, uint16_t port, const char *url = "/");
+  void onEvent(WebSocketClientEvent cb) { _cb = cb; }
+  void setReconnectInterval(unsigned long ms) { _reconnectMs = ms; }
+  void loop();
+  // Close the link and stop reconnecting until the next begin().
+  void disconnect();
+  bool isConnected() const { return _connected; }
+
+  bool sendTXT(const char *payload, size_t length = 0);
+  bool sendTXT(String &payload) { return sendTXT(payload.c_str(), payload.length()); }
+  bool sendBIN(const uint8_t *payload, size_t length);
+  // headerToPayload: the payload starts WEBSOCKETS_MAX_HEADER_SIZE bytes in,
+  // after room for the frame header, and is masked in place: no copy.
+  bool sendTXT(uint8_t *payload, size_t length, bool headerToPayload);
+  bool sendBIN(uint8_t *payload, size_t length, bool headerToPayload);
+
+private:
+  void start(const char *host, uint16_t port, const char *url, bool ssl);
+  void closed();
+
+  WebSocketClientEvent _cb;
+  WsState *_s = nullptr;
+  unsigned long _reconnectMs = 500;
+  bool _connected = false;
+};
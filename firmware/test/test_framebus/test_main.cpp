@@ -0,0 +1,264 @@
+// FrameBus (src/framebus.h) on the host: per-consumer counters, overrun
+// skip-ahead, block reference counting and the non-blocking producer.
+//   pio test -e native -f test_framebus
+
+#include <atomic>
+#include <thread>
+#include <unity.h>
+
+#include "../../src/framebus.h"
+
+static const size_t LEN = 8;
+static const size_t DEPTH = 4;
+static const size_t CONSUMERS = 3;
+typedef FrameBus<int16_t, LEN, DEPTH, CONSUMERS> Bus;
+
+// Fill a block with its sequence number and publish it.
+static void produce(Bus &bus, uint32_t seq) {
+  int16_t *data = bus.acquire();
+  TEST_ASSERT_NOT_NULL_MESSAGE(data, "producer found no free block");
+  for (size_t i = 0; i < LEN; i++) data[i] = (int16_t)seq;
+  bus.publish(LEN);
+}
+
+// Read one block, check it holds seq throughout, and release it.
+static void consume(Bus &bus, int id, uint32_t seq) {
+  const Bus::Block *b = bus.read(id);
+  TEST_ASSERT_NOT_NULL(b);
+  TEST_ASSERT_EQUAL_UINT32(seq, b->seq);
+  TEST_ASSERT_EQUAL_UINT32(LEN, b->len);
+  for (size_t i = 0; i < LEN; i++) TEST_ASSERT_EQUAL_INT16((int16_t)seq, b->data[i]);
+  bus.release(id);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_subscribe_limit() {
+  Bus bus;
+  TEST_ASSERT_TRUE(bus.begin(MALLOC_CAP_8BIT));
+  for (size_t i = 0; i < CONSUMERS; i++) TEST_ASSERT_EQUAL_INT((int)i, bus.subscribe());
+  TEST_ASSERT_EQUAL_INT(-1, bus.subscribe());
+}
+
+void test_consumer_sees_blocks_from_subscribe() {
+  Bus bus;
+  TEST_ASSERT_TRUE(bus.begin(MALLOC_CAP_8BIT));
+  int early = bus.subscribe();
+  produce(bus, 0);
+  int late = bus.subscribe();
+  produce(bus, 1);
+  consume(bus, early, 0);
+  consume(bus, early, 1);
+  consume(bus, late, 1);
+  TEST_ASSERT_NULL(bus.read(early));
+  TEST_ASSERT_NULL(bus.read(late));
+}
+
+// One consumer keeps up, the other falls Depth + 3 blocks behind: only the
+// slow one is charged the overruns, and it resumes at the oldest held block.
+void test_overrun_counts_per_consumer() {
+  Bus bus;
+  TEST_ASSERT_TRUE(bus.begin(MALLOC_CAP_8BIT));
+  int fast = bus.subscribe();
+  int slow = bus.subscribe();
+
+  const uint32_t n = DEPTH + 3;
+  for (uint32_t seq = 0; seq < n; seq++) {
+    produce(bus, seq);
+    consume(bus, fast, seq);
+  }
+
+  FrameBusStats f = bus.stats(fast);
+  TEST_ASSERT_EQUAL_UINT32(n, f.received);
+  TEST_ASSERT_EQUAL_UINT32(0, f.overruns);
+  TEST_ASSERT_EQUAL_UINT32(0, f.lag);
+  TEST_ASSERT_EQUAL_UINT32(1, f.maxLag);
+
+  FrameBusStats s = bus.stats(slow);
+  TEST_ASSERT_EQUAL_UINT32(0, s.received);
+  TEST_ASSERT_EQUAL_UINT32(0, s.overruns);  // charged at its next read
+  TEST_ASSERT_EQUAL_UINT32(n, s.lag);
+
+  // Skip-ahead: blocks 0..2 are gone, 3..6 are read in order.
+  for (uint32_t seq = n - DEPTH; seq < n; seq++) consume(bus, slow, seq);
+  TEST_ASSERT_NULL(bus.read(slow));
+
+  s = bus.stats(slow);
+  TEST_ASSERT_EQUAL_UINT32(DEPTH, s.received);
+  TEST_ASSERT_EQUAL_UINT32(n - DEPTH, s.overruns);
+  TEST_ASSERT_EQUAL_UINT32(0, s.lag);
+  TEST_ASSERT_EQUAL_UINT32(DEPTH, s.maxLag);
+
+  // The fast consumer's counters are untouched by the other's overrun.
+  f = bus.stats(fast);
+  TEST_ASSERT_EQUAL_UINT32(n, f.received);
+  TEST_ASSERT_EQUAL_UINT32(0, f.overruns);
+}
+
+void test_lag_within_depth_is_not_an_overrun() {
+  Bus bus;
+  TEST_ASSERT_TRUE(bus.begin(MALLOC_CAP_8BIT));
+  int id = bus.subscribe();
+  for (uint32_t seq = 0; seq < DEPTH; seq++) produce(bus, seq);
+  TEST_ASSERT_EQUAL_UINT32(DEPTH, bus.stats(id).lag);
+  for (uint32_t seq = 0; seq < DEPTH; seq++) consume(bus, id, seq);
+  FrameBusStats s = bus.stats(id);
+  TEST_ASSERT_EQUAL_UINT32(DEPTH, s.received);
+  TEST_ASSERT_EQUAL_UINT32(0, s.overruns);
+  TEST_ASSERT_EQUAL_UINT32(DEPTH, s.maxLag);
+}
+
+// A block goes back to the pool once the ring and every reader have let go of
+// it, and not before.
+void test_refcount_release_and_reuse() {
+  Bus bus;
+  TEST_ASSERT_TRUE(bus.begin(MALLOC_CAP_8BIT));
+  int id = bus.subscribe();
+
+  produce(bus, 0);
+  const Bus::Block *held = bus.read(id);
+  TEST_ASSERT_NOT_NULL(held);
+  TEST_ASSERT_EQUAL_UINT32(2, held->refs.load());  // ring + reader
+
+  // Push block 0 out of the ring while it is still held, then cycle the pool
+  // several times: its samples must never be overwritten.
+  for (uint32_t seq = 1; seq < 4 * Bus::POOL; seq++) {
+    int16_t *data = bus.acquire();
+    TEST_ASSERT_NOT_NULL(data);
+    TEST_ASSERT_TRUE(data != held->data);
+    for (size_t i = 0; i < LEN; i++) data[i] = (int16_t)seq;
+    bus.publish(LEN);
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, held->refs.load());  // the reader only
+  TEST_ASSERT_EQUAL_UINT32(0, held->seqValid.load());
+  for (size_t i = 0; i < LEN; i++) TEST_ASSERT_EQUAL_INT16(0, held->data[i]);
+
+  // Released, it is free and the producer picks it up again.
+  bus.release(id);
+  TEST_ASSERT_EQUAL_UINT32(0, held->refs.load());
+  bool reused = false;
+  for (size_t n = 0; n < Bus::POOL && !reused; n++) {
+    int16_t *data = bus.acquire();
+    TEST_ASSERT_NOT_NULL(data);
+    reused = data == held->data;
+    bus.publish(LEN);
+  }
+  TEST_ASSERT_TRUE(reused);
+}
+
+void test_acquire_twice_returns_same_block() {
+  Bus bus;
+  TEST_ASSERT_TRUE(bus.begin(MALLOC_CAP_8BIT));
+  int16_t *a = bus.acquire();
+  TEST_ASSERT_NOT_NULL(a);
+  TEST_ASSERT_EQUAL_PTR(a, bus.acquire());
+  bus.publish(LEN);
+  TEST_ASSERT_EQUAL_UINT32(1, bus.published());
+}
+
+// MaxConsumers readers each sit on a block and never read again: the pool
+// still has a free block for every publish.
+void test_producer_never_blocks_with_stalled_consumers() {
+  Bus bus;
+  TEST_ASSERT_TRUE(bus.begin(MALLOC_CAP_8BIT));
+  int ids[CONSUMERS];
+  for (size_t c = 0; c < CONSUMERS; c++) ids[c] = bus.subscribe();
+
+  // Consumer c catches up to block c and keeps it.
+  for (uint32_t c = 0; c < CONSUMERS; c++) {
+    produce(bus, c);
+    for (;;) {
+      const Bus::Block *b = bus.read(ids[c]);
+      TEST_ASSERT_NOT_NULL(b);
+      if (b->seq == c) break;
+      bus.release(ids[c]);
+    }
+  }
+  const uint32_t n = 1000;
+  for (uint32_t seq = CONSUMERS; seq < n; seq++) produce(bus, seq);
+  TEST_ASSERT_EQUAL_UINT32(n, bus.published());
+
+  // Once they let go, each skips ahead to the oldest block still held.
+  for (uint32_t c = 0; c < CONSUMERS; c++) {
+    bus.release(ids[c]);
+    consume(bus, ids[c], n - DEPTH);
+    FrameBusStats s = bus.stats(ids[c]);
+    TEST_ASSERT_EQUAL_UINT32(n - DEPTH - (c + 1), s.overruns);
+    TEST_ASSERT_EQUAL_UINT32(DEPTH - 1, s.lag);
+  }
+}
+
+// The same on real threads: slow readers that hold each block for a while,
+// a producer that must never find the pool empty, and every block a reader
+// gets intact and in order.
+void test_producer_never_blocks_threaded() {
+  Bus bus;
+  TEST_ASSERT_TRUE(bus.begin(MALLOC_CAP_8BIT));
+  int ids[CONSUMERS];
+  for (size_t c = 0; c < CONSUMERS; c++) ids[c] = bus.subscribe();
+
+  const uint32_t blocks = 20000;
+  std::atomic<bool> done{false};
+  std::atomic<uint32_t> failures{0};
+  std::thread readers[CONSUMERS];
+  for (size_t c = 0; c < CONSUMERS; c++) {
+    readers[c] = std::thread([&, c] {
+      int id = ids[c];
+      int64_t last = -1;
+      for (;;) {
+        bool finished = done.load();
+        const Bus::Block *b = bus.read(id);
+        if (!b) {
+          if (finished) break;
+          std::this_thread::yield();
+          continue;
+        }
+        if ((int64_t)b->seq <= last) failures++;
+        for (size_t i = 0; i < LEN; i++) {
+          if (b->data[i] != (int16_t)b->seq) failures++;
+        }
+        last = b->seq;
+        // Slower than the producer, more so for higher ids.
+        for (size_t k = 0; k <= c; k++) std::this_thread::yield();
+        bus.release(id);
+      }
+    });
+  }
+
+  uint32_t stalls = 0;
+  for (uint32_t seq = 0; seq < blocks; seq++) {
+    int16_t *data = bus.acquire();
+    if (!data) {
+      stalls++;
+      continue;
+    }
+    for (size_t i = 0; i < LEN; i++) data[i] = (int16_t)seq;
+    bus.publish(LEN);
+  }
+  done = true;
+  for (auto &t : readers) t.join();
+
+  TEST_ASSERT_EQUAL_UINT32(0, stalls);
+  TEST_ASSERT_EQUAL_UINT32(0, failures.load());
+  TEST_ASSERT_EQUAL_UINT32(blocks, bus.published());
+  for (size_t c = 0; c < CONSUMERS; c++) {
+    FrameBusStats s = bus.stats(ids[c]);
+    TEST_ASSERT_EQUAL_UINT32(0, s.lag);
+    TEST_ASSERT_EQUAL_UINT32(blocks, s.received + s.overruns);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(DEPTH, s.maxLag);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_subscribe_limit);
+  RUN_TEST(test_consumer_sees_blocks_from_subscribe);
+  RUN_TEST(test_overrun_counts_per_consumer);
+  RUN_TEST(test_lag_within_depth_is_not_an_overrun);
+  RUN_TEST(test_refcount_release_and_reuse);
+  RUN_TEST(test_acquire_twice_returns_same_block);
+  RUN_TEST(test_producer_never_blocks_with_stalled_consumers);
+  RUN_TEST(test_producer_never_blocks_threaded);
+  return UNITY_END();
+}
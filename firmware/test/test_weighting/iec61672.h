@@ -0,0 +1,78 @@
+#pragma once
+
+// IEC 61672-1:2013 Table 3: A and C weightings at the nominal frequencies, with
+// the class 1 acceptance limits. A lower limit of -INFINITY means none.
+
+#include <math.h>
+
+#include "../../src/biquad.h"
+
+struct WeightingPoint {
+  double hz;
+  double a, c;           // dB
+  double upper, lower;   // class 1 limits, dB
+};
+
+static const WeightingPoint IEC61672[] = {
+    {10, -70.4, -14.3, 3.5, -INFINITY},
+    {12.5, -63.4, -11.2, 3.0, -INFINITY},
+    {16, -56.7, -8.5, 2.5, -4.5},
+    {20, -50.5, -6.2, 2.5, -2.5},
+    {25, -44.7, -4.4, 2.5, -2.0},
+    {31.5, -39.4, -3.0, 2.0, -2.0},
+    {40, -34.6, -2.0, 1.5, -1.5},
+    {50, -30.2, -1.3, 1.5, -1.5},
+    {63, -26.2, -0.8, 1.5, -1.5},
+    {80, -22.5, -0.5, 1.5, -1.5},
+    {100, -19.1, -0.3, 1.5, -1.5},
+    {125, -16.1, -0.2, 1.5, -1.5},
+    {160, -13.4, -0.1, 1.5, -1.5},
+    {200, -10.9, 0.0, 1.4, -1.4},
+    {250, -8.6, 0.0, 1.4, -1.4},
+    {315, -6.6, 0.0, 1.4, -1.4},
+    {400, -4.8, 0.0, 1.4, -1.4},
+    {500, -3.2, 0.0, 1.4, -1.4},
+    {630, -1.9, 0.0, 1.4, -1.4},
+    {800, -0.8, 0.0, 1.4, -1.4},
+    {1000, 0.0, 0.0, 1.1, -1.1},
+    {1250, 0.6, 0.0, 1.4, -1.4},
+    {1600, 1.0, -0.1, 1.6, -1.6},
+    {2000, 1.2, -0.2, 1.6, -1.6},
+    {2500, 1.3, -0.3, 1.6, -1.6},
+    {3150, 1.2, -0.5, 1.6, -1.6},
+    {4000, 1.0, -0.8, 1.6, -1.6},
+    {5000, 0.5, -1.3, 2.1, -2.1},
+    {6300, -0.1, -2.0, 2.1, -2.6},
+    {8000, -1.1, -3.0, 2.1, -3.1},
+    {10000, -2.5, -4.4, 2.6, -3.6},
+    {12500, -4.3, -6.2, 3.0, -6.0},
+    {16000, -6.6, -8.5, 3.5, -17.0},
+    {20000, -9.3, -11.2, 4.0, -INFINITY},
+};
+
+// Gain (dB) of a cascade at hz for sample rate fs, evaluated in double from
+// the float coefficients the firmware runs.
+inline double cascadeDb(const Biquad *s, uint8_t n, double hz, double fs) {
+  const double w = 2 * M_PI * hz / fs;
+  double mag2 = 1;
+  for (uint8_t i = 0; i < n; i++) {
+    const double nr = s[i].b0 + s[i].b1 * cos(w) + s[i].b2 * cos(2 * w);
+    const double ni = -s[i].b1 * sin(w) - s[i].b2 * sin(2 * w);
+    const double dr = 1 + s[i].a1 * cos(w) + s[i].a2 * cos(2 * w);
+    const double di = -s[i].a1 * sin(w) - s[i].a2 * sin(2 * w);
+    mag2 *= (nr * nr + ni * ni) / (dr * dr + di * di);
+  }
+  return 10 * log10(mag2);
+}
+
+// The analytic A and C curves of IEC 61672-1 (Annex E), 0 dB at 1 kHz.
+inline double analyticC(double hz) {
+  const double f1 = 20.598997, f4 = 12194.217, f2 = hz * hz;
+  return 20 * log10(f4 * f4 * f2 / ((f2 + f1 * f1) * (f2 + f4 * f4))) + 0.0619;
+}
+inline double analyticA(double hz) {
+  const double f1 = 20.598997, f2 = 107.65265, f3 = 737.86223, f4 = 12194.217, ff = hz * hz;
+  return 20 * log10(f4 * f4 * ff * ff /
+                    ((ff + f1 * f1) * sqrt(ff + f2 * f2) * sqrt(ff + f3 * f3) * (ff + f4 * f4))) +
+         2.0;
+}
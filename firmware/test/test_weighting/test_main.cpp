@@ -0,0 +1,90 @@
+// A and C weighting at the firmware's SAMPLE_RATE against IEC 61672-1: class 1
+// tolerances at the table frequencies below Nyquist, and the analytic curves
+// to 7.5 kHz. The K cascade at 48 kHz is in test_weighting_48k.
+//   pio test -e native -f test_weighting
+
+#include <initializer_list>
+#include <stdio.h>
+#include <unity.h>
+
+#include "../../src/weighting.cpp"
+#include "iec61672.h"
+
+static const double RATE = SAMPLE_RATE;
+
+// Every table frequency below Nyquist is within the class 1 limits.
+static void checkClass1(Weighting w) {
+  uint8_t n;
+  const Biquad *s = weightingSections(w, n);
+  TEST_ASSERT_NOT_NULL(s);
+  char msg[96];
+  for (const WeightingPoint &p : IEC61672) {
+    if (p.hz >= RATE / 2) break;
+    double err = cascadeDb(s, n, p.hz, RATE) - (w == WEIGHTING_A ? p.a : p.c);
+    snprintf(msg, sizeof(msg), "%s at %g Hz: %+.2f dB off the table", weightingName(w), p.hz, err);
+    TEST_ASSERT_TRUE_MESSAGE(err <= p.upper && err >= p.lower, msg);
+  }
+}
+
+// Within maxDb of the analytic curve from 10 Hz to hiHz, in 1/24 octaves.
+static void checkAnalytic(Weighting w, double hiHz, double maxDb) {
+  uint8_t n;
+  const Biquad *s = weightingSections(w, n);
+  char msg[96];
+  for (double hz = 10; hz <= hiHz; hz *= pow(2, 1 / 24.0)) {
+    double want = w == WEIGHTING_A ? analyticA(hz) : analyticC(hz);
+    snprintf(msg, sizeof(msg), "%s at %.0f Hz", weightingName(w), hz);
+    TEST_ASSERT_FLOAT_WITHIN_MESSAGE(maxDb, want, cascadeDb(s, n, hz, RATE), msg);
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_a_class1() { checkClass1(WEIGHTING_A); }
+void test_c_class1() { checkClass1(WEIGHTING_C); }
+
+// The claim in weighting.cpp for rates below 32 kHz.
+void test_a_analytic_to_7k5() { checkAnalytic(WEIGHTING_A, 7500, 0.35); }
+void test_c_analytic_to_7k5() { checkAnalytic(WEIGHTING_C, 7500, 0.35); }
+
+void test_unity_gain_at_1k() {
+  for (Weighting w : {WEIGHTING_A, WEIGHTING_C, WEIGHTING_K}) {
+    uint8_t n;
+    const Biquad *s = weightingSections(w, n);
+    TEST_ASSERT_TRUE(n > 0 && n <= BIQUAD_MAX_SECTIONS);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 0.0, cascadeDb(s, n, 1000, RATE));
+  }
+}
+
+void test_z_is_empty() {
+  uint8_t n = 99;
+  TEST_ASSERT_NULL(weightingSections(WEIGHTING_Z, n));
+  TEST_ASSERT_EQUAL_UINT8(0, n);
+}
+
+void test_names_round_trip() {
+  for (Weighting w : {WEIGHTING_Z, WEIGHTING_A, WEIGHTING_C, WEIGHTING_K}) {
+    Weighting parsed;
+    TEST_ASSERT_TRUE(weightingFromName(weightingName(w), parsed));
+    TEST_ASSERT_EQUAL_UINT8(w, parsed);
+  }
+  Weighting parsed;
+  TEST_ASSERT_TRUE(weightingFromName("a", parsed));
+  TEST_ASSERT_EQUAL_UINT8(WEIGHTING_A, parsed);
+  TEST_ASSERT_FALSE(weightingFromName("AA", parsed));
+  TEST_ASSERT_FALSE(weightingFromName("", parsed));
+  TEST_ASSERT_FALSE(weightingFromName(nullptr, parsed));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_a_class1);
+  RUN_TEST(test_c_class1);
+  RUN_TEST(test_a_analytic_to_7k5);
+  RUN_TEST(test_c_analytic_to_7k5);
+  RUN_TEST(test_unity_gain_at_1k);
+  RUN_TEST(test_z_is_empty);
+  RUN_TEST(test_names_round_trip);
+  return UNITY_END();
+}
@@ -0,0 +1,72 @@
+// The weighting designs built for 48 kHz: K against the coefficients published
+// in ITU-R BS.1770, and A and C against the full IEC 61672-1 class 1 table.
+//   pio test -e native -f test_weighting_48k
+
+#define SAMPLE_RATE 48000
+
+#include <stdio.h>
+#include <unity.h>
+
+#include "../../src/weighting.cpp"
+#include "../test_weighting/iec61672.h"
+
+// BS.1770-4 Tables 1 and 2 (48 kHz).
+static const double SHELF_B[3] = {1.53512485958697, -2.69169618940638, 1.19839281085285};
+static const double SHELF_A[2] = {-1.69065929318241, 0.73248077421585};
+static const double RLB_B[3] = {1.0, -2.0, 1.0};
+static const double RLB_A[2] = {-1.99004745483398, 0.99007225036621};
+
+void setUp() {}
+void tearDown() {}
+
+void test_k_matches_bs1770() {
+  uint8_t n;
+  const Biquad *k = weightingSections(WEIGHTING_K, n);
+  TEST_ASSERT_EQUAL_UINT8(2, n);
+
+  // The firmware folds its 0 dB-at-1 kHz gain into the shelf numerator: the
+  // same factor on every tap, equal to the published cascade's loss at 1 kHz.
+  const double g = k[0].b0 / SHELF_B[0];
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, SHELF_B[1] * g, k[0].b1);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, SHELF_B[2] * g, k[0].b2);
+  const Biquad published[2] = {
+      {(float)SHELF_B[0], (float)SHELF_B[1], (float)SHELF_B[2], (float)SHELF_A[0], (float)SHELF_A[1]},
+      {(float)RLB_B[0], (float)RLB_B[1], (float)RLB_B[2], (float)RLB_A[0], (float)RLB_A[1]},
+  };
+  const double gainDb = cascadeDb(published, 2, 1000, 48000);
+  TEST_ASSERT_FLOAT_WITHIN(0.001, -gainDb, 20 * log10(g));
+  // That is the -0.691 dB offset of the loudness formula, to its rounding.
+  TEST_ASSERT_FLOAT_WITHIN(0.01, -0.691, 20 * log10(g));
+
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, SHELF_A[0], k[0].a1);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, SHELF_A[1], k[0].a2);
+
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, RLB_B[0], k[1].b0);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, RLB_B[1], k[1].b1);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, RLB_B[2], k[1].b2);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, RLB_A[0], k[1].a1);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, RLB_A[1], k[1].a2);
+}
+
+static void checkClass1(Weighting w) {
+  uint8_t n;
+  const Biquad *s = weightingSections(w, n);
+  TEST_ASSERT_NOT_NULL(s);
+  char msg[96];
+  for (const WeightingPoint &p : IEC61672) {
+    double err = cascadeDb(s, n, p.hz, 48000) - (w == WEIGHTING_A ? p.a : p.c);
+    snprintf(msg, sizeof(msg), "%s at %g Hz: %+.2f dB off the table", weightingName(w), p.hz, err);
+    TEST_ASSERT_TRUE_MESSAGE(err <= p.upper && err >= p.lower, msg);
+  }
+}
+
+void test_a_class1() { checkClass1(WEIGHTING_A); }
+void test_c_class1() { checkClass1(WEIGHTING_C); }
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_k_matches_bs1770);
+  RUN_TEST(test_a_class1);
+  RUN_TEST(test_c_class1);
+  return UNITY_END();
+}
@@ -0,0 +1,162 @@
+// Binary delta ("AVD1") between two firmware images, applied on the device by
+// firmware/src/delta.cpp. See delta.h there for the wire format.
+//
+// The diff is bsdiff-flavoured: a point release shifts code around, so most of
+// the new image is the old one at some offset with a few bytes changed (moved
+// call targets, literal pools). Such regions become ADD ops whose diff bytes are
+// nearly all zero, which deflate then squeezes to almost nothing. Bytes with no
+// usable match in the old image are sent verbatim as INSERT ops.
+
+import { createHash } from "crypto";
+import { deflateRawSync, inflateRawSync } from "zlib";
+
+const MAGIC = "AVD1";
+const HEADER_SIZE = 76;
+const OP_END = 0;
+const OP_COPY = 1;
+const OP_ADD = 2;
+const OP_INSERT = 3;
+
+const SEED = 16; // exact match needed to start a region
+const TABLE_BITS = 22;
+const GIVE_UP = 128; // stop extending after this many bytes without improvement
+
+function sha256(buf) {
+  return createHash("sha256").update(buf).digest();
+}
+
+function seedHash(buf, i) {
+  let h = 0x811c9dc5;
+  for (let k = 0; k < SEED; k += 4) h = Math.imul(h ^ buf.readUInt32LE(i + k), 0x01000193);
+  return (h ^ (h >>> 15)) >>> (32 - TABLE_BITS);
+}
+
+function seedEqual(a, ai, b, bi) {
+  for (let k = 0; k < SEED; k++) if (a[ai + k] !== b[bi + k]) return false;
+  return true;
+}
+
+/** Build an AVD1 patch that turns `source` into `target`. */
+export function makeDelta(source, target) {
+  // First occurrence of every SEED-byte window in the source.
+  const table = new Int32Array(1 << TABLE_BITS).fill(-1);
+  for (let i = 0; i + SEED <= source.length; i++) {
+    const h = seedHash(source, i);
+    if (table[h] < 0) table[h] = i;
+  }
+
+  const ops = [];
+  const u32 = (v) => {
+    const b = Buffer.alloc(4);
+    b.writeUInt32LE(v);
+    return b;
+  };
+  const emitInsert = (from, to) => {
+    if (to > from) ops.push(Buffer.from([OP_INSERT]), u32(to - from), target.subarray(from, to));
+  };
+
+  let i = 0;
+  let litStart = 0;
+  let lastDelta = 0;
+  while (i + SEED <= target.length) {
+    // Prefer continuing the previous alignment; otherwise look the seed up.
+    let s = i + lastDelta;
+    if (s < 0 || s + SEED > source.length || !seedEqual(source, s, target, i)) {
+      s = table[seedHash(target, i)];
+      if (s < 0 || !seedEqual(source, s, target, i)) {
+        i++;
+        continue;
+      }
+    }
+
+    // Extend while more than half the bytes match (score = 2*matches - length).
+    let matches = 0;
+    let best = 0;
+    let bestScore = 0;
+    let exact = true;
+    let exactUpTo = 0;
+    for (let k = 0; s + k < source.length && i + k < target.length; k++) {
+      if (source[s + k] === target[i + k]) matches++;
+      else if (exact) {
+        exact = false;
+        exactUpTo = k;
+      }
+      const score = 2 * matches - (k + 1);
+      if (score > bestScore) {
+        bestScore = score;
+        best = k + 1;
+      } else if (k + 1 - best > GIVE_UP) break;
+    }
+
+    emitInsert(litStart, i);
+    const allSame = exact || exactUpTo >= best;
+    if (allSame) {
+      ops.push(Buffer.from([OP_COPY]), u32(s), u32(best));
+    } else {
+      const diff = Buffer.alloc(best);
+      for (let k = 0; k < best; k++) diff[k] = (target[i + k] - source[s + k]) & 0xff;
+      ops.push(Buffer.from([OP_ADD]), u32(s), u32(best), diff);
+    }
+    lastDelta = s - i;
+    i += best;
+    litStart = i;
+  }
+  emitInsert(litStart, target.length);
+  ops.push(Buffer.from([OP_END]));
+
+  const header = Buffer.alloc(HEADER_SIZE);
+  header.write(MAGIC, 0, "latin1");
+  header.writeUInt32LE(source.length, 4);
+  header.writeUInt32LE(target.length, 8);
+  sha256(source).copy(header, 12);
+  sha256(target).copy(header, 44);
+  return Buffer.concat([header, deflateRawSync(Buffer.concat(ops), { level: 9 })]);
+}
+
+/** Apply an AVD1 patch exactly as the device does. Throws on any inconsistency. */
+export function applyDelta(source, patch) {
+  if (patch.length <= HEADER_SIZE || patch.toString("latin1", 0, 4) !== MAGIC) {
+    throw new Error("bad patch header");
+  }
+  const srcSize = patch.readUInt32LE(4);
+  const dstSize = patch.readUInt32LE(8);
+  if (srcSize !== source.length || !sha256(source).equals(patch.subarray(12, 44))) {
+    throw new Error("source image does not match patch");
+  }
+
+  const body = inflateRawSync(patch.subarray(HEADER_SIZE));
+  const out = Buffer.alloc(dstSize);
+  let p = 0;
+  let w = 0;
+  for (;;) {
+    const op = body[p++];
+    if (op === OP_END) break;
+    let off = 0;
+    if (op === OP_COPY || op === OP_ADD) {
+      off = body.readUInt32LE(p);
+      p += 4;
+    } else if (op !== OP_INSERT) {
+      throw new Error(`bad op ${op} at ${p - 1}`);
+    }
+    const len = body.readUInt32LE(p);
+    p += 4;
+    if (w + len > dstSize || (op !== OP_INSERT && off + len > srcSize)) {
+      throw new Error("op out of range");
+    }
+    if (op === OP_INSERT) {
+      body.copy(out, w, p, p + len);
+      p += len;
+    } else {
+      source.copy(out, w, off, off + len);
+      if (op === OP_ADD) {
+        for (let k = 0; k < len; k++) out[w + k] = (out[w + k] + body[p + k]) & 0xff;
+        p += len;
+      }
+    }
+    w += len;
+  }
+  if (w !== dstSize || !sha256(out).equals(patch.subarray(44, 76))) {
+    throw new Error("rebuilt image hash mismatch");
+  }
+  return out;
+}
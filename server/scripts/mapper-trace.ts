@@ -0,0 +1,142 @@
+// Replays a firmware trace through the server's VolumeMapper and checks that
+// the device's own control loop (firmware/src/mapper.cpp) made the same calls.
+//
+// Usage:
+//   npx tsx scripts/mapper-trace.ts zones.json trace.txt
+//
+// zones.json is a JSON array of ZoneConfig rows. trace.txt is the output of the
+// firmware's native replay harness run with the same zones:
+//   .pio/build/native/program --zones zones.json --out trace.txt recording.wav
+// It holds every reading the device sent ("sound_level" JSON or "bin1" frames)
+// and every volume_intent. Each reading is fed to VolumeMapper at its device
+// timestamp, with setVolume always succeeding, as the replay stand-in acks
+// every intent. Zones with a levelMetric get the percentiles last reported
+// with (or before) the reading, as in handleSoundLevel(). The (time, zone, volume) sequences must match exactly. Exits
+// non-zero on the first difference.
+
+import { readFileSync } from "fs";
+import { VolumeMapper, mapperInput, type Percentiles } from "../src/services/volume-mapper";
+import type { SoundtrackService } from "../src/services/soundtrack";
+
+interface ZoneConfigRow {
+  soundtrackZoneId: string;
+  isEnabled: boolean;
+  isPaused?: boolean;
+  minVolume: number;
+  maxVolume: number;
+  quietThresholdDb: number;
+  loudThresholdDb: number;
+  smoothingFactor: number;
+  sustainCount?: number;
+  levelMetric?: string;
+}
+
+interface Reading {
+  ms: number;
+  dbFS: number;
+  percentiles?: Percentiles;
+}
+
+interface Call {
+  ms: number;
+  zoneId: string;
+  volume: number;
+}
+
+// Device millis() starts near 0. The server's timers start at 0 meaning
+// "never", so put the trace far from the epoch.
+const EPOCH = 1_700_000_000_000;
+
+// bin1 section 5: per window { u16 seconds, i16 L10, i16 L50, i16 L90 (x 10) }
+function framePercentiles(buf: Buffer, off: number): Percentiles | undefined {
+  while (off + 2 <= buf.length) {
+    const [tag, len] = [buf[off], buf[off + 1]];
+    if (tag === 5) {
+      const p: Percentiles = {};
+      for (let w = off + 2; w + 8 <= off + 2 + len; w += 8) {
+        p[buf.readUInt16LE(w)] = [1, 2, 3].map((k) => buf.readInt16LE(w + k * 2) / 10);
+      }
+      return p;
+    }
+    off += 2 + len;
+  }
+  return undefined;
+}
+
+function parseTrace(text: string): { readings: Reading[]; intents: Call[] } {
+  const readings: Reading[] = [];
+  const intents: Call[] = [];
+  for (const line of text.split("\n")) {
+    const tab = line.indexOf("\t");
+    if (tab < 0) continue;
+    const ms = Number(line.slice(0, tab));
+    const body = line.slice(tab + 1);
+    if (body.startsWith("bin ")) {
+      // bin1: u8 version, u8 count, u8 weighting, u8 reserved, u32 t0, count x { u16 dt, i16 db x 10 }
+      const buf = Buffer.from(body.slice(4), "hex");
+      const t0 = buf.readUInt32LE(4);
+      for (let i = 0; i < buf[1]; i++) {
+        readings.push({ ms: t0 + buf.readUInt16LE(8 + i * 4), dbFS: buf.readInt16LE(10 + i * 4) / 10 });
+      }
+      // Sections describe the frame's last reading.
+      readings[readings.length - 1].percentiles = framePercentiles(buf, 8 + buf[1] * 4);
+      continue;
+    }
+    const msg = JSON.parse(body);
+    if (msg.type === "sound_level") readings.push({ ms, dbFS: msg.dbFS, percentiles: msg.percentiles });
+    if (msg.type === "volume_intent") intents.push({ ms, zoneId: msg.zoneId, volume: msg.volume });
+  }
+  return { readings, intents };
+}
+
+async function main(): Promise<void> {
+  const [zonesPath, tracePath] = process.argv.slice(2);
+  if (!zonesPath || !tracePath) {
+    console.error("usage: npx tsx scripts/mapper-trace.ts zones.json trace.txt");
+    process.exit(2);
+  }
+  const zones: ZoneConfigRow[] = JSON.parse(readFileSync(zonesPath, "utf8"));
+  const { readings, intents } = parseTrace(readFileSync(tracePath, "utf8"));
+
+  let now = EPOCH;
+  Date.now = () => now;
+  const calls: Call[] = [];
+  const soundtrack = {
+    setVolume: async (zoneId: string, volume: number) => {
+      calls.push({ ms: now - EPOCH, zoneId, volume });
+    },
+  } as unknown as SoundtrackService;
+  const mapper = new VolumeMapper(soundtrack);
+
+  // Same filter and arguments as handleSoundLevel().
+  const active = zones.filter((z) => z.isEnabled && !z.isPaused);
+  let percentiles: Percentiles | undefined;
+  for (const r of readings) {
+    now = EPOCH + r.ms;
+    percentiles = r.percentiles ?? percentiles;
+    for (const z of active) {
+      await mapper.processReading(z.soundtrackZoneId, mapperInput(r.dbFS, z.levelMetric, percentiles), {
+        isEnabled: z.isEnabled,
+        minVolume: z.minVolume,
+        maxVolume: z.maxVolume,
+        quietThresholdDb: z.quietThresholdDb,
+        loudThresholdDb: z.loudThresholdDb,
+        smoothingFactor: z.smoothingFactor,
+        sustainThreshold: z.sustainCount ?? 2,
+      });
+    }
+  }
+
+  const fmt = (c?: Call) => (c ? `${c.ms} ms ${c.zoneId} -> ${c.volume}` : "(none)");
+  for (let i = 0; i < Math.max(calls.length, intents.length); i++) {
+    const a = calls[i];
+    const b = intents[i];
+    if (!a || !b || a.ms !== b.ms || a.zoneId !== b.zoneId || a.volume !== b.volume) {
+      console.error(`[trace] mismatch at call ${i + 1}: server ${fmt(a)}, device ${fmt(b)}`);
+      process.exit(1);
+    }
+  }
+  console.log(`[trace] ${readings.length} readings, ${zones.length} zones: ${calls.length} volume changes, identical`);
+}
+
+main();
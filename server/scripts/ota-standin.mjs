@@ -0,0 +1,129 @@
+#!/usr/bin/env node
+// Local stand-in for the firmware host that drops connections on purpose, for
+// exercising the resumable OTA downloader (firmware/src/download.cpp).
+//
+// Usage:
+//   node scripts/ota-standin.mjs [port]            serve public/firmware/ over HTTP
+//   node scripts/ota-standin.mjs --check [port]    also run a host-side client that
+//                                                  downloads like the device does
+//
+// Environment:
+//   DROP_RATE   probability (0..1) that a response is cut short   (default 0.3)
+//
+// The server honours single "bytes=a-b" Range requests and serves
+// /api/firmware/version with its urls rewritten to point here. Devices fetch the
+// manifest over https from their configured host, so to test on hardware, publish
+// with OTA_HOST=http://<this-machine>:<port> and let the manifest's url lead the
+// device here. --check downloads firmware.bin in OTA_CHUNK_SIZE ranges, resuming
+// after every injected drop. It hashes incrementally, compares the result with
+// the manifest sha256, and exits non-zero on mismatch.
+
+import http from "http";
+import { createHash } from "crypto";
+import { readFileSync } from "fs";
+import { fileURLToPath } from "url";
+import { dirname, join, normalize } from "path";
+
+const __dirname = dirname(fileURLToPath(import.meta.url));
+const FW_DIR = join(__dirname, "..", "public", "firmware");
+const CHUNK = 65536; // keep in step with OTA_CHUNK_SIZE in firmware/src/config.h
+
+const args = process.argv.slice(2);
+const check = args.includes("--check");
+const port = Number(args.find((a) => /^\d+$/.test(a)) || 8089);
+const dropRate = Number(process.env.DROP_RATE ?? 0.3);
+const base = `http://127.0.0.1:${port}`;
+
+const server = http.createServer((req, res) => {
+  if (req.url === "/api/firmware/version") {
+    const manifest = JSON.parse(readFileSync(join(FW_DIR, "version.json"), "utf8"));
+    const local = (u) => u && `${base}/firmware/${u.split("/firmware/")[1]}`;
+    manifest.url = local(manifest.url);
+    for (const d of manifest.deltas ?? []) d.url = local(d.url);
+    res.setHeader("Content-Type", "application/json");
+    return res.end(JSON.stringify(manifest));
+  }
+
+  const rel = normalize(decodeURIComponent(req.url.split("?")[0])).replace(/^\/firmware\//, "");
+  let body;
+  try {
+    if (rel.includes("..")) throw new Error("bad path");
+    body = readFileSync(join(FW_DIR, rel));
+  } catch {
+    res.statusCode = 404;
+    return res.end();
+  }
+
+  let start = 0;
+  let end = body.length - 1;
+  const m = /^bytes=(\d+)-(\d*)$/.exec(req.headers.range ?? "");
+  if (m) {
+    start = Number(m[1]);
+    end = m[2] ? Math.min(Number(m[2]), end) : end;
+    if (start > end) {
+      res.statusCode = 416;
+      return res.end();
+    }
+    res.statusCode = 206;
+    res.setHeader("Content-Range", `bytes ${start}-${end}/${body.length}`);
+  }
+  res.setHeader("Content-Length", end - start + 1);
+  res.setHeader("Accept-Ranges", "bytes");
+
+  const slice = body.subarray(start, end + 1);
+  if (Math.random() < dropRate) {
+    const cut = Math.floor(Math.random() * slice.length);
+    console.log(`[standin] ${req.headers.range ?? "full"}: dropping after ${cut} bytes`);
+    res.write(slice.subarray(0, cut), () => req.socket.destroy());
+    return;
+  }
+  console.log(`[standin] ${req.headers.range ?? "full"}: ${slice.length} bytes`);
+  res.end(slice);
+});
+
+// Mirror of downloadImage(): sector-granular checkpoints, resume from the last one.
+async function runCheck() {
+  const manifest = await (await fetch(`${base}/api/firmware/version`)).json();
+  const { size, sha256 } = manifest;
+  const sha = createHash("sha256");
+  let off = 0;
+  let drops = 0;
+  let requests = 0;
+  while (off < size) {
+    const end = Math.min(off + CHUNK, size) - 1;
+    requests++;
+    try {
+      const res = await fetch(manifest.url, { headers: { Range: `bytes=${off}-${end}` } });
+      if (res.status !== 206) throw new Error(`HTTP ${res.status}`);
+      const reader = res.body.getReader();
+      let pending = Buffer.alloc(0);
+      for (;;) {
+        const { done, value } = await reader.read();
+        if (done) break;
+        pending = Buffer.concat([pending, value]);
+        // Commit whole sectors only, like the device does.
+        const whole = off + pending.length > end ? pending.length : pending.length & ~4095;
+        sha.update(pending.subarray(0, whole));
+        off += whole;
+        pending = pending.subarray(whole);
+      }
+      if (off <= end) throw new Error("short body");
+    } catch {
+      drops++;
+    }
+  }
+  const digest = sha.digest("hex");
+  console.log(`[check] ${size} bytes in ${requests} requests (${drops} interrupted)`);
+  if (digest !== sha256) {
+    console.error(`[check] sha256 mismatch: got ${digest}, manifest ${sha256}`);
+    process.exitCode = 1;
+  } else {
+    console.log("[check] sha256 matches the manifest");
+  }
+  server.close();
+}
+
+server.listen(port, () => {
+  console.log(`[standin] serving ${FW_DIR} on ${base} (DROP_RATE=${dropRate})`);
+  if (check) runCheck();
+});
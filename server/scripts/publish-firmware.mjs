@@ -5,22 +5,41 @@
 //   node scripts/publish-firmware.mjs <version> ["release notes"]
 //
 // It copies the latest PlatformIO build into server/public/firmware/firmware.bin,
-// computes its md5/size, and writes version.json. Commit server/public/firmware/
-// and push — Render serves the new manifest + binary and devices on an older
-// version pick it up within their check interval (or immediately via "ota_check").
+// computes its md5/sha256/size, and writes version.json. Commit server/public/firmware/
+// and server/firmware-archive/, then push — Render serves the new manifest + binary
+// and devices on an older version pick it up within their check interval (or
+// immediately via "ota_check").
+//
+// Every published image is archived in server/firmware-archive/<version>.bin, and a
+// delta patch (firmware-delta.mjs) is generated from each of the last DELTA_HISTORY
+// releases. Devices running one of those exact images download the patch instead
+// of the full binary; anything else (or a failed patch) falls back to firmware.bin.
+// Each patch is applied here and checked byte for byte before it is published.
 //
 // IMPORTANT: <version> must match the FW_VERSION you compiled into the .bin, and
 // must be HIGHER than the version running on the devices you want to update.
 
 import { createHash } from "crypto";
-import { readFileSync, writeFileSync, copyFileSync, mkdirSync, existsSync } from "fs";
+import {
+  readFileSync,
+  writeFileSync,
+  copyFileSync,
+  mkdirSync,
+  existsSync,
+  readdirSync,
+  rmSync,
+} from "fs";
 import { fileURLToPath } from "url";
 import { dirname, join } from "path";
+import { makeDelta, applyDelta } from "./firmware-delta.mjs";
 
 const __dirname = dirname(fileURLToPath(import.meta.url));
 const serverRoot = join(__dirname, "..");
 const BIN_SRC = join(serverRoot, "..", "firmware", ".pio", "build", "esp32s3", "firmware.bin");
 const OUT_DIR = join(serverRoot, "public", "firmware");
+const DELTA_DIR = join(OUT_DIR, "delta");
+const ARCHIVE_DIR = join(serverRoot, "firmware-archive");
+const DELTA_HISTORY = 3; // previous releases that get a patch (older ones are pruned)
 const HOST = process.env.OTA_HOST || "https://soundtrack-auto-volume.onrender.com";
 
 const version = process.argv[2];
@@ -37,20 +56,83 @@ if (!existsSync(BIN_SRC)) {
   process.exit(1);
 }
 
+const semver = (v) => v.split(/[.-]/).slice(0, 3).map(Number);
+const compareVersions = (a, b) => {
+  const [x, y] = [semver(a), semver(b)];
+  for (let i = 0; i < 3; i++) if (x[i] !== y[i]) return x[i] - y[i];
+  return 0;
+};
+
 mkdirSync(OUT_DIR, { recursive: true });
+mkdirSync(ARCHIVE_DIR, { recursive: true });
+
+// Archive the image being replaced if it predates the archive.
+const prevManifestPath = join(OUT_DIR, "version.json");
+const prevBinPath = join(OUT_DIR, "firmware.bin");
+if (existsSync(prevManifestPath) && existsSync(prevBinPath)) {
+  const prev = JSON.parse(readFileSync(prevManifestPath, "utf8"));
+  const archived = join(ARCHIVE_DIR, `${prev.version}.bin`);
+  if (prev.available && prev.version !== version && !existsSync(archived)) {
+    copyFileSync(prevBinPath, archived);
+  }
+}
+
 const bin = readFileSync(BIN_SRC);
 const md5 = createHash("md5").update(bin).digest("hex");
+const sha256 = createHash("sha256").update(bin).digest("hex");
 copyFileSync(BIN_SRC, join(OUT_DIR, "firmware.bin"));
+copyFileSync(BIN_SRC, join(ARCHIVE_DIR, `${version}.bin`));
+
+// Patches from the most recent older releases. Rebuilt from scratch every time.
+const older = readdirSync(ARCHIVE_DIR)
+  .filter((f) => f.endsWith(".bin"))
+  .map((f) => f.slice(0, -4))
+  .filter((v) => /^\d+\.\d+\.\d+/.test(v) && compareVersions(v, version) < 0)
+  .sort(compareVersions)
+  .reverse();
+for (const stale of older.slice(DELTA_HISTORY)) {
+  rmSync(join(ARCHIVE_DIR, `${stale}.bin`));
+  console.log(`Pruned archived ${stale} (older than the last ${DELTA_HISTORY} releases)`);
+}
+
+rmSync(DELTA_DIR, { recursive: true, force: true });
+mkdirSync(DELTA_DIR, { recursive: true });
+const deltas = [];
+for (const from of older.slice(0, DELTA_HISTORY)) {
+  const source = readFileSync(join(ARCHIVE_DIR, `${from}.bin`));
+  const patch = makeDelta(source, bin);
+  if (!applyDelta(source, patch).equals(bin)) {
+    console.error(`Delta ${from} -> ${version} does not reproduce the image — not publishing`);
+    process.exit(1);
+  }
+  if (patch.length > bin.length / 2) {
+    console.log(`Skipping delta from ${from}: ${patch.length} bytes is not worth it`);
+    continue;
+  }
+  const name = `${from}-to-${version}.avd`;
+  writeFileSync(join(DELTA_DIR, name), patch);
+  deltas.push({
+    from,
+    url: `${HOST}/firmware/delta/${name}`,
+    size: patch.length,
+    sha256: createHash("sha256").update(patch).digest("hex"),
+  });
+  console.log(`Delta ${from} -> ${version}: ${(patch.length / 1024).toFixed(1)} KB (verified)`);
+}
 
 const manifest = {
   version,
   url: `${HOST}/firmware/firmware.bin`,
   md5,
+  sha256,
   size: bin.length,
+  deltas,
   notes,
   available: true,
 };
 writeFileSync(join(OUT_DIR, "version.json"), JSON.stringify(manifest, null, 2) + "\n");
 
 console.log(`Published firmware ${version}  (${(bin.length / 1024).toFixed(0)} KB, md5 ${md5})`);
-console.log("Next: git add server/public/firmware && git commit && git push  (Render auto-deploys)");
+console.log(
+  "Next: git add server/public/firmware server/firmware-archive && git commit && git push  (Render auto-deploys)",
+);
@@ -0,0 +1,172 @@
+// Exercises the loudness history (src/services/timeseries.ts) against a local
+// Postgres: seeds synthetic devices, feeds them a week of readings and volume
+// decisions through TimeSeries, checks the stored rollups against values
+// computed here, checks retention, and times the dashboard's history query.
+//
+// Usage (a scratch database; the schema is pushed first):
+//   export DATABASE_URL=postgresql://localhost:5432/autovolume_check
+//   npx prisma db push --skip-generate
+//   npx tsx scripts/timeseries-check.ts [--devices 100] [--days 7] [--per-min 6] [--deadband 3] [--keep]
+//
+// Readings are taken --per-min per minute (a live device sends up to 120; the
+// rollup row count, which the query cost depends on, is the same) and sent on
+// delta like the firmware's: when the level moved --deadband dB from the last
+// sent one (0 = every reading), or after the default 30 s heartbeat. The seeded
+// devices are deleted at the end unless --keep. Exits non-zero on a mismatch.
+
+import { prisma } from "../src/db";
+import { TimeSeries, ROLLUP_TIERS, historyTier, queryHistory } from "../src/services/timeseries";
+
+const args = process.argv.slice(2);
+const arg = (name: string, def: number) => {
+  const i = args.indexOf(name);
+  return i >= 0 ? Number(args[i + 1]) : def;
+};
+const DEVICES = arg("--devices", 100);
+const DAYS = arg("--days", 7);
+const PER_MIN = arg("--per-min", 6);
+const DEADBAND = arg("--deadband", 3);
+const HEARTBEAT_MS = 30000; // Device.reportHeartbeatS default
+const KEEP = args.includes("--keep");
+const PREFIX = "ts-check-";
+
+// Deterministic level for device d at time t: an evening curve plus noise.
+function level(d: number, t: number): number {
+  const hour = (t / 3600000) % 24;
+  const noise = Math.sin(t * 0.0137 + d * 7.1) * 4 + Math.sin(t * 0.00071 + d) * 2;
+  return Math.round((-70 + 18 * Math.max(0, Math.sin(((hour - 14) / 12) * Math.PI)) + noise) * 10) / 10;
+}
+
+let failures = 0;
+function check(what: string, got: number, want: number, tolerance = 1e-6): void {
+  if (Math.abs(got - want) > tolerance) {
+    failures++;
+    console.error(`MISMATCH ${what}: got ${got}, want ${want}`);
+  }
+}
+
+async function main(): Promise<void> {
+  await prisma.device.deleteMany({ where: { deviceId: { startsWith: PREFIX } } });
+  const devices = [];
+  for (let d = 0; d < DEVICES; d++) {
+    devices.push(
+      await prisma.device.create({
+        data: {
+          deviceId: `${PREFIX}${d}`,
+          configs: { create: { soundtrackAccountId: "ts-check", soundtrackZoneId: `${PREFIX}zone-${d}` } },
+        },
+        include: { configs: true },
+      })
+    );
+  }
+
+  const ts = new TimeSeries();
+  const end = Math.floor(Date.now() / 900000) * 900000;
+  const start = end - DAYS * 86400000;
+  const step = 60000 / PER_MIN;
+  const lastSent = devices.map(() => ({ db: NaN, t: -Infinity }));
+  const sent0: { db: number; t: number }[] = []; // device 0's, for the expected rollups
+  let fed = 0;
+  let t0 = performance.now();
+  for (let t = start; t < end; t += step) {
+    for (let d = 0; d < DEVICES; d++) {
+      const db = level(d, t);
+      const last = lastSent[d];
+      if (!(Math.abs(db - last.db) < DEADBAND) || t - last.t >= HEARTBEAT_MS) {
+        ts.addLevel(devices[d].deviceId, db, new Date(t));
+        last.db = db;
+        last.t = t;
+        if (d === 0) sent0.push({ db, t });
+        fed++;
+      }
+      // A volume decision every 5 minutes.
+      if (t % 300000 === 0) ts.addVolume(devices[d].configs[0].id, 4 + ((t / 300000 + d) % 9), new Date(t));
+    }
+    if (t % 3600000 === 0) await ts.flush(t); // as the timer would
+  }
+  await ts.flush(Infinity);
+  console.log(`fed ${fed} readings in ${((performance.now() - t0) / 1000).toFixed(1)} s`, ts.stats());
+
+  // One bucket per tier of device 0, recomputed from the same readings: each
+  // holds until the next one or for a heartbeat, and weighs its time in the
+  // bucket.
+  for (const tier of ROLLUP_TIERS) {
+    const bucket = end - 86400000; // a day ago: inside every tier's retention
+    const bucketEnd = bucket + tier.seconds * 1000;
+    const held: { db: number; ms: number }[] = [];
+    let count = 0;
+    for (let i = 0; i < sent0.length; i++) {
+      const { db, t } = sent0[i];
+      const until = Math.min(sent0[i + 1]?.t ?? Infinity, t + HEARTBEAT_MS);
+      const ms = Math.min(until, bucketEnd) - Math.max(t, bucket);
+      if (ms > 0) held.push({ db, ms });
+      if (t >= bucket && t < bucketEnd) count++;
+    }
+    held.sort((a, b) => b.db - a.db);
+    const heldMs = held.reduce((n, h) => n + h.ms, 0);
+    const row = await prisma.levelRollup.findUnique({
+      where: { deviceId_tierS_bucket: { deviceId: devices[0].deviceId, tierS: tier.seconds, bucket: new Date(bucket) } },
+    });
+    if (!row) {
+      failures++;
+      console.error(`MISSING ${tier.seconds} s bucket`);
+      continue;
+    }
+    const exceeded = (p: number) => {
+      let seen = 0;
+      return held.find((h) => (seen += h.ms) >= heldMs * p)!.db;
+    };
+    check(`${tier.seconds} s count`, row.count, count);
+    check(`${tier.seconds} s heldMs`, row.heldMs, heldMs);
+    check(`${tier.seconds} s min`, row.minDb, held[held.length - 1].db);
+    check(`${tier.seconds} s max`, row.maxDb, held[0].db);
+    check(`${tier.seconds} s mean`, row.meanDb, held.reduce((a, h) => a + h.db * h.ms, 0) / heldMs, 1e-9);
+    // Histogram percentiles: within a bin of the exact ones.
+    check(`${tier.seconds} s L10`, row.l10, exceeded(0.1), 0.5);
+    check(`${tier.seconds} s L50`, row.l50, exceeded(0.5), 0.5);
+    check(`${tier.seconds} s L90`, row.l90, exceeded(0.9), 0.5);
+  }
+
+  await ts.prune();
+  for (const tier of ROLLUP_TIERS) {
+    const oldest = await prisma.levelRollup.findFirst({
+      where: { tierS: tier.seconds, device: { deviceId: { startsWith: PREFIX } } },
+      orderBy: { bucket: "asc" },
+    });
+    const kept = Date.now() - tier.retentionDays * 86400000;
+    const rows = await prisma.levelRollup.count({ where: { tierS: tier.seconds } });
+    console.log(`tier ${tier.seconds} s: ${rows} rows, oldest ${oldest?.bucket.toISOString() ?? "-"}`);
+    if (oldest && oldest.bucket.getTime() < kept) {
+      failures++;
+      console.error(`RETENTION tier ${tier.seconds} s keeps ${oldest.bucket.toISOString()}`);
+    }
+  }
+
+  // The dashboard's query: the last week of every seeded device.
+  const from = new Date(end - 7 * 86400000);
+  const to = new Date(end);
+  const tierS = historyTier(from, to);
+  const ids = devices.map((d) => d.deviceId);
+  for (let run = 0; run < 3; run++) {
+    t0 = performance.now();
+    const history = await queryHistory(ids, from, to, tierS);
+    const points = history.reduce((n, h) => n + h.levels.length + h.zones.reduce((m, z) => m + z.volumes.length, 0), 0);
+    console.log(
+      `history: ${history.length} devices x 7 days at ${tierS} s, ${points} points in ${(performance.now() - t0).toFixed(0)} ms`
+    );
+  }
+
+  if (!KEEP) await prisma.device.deleteMany({ where: { deviceId: { startsWith: PREFIX } } });
+  await prisma.$disconnect();
+  if (failures > 0) {
+    console.error(`${failures} mismatch(es)`);
+    process.exit(1);
+  }
+  console.log("OK");
+}
+
+main().catch(async (err) => {
+  console.error(err);
+  await prisma.$disconnect();
+  process.exit(1);
+});
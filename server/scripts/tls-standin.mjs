@@ -0,0 +1,182 @@
+#!/usr/bin/env node
+// Local TLS stand-in for the device host, for exercising the firmware's TLS
+// session cache (firmware/src/tls.cpp) and timing its handshakes.
+//
+// Usage:
+//   node scripts/tls-standin.mjs [port]            serve over HTTPS (TLS 1.2)
+//   node scripts/tls-standin.mjs --check [port]    also run a host-side client that
+//                                                  reconnects like the device does
+//
+// Environment:
+//   TLS_CERT, TLS_KEY   PEM files to serve with (default: a throwaway self-signed
+//                       pair made with openssl)
+//
+// Every TLS connection is logged as "full" or "resumed"; the device logs its
+// side with timing ("[tls] host: resumed handshake in N ms"). The server serves
+// /api/firmware/version (urls rewritten to point here) and public/firmware/,
+// and accepts the /ws upgrade far enough to answer "register" with
+// "registered" and print the device's "tls" stats. To test on
+// hardware, build the firmware with -DDEFAULT_WS_HOST=\"<this-machine>\"
+// -DWS_PORT=<port>: the websocket, the OTA check and the download then all
+// land here. --check connects five times, offering the previous session each
+// time, and exits non-zero unless every reconnect resumed.
+
+import https from "https";
+import tls from "tls";
+import { createHash } from "crypto";
+import { execFileSync } from "child_process";
+import { mkdtempSync, readFileSync } from "fs";
+import { tmpdir } from "os";
+import { fileURLToPath } from "url";
+import { dirname, join, normalize } from "path";
+
+const __dirname = dirname(fileURLToPath(import.meta.url));
+const FW_DIR = join(__dirname, "..", "public", "firmware");
+const WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+const args = process.argv.slice(2);
+const check = args.includes("--check");
+const port = Number(args.find((a) => /^\d+$/.test(a)) || 8443);
+const base = `https://127.0.0.1:${port}`;
+
+function credentials() {
+  if (process.env.TLS_CERT && process.env.TLS_KEY) {
+    return { cert: readFileSync(process.env.TLS_CERT), key: readFileSync(process.env.TLS_KEY) };
+  }
+  const dir = mkdtempSync(join(tmpdir(), "tls-standin-"));
+  execFileSync("openssl", [
+    "req", "-x509", "-newkey", "ec", "-pkeyopt", "ec_paramgen_curve:prime256v1", "-nodes",
+    "-keyout", join(dir, "key.pem"), "-out", join(dir, "cert.pem"), "-days", "1", "-subj", "/CN=tls-standin",
+  ], { stdio: "ignore" });
+  return { cert: readFileSync(join(dir, "cert.pem")), key: readFileSync(join(dir, "key.pem")) };
+}
+
+// The device speaks TLS 1.2 only (see tls.cpp), so resumption here means
+// session tickets / ids, the same mechanism it uses.
+const server = https.createServer({ ...credentials(), maxVersion: "TLSv1.2" }, (req, res) => {
+  if (req.url === "/api/firmware/version") {
+    const manifest = JSON.parse(readFileSync(join(FW_DIR, "version.json"), "utf8"));
+    const local = (u) => u && `${base}/firmware/${u.split("/firmware/")[1]}`;
+    manifest.url = local(manifest.url);
+    for (const d of manifest.deltas ?? []) d.url = local(d.url);
+    res.setHeader("Content-Type", "application/json");
+    return res.end(JSON.stringify(manifest));
+  }
+
+  const rel = normalize(decodeURIComponent(req.url.split("?")[0])).replace(/^\/firmware\//, "");
+  let body;
+  try {
+    if (rel.includes("..")) throw new Error("bad path");
+    body = readFileSync(join(FW_DIR, rel));
+  } catch {
+    res.statusCode = 404;
+    return res.end();
+  }
+  let start = 0;
+  let end = body.length - 1;
+  const m = /^bytes=(\d+)-(\d*)$/.exec(req.headers.range ?? "");
+  if (m) {
+    start = Number(m[1]);
+    end = m[2] ? Math.min(Number(m[2]), end) : end;
+    res.statusCode = 206;
+    res.setHeader("Content-Range", `bytes ${start}-${end}/${body.length}`);
+  }
+  res.setHeader("Content-Length", end - start + 1);
+  res.end(body.subarray(start, end + 1));
+});
+
+const stats = { full: 0, resumed: 0 };
+
+server.prependListener("secureConnection", (socket) => {
+  const kind = socket.isSessionReused() ? "resumed" : "full";
+  stats[kind]++;
+  console.log(`[standin] ${socket.remoteAddress}: ${kind} handshake (${stats.full} full, ${stats.resumed} resumed)`);
+});
+
+// --- Just enough websocket for register / registered ---
+
+function wsSend(socket, text) {
+  const payload = Buffer.from(text);
+  const header = payload.length < 126
+    ? Buffer.from([0x81, payload.length])
+    : Buffer.from([0x81, 126, payload.length >> 8, payload.length & 0xff]);
+  socket.write(Buffer.concat([header, payload]));
+}
+
+function wsFrames(socket, onText) {
+  let buf = Buffer.alloc(0);
+  socket.on("data", (chunk) => {
+    buf = Buffer.concat([buf, chunk]);
+    for (;;) {
+      if (buf.length < 2) return;
+      const opcode = buf[0] & 0x0f;
+      const masked = buf[1] & 0x80;
+      let len = buf[1] & 0x7f;
+      let off = 2;
+      if (len === 126) {
+        if (buf.length < 4) return;
+        len = buf.readUInt16BE(2);
+        off = 4;
+      } else if (len === 127) {
+        if (buf.length < 10) return;
+        len = Number(buf.readBigUInt64BE(2));
+        off = 10;
+      }
+      const mask = masked ? buf.subarray(off, off + 4) : null;
+      if (masked) off += 4;
+      if (buf.length < off + len) return;
+      const payload = Buffer.from(buf.subarray(off, off + len));
+      if (mask) for (let i = 0; i < payload.length; i++) payload[i] ^= mask[i & 3];
+      buf = buf.subarray(off + len);
+      if (opcode === 0x1) onText(payload.toString());
+      else if (opcode === 0x8) return socket.end();
+      else if (opcode === 0x9) socket.write(Buffer.concat([Buffer.from([0x8a, payload.length]), payload]));
+    }
+  });
+}
+
+server.on("upgrade", (req, socket) => {
+  if (!req.url.startsWith("/ws")) return socket.destroy();
+  const accept = createHash("sha1").update(req.headers["sec-websocket-key"] + WS_GUID).digest("base64");
+  socket.write("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n" +
+    `Sec-WebSocket-Accept: ${accept}\r\n\r\n`);
+  wsFrames(socket, (text) => {
+    let msg;
+    try {
+      msg = JSON.parse(text);
+    } catch {
+      return;
+    }
+    if (msg.type !== "register") return;
+    console.log(`[standin] register from ${msg.deviceId}: tls ${JSON.stringify(msg.tls ?? {})}`);
+    wsSend(socket, JSON.stringify({ type: "registered" }));
+  });
+});
+
+// Reconnect like the device: offer the last connection's session each time.
+async function runCheck() {
+  const rounds = 5;
+  let session;
+  let resumed = 0;
+  for (let i = 0; i < rounds; i++) {
+    const t0 = process.hrtime.bigint();
+    const socket = tls.connect({ host: "127.0.0.1", port, rejectUnauthorized: false, session, maxVersion: "TLSv1.2" });
+    socket.on("session", (s) => (session = s));
+    await new Promise((resolve, reject) => socket.once("secureConnect", resolve).once("error", reject));
+    const ms = Number(process.hrtime.bigint() - t0) / 1e6;
+    const reused = socket.isSessionReused();
+    if (reused) resumed++;
+    console.log(`[check] connect ${i + 1}: ${reused ? "resumed" : "full"} in ${ms.toFixed(1)} ms`);
+    // A request on each connection, so the session ticket has arrived before we close.
+    socket.write("GET /api/firmware/version HTTP/1.1\r\nHost: standin\r\nConnection: close\r\n\r\n");
+    await new Promise((resolve) => socket.on("data", () => {}).once("close", resolve));
+  }
+  console.log(`[check] ${resumed} of ${rounds - 1} reconnects resumed`);
+  if (resumed !== rounds - 1) process.exitCode = 1;
+  server.close();
+}
+
+server.listen(port, () => {
+  console.log(`[standin] TLS 1.2 on ${base}`);
+  if (check) runCheck();
+});
@@ -6,7 +6,7 @@ import http from "http";
 import path from "path";
 import { prisma } from "./db";
 import { config } from "./config";
-import { setupWebSocket } from "./websocket/handler";
+import { setupWebSocket, deviceCache, writeBehind, timeSeries } from "./websocket/handler";
 import { deviceRoutes } from "./routes/devices";
 import { configRoutes } from "./routes/configs";
 import { soundtrackRoutes } from "./routes/soundtrack";
@@ -35,7 +35,13 @@ app.use(express.static(path.join(__dirname, "../public")));
 
 // Health check
 app.get("/health", (_req, res) => {
-  res.json({ status: "ok", timestamp: new Date().toISOString() });
+  res.json({
+    status: "ok",
+    timestamp: new Date().toISOString(),
+    writeBehind: writeBehind.stats(),
+    deviceCache: deviceCache.stats(),
+    timeSeries: timeSeries.stats(),
+  });
 });
 
 // API routes
@@ -97,8 +103,14 @@ function shutdown(signal: string) {
   if (shuttingDown) return;
   shuttingDown = true;
   console.log(`${signal} received — shutting down gracefully...`);
+  // Write the buffered device levels and history now; the failsafe below may
+  // exit before every socket has closed.
+  void writeBehind.stop();
+  void timeSeries.stop();
   server.close(() => {
-    prisma.$disconnect().finally(() => process.exit(0));
+    Promise.all([writeBehind.flush(), timeSeries.flush(Infinity)])
+      .finally(() => prisma.$disconnect())
+      .finally(() => process.exit(0));
   });
   // Failsafe: don't hang the platform's shutdown window.
   setTimeout(() => process.exit(0), 10000).unref();
@@ -1,6 +1,8 @@
 import { Router, Request } from "express";
 import { prisma } from "../db";
 import { requireAuth, requireAdmin, scopedAccountId, canAccessAccount } from "../auth";
+import { deviceCache, pushZoneConfigs } from "../websocket/handler";
+import { LEVEL_METRICS, type LevelMetric } from "../services/volume-mapper";
 
 export const configRoutes = Router();
 
@@ -46,6 +48,7 @@ async function assertZoneAccountMatchesDevice(
   }
   if (!dev.soundtrackAccountId) {
     await prisma.device.update({ where: { id: deviceUuid }, data: { soundtrackAccountId: accountId } });
+    deviceCache.invalidate(deviceUuid);
   }
   return null;
 }
@@ -58,6 +61,7 @@ async function assertZoneAccountMatchesDevice(
 const isNum = (v: any): v is number => typeof v === "number" && Number.isFinite(v);
 const clampInt = (v: number, lo: number, hi: number) => Math.max(lo, Math.min(hi, Math.round(v)));
 const clampNum = (v: number, lo: number, hi: number) => Math.max(lo, Math.min(hi, v));
+const isMetric = (v: any): v is LevelMetric => (LEVEL_METRICS as readonly string[]).includes(v);
 
 function sanitizeFull(b: any) {
   const minVolume = clampInt(isNum(b.minVolume) ? b.minVolume : 4, 0, 16);
@@ -68,7 +72,8 @@ function sanitizeFull(b: any) {
   if (loudThresholdDb <= quietThresholdDb) loudThresholdDb = Math.min(0, quietThresholdDb + 5);
   const smoothingFactor = clampNum(isNum(b.smoothingFactor) ? b.smoothingFactor : 0.2, 0.05, 0.95);
   const sustainCount = clampInt(isNum(b.sustainCount) ? b.sustainCount : 3, 1, 60);
-  return { minVolume, maxVolume, quietThresholdDb, loudThresholdDb, smoothingFactor, sustainCount };
+  const levelMetric = isMetric(b.levelMetric) ? b.levelMetric : "level";
+  return { minVolume, maxVolume, quietThresholdDb, loudThresholdDb, smoothingFactor, sustainCount, levelMetric };
 }
 
 function sanitizePartial(b: any): Record<string, number> {
@@ -112,6 +117,7 @@ configRoutes.post("/", requireAdmin, async (req, res) => {
       loudThresholdDb,
       smoothingFactor,
       sustainCount,
+      levelMetric,
     } = req.body;
 
     if (!deviceId || !soundtrackAccountId || !soundtrackZoneId) {
@@ -137,7 +143,9 @@ configRoutes.post("/", requireAdmin, async (req, res) => {
         soundtrackZoneId,
         soundtrackZoneName,
         isEnabled: isEnabled ?? false,
-        ...sanitizeFull({ minVolume, maxVolume, quietThresholdDb, loudThresholdDb, smoothingFactor, sustainCount }),
+        ...sanitizeFull({
+          minVolume, maxVolume, quietThresholdDb, loudThresholdDb, smoothingFactor, sustainCount, levelMetric,
+        }),
       },
     });
 
@@ -149,6 +157,8 @@ configRoutes.post("/", requireAdmin, async (req, res) => {
       });
     }
 
+    deviceCache.invalidate(deviceId);
+    await pushZoneConfigs(deviceId);
     res.json(config);
   } catch (err: any) {
     if (err.code === "P2002") {
@@ -170,6 +180,7 @@ configRoutes.put("/:id", requireAuth, async (req: Request<{ id: string }>, res)
       loudThresholdDb,
       smoothingFactor,
       sustainCount,
+      levelMetric,
       soundtrackAccountId,
       soundtrackAccountName,
       soundtrackZoneId,
@@ -181,12 +192,15 @@ configRoutes.put("/:id", requireAuth, async (req: Request<{ id: string }>, res)
       data: {
         ...(isEnabled !== undefined && { isEnabled }),
         ...sanitizePartial({ minVolume, maxVolume, quietThresholdDb, loudThresholdDb, smoothingFactor, sustainCount }),
+        ...(isMetric(levelMetric) && { levelMetric }),
         ...(soundtrackAccountId !== undefined && { soundtrackAccountId }),
         ...(soundtrackAccountName !== undefined && { soundtrackAccountName }),
         ...(soundtrackZoneId !== undefined && { soundtrackZoneId }),
         ...(soundtrackZoneName !== undefined && { soundtrackZoneName }),
       },
     });
+    deviceCache.invalidate(config.deviceId);
+    await pushZoneConfigs(config.deviceId);
     res.json(config);
   } catch (err) {
     res.status(500).json({ error: "Failed to update config" });
@@ -204,6 +218,8 @@ configRoutes.patch("/:id/pause", requireAuth, async (req: Request<{ id: string }
       where: { id: req.params.id },
       data: { isPaused },
     });
+    deviceCache.invalidate(config.deviceId);
+    await pushZoneConfigs(config.deviceId);
     res.json(config);
   } catch (err) {
     res.status(500).json({ error: "Failed to update zone pause state" });
@@ -256,6 +272,8 @@ configRoutes.post("/quick-setup", requireAdmin, async (req, res) => {
       include: { configs: true },
     });
 
+    deviceCache.invalidate(deviceId);
+    await pushZoneConfigs(deviceId);
     res.json({ config, device });
   } catch (err: any) {
     if (err.code === "P2002") {
@@ -269,7 +287,9 @@ configRoutes.post("/quick-setup", requireAdmin, async (req, res) => {
 configRoutes.delete("/:id", requireAdmin, async (req: Request<{ id: string }>, res) => {
   try {
     if (!(await configAllowed(req, req.params.id))) return res.status(403).json({ error: "Forbidden" });
-    await prisma.zoneConfig.delete({ where: { id: req.params.id } });
+    const config = await prisma.zoneConfig.delete({ where: { id: req.params.id } });
+    deviceCache.invalidate(config.deviceId);
+    await pushZoneConfigs(config.deviceId);
     res.json({ success: true });
   } catch (err) {
     res.status(500).json({ error: "Failed to delete config" });
@@ -1,7 +1,8 @@
 import { Router, Request } from "express";
 import { prisma } from "../db";
-import { deviceManager } from "../websocket/handler";
+import { deviceCache, deviceManager, pushZoneConfigs } from "../websocket/handler";
 import { requireAuth, requireAdmin, scopedAccountId } from "../auth";
+import { ROLLUP_TIERS, LEVEL_COLUMNS, VOLUME_COLUMNS, historyTier, queryHistory } from "../services/timeseries";
 
 export const deviceRoutes = Router();
 
@@ -33,6 +34,51 @@ deviceRoutes.get("/", requireAuth, async (req, res) => {
   }
 });
 
+// Loudness and volume history from the rollups (services/timeseries.ts).
+//   ?ids=uuid,uuid (default: every device in scope) &from=ISO &to=ISO (default:
+//   the last 24 h) &tier=10|60|900 (default: the finest that fits)
+// Customers only see their own account's devices.
+const HISTORY_MAX_DEVICES = 200;
+const HISTORY_MAX_SPAN_MS = 400 * 86400000;
+
+deviceRoutes.get("/history", requireAuth, async (req, res) => {
+  try {
+    const to = req.query.to ? new Date(String(req.query.to)) : new Date();
+    const from = req.query.from ? new Date(String(req.query.from)) : new Date(to.getTime() - 86400000);
+    const span = to.getTime() - from.getTime();
+    if (isNaN(span) || span <= 0 || span > HISTORY_MAX_SPAN_MS) {
+      return res.status(400).json({ error: "from/to must be ISO times, from before to, at most 400 days apart" });
+    }
+    const tier = req.query.tier ? Number(req.query.tier) : historyTier(from, to);
+    if (!ROLLUP_TIERS.some((t) => t.seconds === tier)) {
+      return res.status(400).json({ error: `tier must be one of ${ROLLUP_TIERS.map((t) => t.seconds).join(", ")}` });
+    }
+    const ids = typeof req.query.ids === "string" ? req.query.ids.split(",").filter(Boolean) : undefined;
+    if (ids && ids.length > HISTORY_MAX_DEVICES) {
+      return res.status(400).json({ error: `at most ${HISTORY_MAX_DEVICES} devices` });
+    }
+
+    const scope = scopedAccountId(req);
+    const devices = await prisma.device.findMany({
+      where: { ...(ids && { id: { in: ids } }), ...(scope !== null && { soundtrackAccountId: scope }) },
+      select: { id: true, deviceId: true, name: true },
+      orderBy: { createdAt: "desc" },
+      take: HISTORY_MAX_DEVICES,
+    });
+    const history = await queryHistory(devices.map((d) => d.deviceId), from, to, tier);
+    res.json({
+      from,
+      to,
+      tierS: tier,
+      levelColumns: LEVEL_COLUMNS,
+      volumeColumns: VOLUME_COLUMNS,
+      devices: devices.map((d, i) => ({ id: d.id, name: d.name, ...history[i] })),
+    });
+  } catch (err) {
+    res.status(500).json({ error: "Failed to fetch history" });
+  }
+});
+
 // Get single device
 deviceRoutes.get("/:id", requireAuth, async (req: Request<{ id: string }>, res) => {
   try {
@@ -53,6 +99,7 @@ deviceRoutes.delete("/:id", requireAdmin, async (req: Request<{ id: string }>, r
   try {
     await prisma.zoneConfig.deleteMany({ where: { deviceId: req.params.id } });
     await prisma.device.delete({ where: { id: req.params.id } });
+    deviceCache.invalidate(req.params.id);
     res.json({ ok: true });
   } catch (err) {
     res.status(500).json({ error: "Failed to delete device" });
@@ -70,6 +117,7 @@ deviceRoutes.patch("/:id/name", requireAuth, async (req: Request<{ id: string }>
       where: { id: req.params.id },
       data: { name },
     });
+    deviceCache.invalidate(device.id);
     res.json(device);
   } catch (err) {
     res.status(500).json({ error: "Failed to rename device" });
@@ -88,6 +136,7 @@ deviceRoutes.patch("/:id/account", requireAdmin, async (req: Request<{ id: strin
       where: { id: req.params.id },
       data: { soundtrackAccountId },
     });
+    deviceCache.invalidate(device.id);
 
     // Push to device via WebSocket if online
     deviceManager.sendToDevice(device.deviceId, {
@@ -101,6 +150,101 @@ deviceRoutes.patch("/:id/account", requireAdmin, async (req: Request<{ id: strin
   }
 });
 
+// Select the device's level-meter frequency weighting — ADMIN ONLY (shifts the
+// reported dBFS, so zone thresholds may need re-tuning). Stored on the device.
+deviceRoutes.patch("/:id/weighting", requireAdmin, async (req: Request<{ id: string }>, res) => {
+  try {
+    const { weighting } = req.body;
+    if (!["Z", "A", "C", "K"].includes(weighting)) {
+      return res.status(400).json({ error: "weighting must be one of Z, A, C, K" });
+    }
+    const device = await prisma.device.findUnique({ where: { id: req.params.id } });
+    if (!device) return res.status(404).json({ error: "Device not found" });
+
+    deviceManager.sendToDevice(device.deviceId, { type: "set_weighting", weighting });
+    res.json({ ok: true, online: deviceManager.isDeviceOnline(device.deviceId) });
+  } catch (err) {
+    res.status(500).json({ error: "Failed to set weighting" });
+  }
+});
+
+// Newest records of the device's in-RAM log (fetched live) — ADMIN ONLY
+deviceRoutes.get("/:id/logs", requireAdmin, async (req: Request<{ id: string }>, res) => {
+  try {
+    const count = Math.min(Math.max(parseInt(String(req.query.count ?? "64"), 10) || 64, 1), 64);
+    const device = await prisma.device.findUnique({ where: { id: req.params.id } });
+    if (!device) return res.status(404).json({ error: "Device not found" });
+
+    const records = await deviceManager.requestLogs(device.deviceId, count);
+    if (!records) return res.status(504).json({ error: "Device offline or did not answer" });
+    res.json({ records });
+  } catch (err) {
+    res.status(500).json({ error: "Failed to fetch device logs" });
+  }
+});
+
+// Change a device's log level, for one module or all ("*") — ADMIN ONLY.
+// Not persisted: the device starts at its default level after a reboot.
+deviceRoutes.patch("/:id/log-level", requireAdmin, async (req: Request<{ id: string }>, res) => {
+  try {
+    const { module = "*", level } = req.body;
+    if (!["error", "warn", "info", "debug"].includes(level)) {
+      return res.status(400).json({ error: "level must be one of error, warn, info, debug" });
+    }
+    if (typeof module !== "string") return res.status(400).json({ error: "module must be a string" });
+    const device = await prisma.device.findUnique({ where: { id: req.params.id } });
+    if (!device) return res.status(404).json({ error: "Device not found" });
+
+    deviceManager.sendToDevice(device.deviceId, { type: "set_log_level", module, level });
+    res.json({ ok: true, online: deviceManager.isDeviceOnline(device.deviceId) });
+  } catch (err) {
+    res.status(500).json({ error: "Failed to set log level" });
+  }
+});
+
+// Send-on-delta reporting parameters (firmware/src/report.h) — ADMIN ONLY.
+// Stored on the device row and pushed now if it is online; deadbandDb 0 makes
+// the device send every reading.
+deviceRoutes.patch("/:id/reporting", requireAdmin, async (req: Request<{ id: string }>, res) => {
+  try {
+    const { deadbandDb, slopeDbPerS, heartbeatS } = req.body;
+    const data: { reportDeadbandDb?: number; reportSlopeDbPerS?: number; reportHeartbeatS?: number } = {};
+    if (deadbandDb !== undefined) {
+      if (typeof deadbandDb !== "number" || deadbandDb < 0 || deadbandDb > 20) {
+        return res.status(400).json({ error: "deadbandDb must be a number from 0 to 20" });
+      }
+      data.reportDeadbandDb = deadbandDb;
+    }
+    if (slopeDbPerS !== undefined) {
+      if (typeof slopeDbPerS !== "number" || slopeDbPerS < 0 || slopeDbPerS > 20) {
+        return res.status(400).json({ error: "slopeDbPerS must be a number from 0 to 20" });
+      }
+      data.reportSlopeDbPerS = slopeDbPerS;
+    }
+    if (heartbeatS !== undefined) {
+      if (!Number.isInteger(heartbeatS) || heartbeatS < 1 || heartbeatS > 600) {
+        return res.status(400).json({ error: "heartbeatS must be an integer from 1 to 600" });
+      }
+      data.reportHeartbeatS = heartbeatS;
+    }
+    if (!(await prisma.device.findUnique({ where: { id: req.params.id } }))) {
+      return res.status(404).json({ error: "Device not found" });
+    }
+
+    const device = await prisma.device.update({ where: { id: req.params.id }, data });
+    deviceCache.invalidate(device.id);
+    await pushZoneConfigs(device.id);
+    res.json({
+      deadbandDb: device.reportDeadbandDb,
+      slopeDbPerS: device.reportSlopeDbPerS,
+      heartbeatS: device.reportHeartbeatS,
+      online: deviceManager.isDeviceOnline(device.deviceId),
+    });
+  } catch (err) {
+    res.status(500).json({ error: "Failed to update reporting" });
+  }
+});
+
 // Pause/resume device
 deviceRoutes.patch("/:id/pause", requireAuth, async (req: Request<{ id: string }>, res) => {
   try {
@@ -112,6 +256,8 @@ deviceRoutes.patch("/:id/pause", requireAuth, async (req: Request<{ id: string }
       where: { id: req.params.id },
       data: { isPaused },
     });
+    deviceCache.invalidate(device.id);
+    await pushZoneConfigs(device.id);
     res.json(device);
   } catch (err) {
     res.status(500).json({ error: "Failed to update device pause state" });
@@ -142,6 +288,7 @@ deviceRoutes.post("/", requireAdmin, async (req, res) => {
       update: { name, lastSeen: new Date() },
       create: { deviceId, name },
     });
+    deviceCache.invalidateDeviceId(deviceId);
     res.json(device);
   } catch (err) {
     res.status(500).json({ error: "Failed to register device" });
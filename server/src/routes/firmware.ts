@@ -4,8 +4,10 @@ import path from "path";
 
 // Firmware OTA manifest. Devices poll GET /api/firmware/version (unauthenticated —
 // they hold no session cookie) to discover the latest published firmware. The
-// binary itself is served statically from /firmware/firmware.bin. Publish a new
-// build with scripts/publish-firmware.mjs, then commit + push to deploy.
+// binary itself is served statically from /firmware/firmware.bin, and delta
+// patches from recent releases (listed in the manifest's "deltas") from
+// /firmware/delta/. Publish a new build with scripts/publish-firmware.mjs, then
+// commit + push to deploy.
 export const firmwareRoutes = Router();
 
 const VERSION_FILE = path.join(__dirname, "../../public/firmware/version.json");
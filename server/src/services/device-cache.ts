@@ -0,0 +1,64 @@
+import type { Device, ZoneConfig } from "@prisma/client";
+import { prisma } from "../db";
+
+export type CachedDevice = Device & { configs: ZoneConfig[] };
+
+// Entries are also dropped this long after loading, so a row changed outside
+// the routes (another instance, prisma studio) is picked up eventually.
+const CACHE_TTL_MS = 60000;
+
+/**
+ * Device rows with their zone configs, by hardware deviceId, for the per-reading
+ * paths (sound_level, volume_intent). Every route that writes a device or zone
+ * config invalidates it. The handlers update cached configs in place when they
+ * queue a currentVolume/playerOnline write (write-behind.ts), so the cache never
+ * lags those.
+ */
+export class DeviceCache {
+  private entries: Map<string, { device: CachedDevice | null; loadedAt: number }> = new Map();
+  private loading: Map<string, Promise<CachedDevice | null>> = new Map();
+  // Bumped by every invalidation: a load that started before one is not stored.
+  private generation = 0;
+  private hits = 0;
+  private misses = 0;
+
+  async get(deviceId: string): Promise<CachedDevice | null> {
+    const entry = this.entries.get(deviceId);
+    if (entry && Date.now() - entry.loadedAt < CACHE_TTL_MS) {
+      this.hits++;
+      return entry.device;
+    }
+    this.misses++;
+    let load = this.loading.get(deviceId);
+    if (!load) {
+      const generation = this.generation;
+      load = prisma.device
+        .findUnique({ where: { deviceId }, include: { configs: true } })
+        .then((device) => {
+          if (generation === this.generation) this.entries.set(deviceId, { device, loadedAt: Date.now() });
+          return device;
+        })
+        .finally(() => this.loading.delete(deviceId));
+      this.loading.set(deviceId, load);
+    }
+    return load;
+  }
+
+  // After a write to the device (by its row id) or any of its zone configs.
+  invalidate(deviceUuid: string): void {
+    this.generation++;
+    for (const [deviceId, entry] of this.entries) {
+      if (entry.device?.id === deviceUuid) this.entries.delete(deviceId);
+    }
+  }
+
+  // After a write by hardware deviceId (register).
+  invalidateDeviceId(deviceId: string): void {
+    this.generation++;
+    this.entries.delete(deviceId);
+  }
+
+  stats() {
+    return { devices: this.entries.size, hits: this.hits, misses: this.misses };
+  }
+}
@@ -1,18 +1,51 @@
 import WebSocket from "ws";
 import { prisma } from "../db";
+import type { WriteBehind } from "./write-behind";
+
+// Runtime metrics a device reports every minute in a "stats" message
+// (firmware/src/metrics.h). Counters and histogram buckets count since boot;
+// histogram maxima cover the time since the previous report.
+export interface DeviceStats {
+  uptimeS: number;
+  counters?: Record<string, number>;
+  gauges?: Record<string, number>;
+  bucketsUs?: number[]; // histogram bucket upper bounds; one more bucket holds the rest
+  histograms?: Record<string, { counts: number[]; max: number }>;
+}
+
+// One log record from a device's RAM ring (firmware/src/logring.h).
+export interface DeviceLogRecord {
+  ms: number; // device uptime when logged
+  level: string; // error | warn | info | debug
+  module: string;
+  text: string;
+}
+
+const LOG_REQUEST_TIMEOUT_MS = 5000;
 
 interface ConnectedDevice {
   ws: WebSocket;
   deviceId: string;
   lastSeen: Date;
+  deviceControl: boolean; // runs the volume mapper itself and sends volume_intent
 }
 
 export class DeviceManager {
   private devices: Map<string, ConnectedDevice> = new Map();
+  // Open "get_logs" requests per device, answered by the next "logs" message.
+  private logWaiters: Map<string, Array<(records: DeviceLogRecord[] | null) => void>> = new Map();
+
+  constructor(private writeBehind: WriteBehind) {}
 
-  async registerDevice(ws: WebSocket, deviceId: string, firmware?: string, accountId?: string): Promise<void> {
+  async registerDevice(
+    ws: WebSocket,
+    deviceId: string,
+    firmware?: string,
+    accountId?: string,
+    deviceControl = false
+  ): Promise<void> {
     // Store in memory
-    this.devices.set(deviceId, { ws, deviceId, lastSeen: new Date() });
+    this.devices.set(deviceId, { ws, deviceId, lastSeen: new Date(), deviceControl });
 
     // Upsert in database
     await prisma.device.upsert({
@@ -32,7 +65,10 @@ export class DeviceManager {
       },
     });
 
-    console.log(`Device registered: ${deviceId} (${this.devices.size} total)${accountId ? ` account: ${accountId}` : ''}`);
+    console.log(
+      `Device registered: ${deviceId} (${this.devices.size} total)${accountId ? ` account: ${accountId}` : ''}` +
+        (deviceControl ? " [device control]" : "")
+    );
   }
 
   async disconnectDevice(deviceId: string): Promise<void> {
@@ -46,18 +82,85 @@ export class DeviceManager {
     console.log(`Device disconnected: ${deviceId} (${this.devices.size} total)`);
   }
 
-  async updateDeviceLevel(deviceId: string, dbLevel: number): Promise<void> {
-    const device = this.devices.get(deviceId);
-    if (device) {
-      device.lastSeen = new Date();
+  // Boot-to-online latency the device reports on register (ms since boot): first
+  // WiFi/websocket connection and the end of each setup() phase. The values
+  // repeat on every register until the device reboots.
+  async updateBootTiming(
+    deviceId: string,
+    connect?: { wifiMs: number; wsMs: number; fast?: boolean },
+    boot?: Record<string, number>
+  ): Promise<void> {
+    const ms = (v: unknown) => (typeof v === "number" && Number.isFinite(v) && v >= 0 ? Math.round(v) : null);
+    const phases: Record<string, number> = {};
+    for (const [phase, v] of Object.entries(boot ?? {}).slice(0, 32)) {
+      const t = ms(v);
+      if (t !== null) phases[phase.slice(0, 32)] = t;
+    }
+    await prisma.device.update({
+      where: { deviceId },
+      data: {
+        ...(connect && {
+          wifiConnectMs: ms(connect.wifiMs) || null,
+          wsConnectMs: ms(connect.wsMs) || null,
+          wifiFastConnect: typeof connect.fast === "boolean" ? connect.fast : null,
+        }),
+        ...(boot && { bootPhases: phases }),
+      },
+    }).catch(() => {});
+    if (connect) {
+      console.log(`Device ${deviceId} online ${ms(connect.wsMs) ?? "?"} ms after boot` +
+        ` (WiFi ${ms(connect.wifiMs) ?? "?"} ms${connect.fast ? ", fast" : ""})`);
     }
+  }
+
+  // Keep the latest stats report (Device.lastStats). Only finite numbers under
+  // bounded names are stored, whatever the device sends.
+  async updateDeviceStats(deviceId: string, stats: DeviceStats): Promise<void> {
+    const num = (v: unknown) => (typeof v === "number" && Number.isFinite(v) ? v : null);
+    const numbers = (v: unknown, max: number) =>
+      Array.isArray(v) ? v.slice(0, max).map((x) => num(x) ?? 0) : [];
+    const record = <T>(v: unknown, map: (x: unknown) => T | null): Record<string, T> => {
+      const out: Record<string, T> = {};
+      if (typeof v !== "object" || v === null) return out;
+      for (const [name, x] of Object.entries(v).slice(0, 64)) {
+        const m = map(x);
+        if (m !== null) out[name.slice(0, 32)] = m;
+      }
+      return out;
+    };
+    const histogram = (h: unknown) =>
+      typeof h === "object" && h !== null
+        ? { counts: numbers((h as any).counts, 32), max: num((h as any).max) ?? 0 }
+        : null;
 
+    const clean = {
+      uptimeS: num(stats.uptimeS) ?? 0,
+      counters: record(stats.counters, num),
+      gauges: record(stats.gauges, num),
+      bucketsUs: numbers(stats.bucketsUs, 32),
+      histograms: record(stats.histograms, histogram),
+    };
     await prisma.device.update({
       where: { deviceId },
-      data: { lastDbLevel: dbLevel, lastSeen: new Date() },
+      data: { lastStats: clean, lastStatsAt: new Date() },
     }).catch(() => {});
   }
 
+  // Queued for the next write-behind flush (Device.lastDbLevel / lastSeen).
+  updateDeviceLevel(deviceId: string, dbLevel: number, percentiles?: Record<string, number[]>): void {
+    const device = this.devices.get(deviceId);
+    if (device) {
+      device.lastSeen = new Date();
+    }
+    this.writeBehind.queueLevel(deviceId, dbLevel, percentiles);
+  }
+
+  // Latest octave-band levels, kept on the Device row whatever the control
+  // mode (Device.lastBands). Call after updateDeviceLevel for the same reading.
+  updateDeviceBands(deviceId: string, bands: number[]): void {
+    this.writeBehind.queueBands(deviceId, bands);
+  }
+
   sendToDevice(deviceId: string, message: object): void {
     const device = this.devices.get(deviceId);
     if (device && device.ws.readyState === WebSocket.OPEN) {
@@ -65,6 +168,44 @@ export class DeviceManager {
     }
   }
 
+  // Ask an online device for its newest log records. Resolves null if it is
+  // offline or does not answer within LOG_REQUEST_TIMEOUT_MS.
+  requestLogs(deviceId: string, count: number): Promise<DeviceLogRecord[] | null> {
+    if (!this.isDeviceOnline(deviceId)) return Promise.resolve(null);
+    return new Promise((resolve) => {
+      const waiters = this.logWaiters.get(deviceId) ?? [];
+      const waiter = (records: DeviceLogRecord[] | null) => {
+        clearTimeout(timer);
+        resolve(records);
+      };
+      const timer = setTimeout(() => {
+        const left = (this.logWaiters.get(deviceId) ?? []).filter((w) => w !== waiter);
+        if (left.length) this.logWaiters.set(deviceId, left);
+        else this.logWaiters.delete(deviceId);
+        resolve(null);
+      }, LOG_REQUEST_TIMEOUT_MS);
+      waiters.push(waiter);
+      this.logWaiters.set(deviceId, waiters);
+      this.sendToDevice(deviceId, { type: "get_logs", count });
+    });
+  }
+
+  // A "logs" reply: hand it to every open request for the device.
+  resolveLogs(deviceId: string, records: unknown): void {
+    const waiters = this.logWaiters.get(deviceId);
+    if (!waiters) return;
+    this.logWaiters.delete(deviceId);
+    const clean: DeviceLogRecord[] = (Array.isArray(records) ? records : [])
+      .filter((r): r is unknown[] => Array.isArray(r) && r.length >= 4)
+      .map(([ms, level, module, text]) => ({
+        ms: typeof ms === "number" ? ms : 0,
+        level: String(level).slice(0, 8),
+        module: String(module).slice(0, 16),
+        text: String(text).slice(0, 256),
+      }));
+    for (const w of waiters) w(clean);
+  }
+
   getConnectedDevices(): string[] {
     return Array.from(this.devices.keys());
   }
@@ -73,6 +214,10 @@ export class DeviceManager {
     return this.devices.has(deviceId);
   }
 
+  isDeviceControlled(deviceId: string): boolean {
+    return this.devices.get(deviceId)?.deviceControl ?? false;
+  }
+
   findDeviceIdByWs(ws: WebSocket): string | undefined {
     for (const [deviceId, device] of this.devices) {
       if (device.ws === ws) return deviceId;
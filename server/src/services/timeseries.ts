@@ -0,0 +1,452 @@
+import { Prisma } from "@prisma/client";
+import { prisma } from "../db";
+
+// Rollup resolutions and how long each is kept. History queries pick the finest
+// tier that covers the range in at most HISTORY_MAX_POINTS buckets.
+export const ROLLUP_TIERS = [
+  { seconds: 10, retentionDays: 2 },
+  { seconds: 60, retentionDays: 14 },
+  { seconds: 900, retentionDays: 400 },
+] as const;
+export const HISTORY_MAX_POINTS = 1500;
+
+const FLUSH_INTERVAL_MS = 10000;
+// A bucket is written once it ended this long ago; a reading arriving later
+// (or replayed from a device backlog) is merged into the stored row.
+const CLOSE_GRACE_MS = 5000;
+const PRUNE_INTERVAL_MS = 3600000;
+const ROWS_PER_STATEMENT = 500;
+
+// Per-bucket histogram for the percentiles: 0.5 dB bins from -120 dBFS (lower
+// levels count in the lowest bin) up to 0 dBFS.
+const HIST_FLOOR_DB = -120;
+const HIST_BIN_DB = 0.5;
+const HIST_BINS = -HIST_FLOOR_DB / HIST_BIN_DB;
+
+// Devices report on change (firmware/src/report.h), so a reading stands for the
+// level until the next one, and at most a heartbeat: past that the device or
+// its link is gone. Device.reportHeartbeatS, until setHeartbeat() says otherwise.
+const DEFAULT_HEARTBEAT_S = 30;
+
+// Mean and percentiles are over time, not readings: each reading weighs the
+// milliseconds it held the level within the bucket, or a burst of readings
+// after a change would outweigh the steady minutes between heartbeats.
+class LevelBucket {
+  count = 0; // readings taken in the bucket
+  heldMs = 0;
+  min = Infinity;
+  max = -Infinity;
+  sum = 0; // dBFS x ms
+  hist = new Uint32Array(HIST_BINS); // ms per bin
+
+  add(dbFS: number): void {
+    this.count++;
+    this.min = Math.min(this.min, dbFS);
+    this.max = Math.max(this.max, dbFS);
+  }
+
+  hold(dbFS: number, ms: number): void {
+    this.min = Math.min(this.min, dbFS);
+    this.max = Math.max(this.max, dbFS);
+    this.heldMs += ms;
+    this.sum += dbFS * ms;
+    const bin = Math.floor((dbFS - HIST_FLOOR_DB) / HIST_BIN_DB);
+    this.hist[Math.max(0, Math.min(HIST_BINS - 1, bin))] += ms;
+  }
+
+  merge(o: LevelBucket): void {
+    this.count += o.count;
+    this.heldMs += o.heldMs;
+    this.min = Math.min(this.min, o.min);
+    this.max = Math.max(this.max, o.max);
+    this.sum += o.sum;
+    for (let bin = 0; bin < HIST_BINS; bin++) this.hist[bin] += o.hist[bin];
+  }
+
+  // Readings superseded within the same millisecond hold nothing.
+  mean(): number {
+    return this.heldMs > 0 ? this.sum / this.heldMs : (this.min + this.max) / 2;
+  }
+
+  // Level exceeded `exceeded` of the time: the middle of the bin holding that
+  // rank, kept within the bucket's min..max.
+  level(exceeded: number): number {
+    if (this.heldMs === 0) return this.mean();
+    const rank = this.heldMs * exceeded;
+    let seen = 0;
+    for (let bin = HIST_BINS - 1; bin >= 0; bin--) {
+      seen += this.hist[bin];
+      if (seen > 0 && seen >= rank) {
+        const mid = HIST_FLOOR_DB + (bin + 0.5) * HIST_BIN_DB;
+        return Math.max(this.min, Math.min(this.max, mid));
+      }
+    }
+    return this.min;
+  }
+}
+
+// The latest reading of a device, added to the buckets up to `until` so far.
+interface HeldReading {
+  deviceId: string;
+  dbFS: number;
+  at: number;
+  until: number;
+}
+
+interface VolumeBucket {
+  count: number;
+  min: number;
+  max: number;
+  last: number;
+}
+
+interface Closed<T> {
+  key: string; // hardware deviceId or ZoneConfig.id
+  tierS: number;
+  bucket: Date;
+  agg: T;
+}
+
+const round1 = (v: number) => Math.round(v * 10) / 10;
+
+/**
+ * Downsampled history of venue loudness and volume decisions. Readings are
+ * aggregated in memory into one open bucket per device and tier (min, max, and
+ * time-weighted mean and L10/L50/L90 from a 0.5 dB histogram), each held over
+ * the buckets it spans until the next reading, and volume decisions per zone
+ * likewise (min, max, last). Every FLUSH_INTERVAL_MS the buckets that ended go
+ * to Postgres in batched upserts (LevelRollup / VolumeRollup); once an hour
+ * each tier drops what is past its retention. Raw readings are never stored.
+ */
+export class TimeSeries {
+  // `${key} ${tierS} ${bucketMs}` -> open bucket
+  private levels: Map<string, LevelBucket> = new Map();
+  private volumes: Map<string, VolumeBucket> = new Map();
+  // Live readings and backlog replays are separate runs: each in time order.
+  private held: Map<string, HeldReading> = new Map();
+  private heartbeatMs: Map<string, number> = new Map();
+  private flushTimer: NodeJS.Timeout | null = null;
+  private pruneTimer: NodeJS.Timeout | null = null;
+  private flushing: Promise<void> | null = null;
+  private metrics = { flushes: 0, failures: 0, rows: 0, lastMs: 0, maxMs: 0, pruned: 0 };
+
+  start(): void {
+    if (this.flushTimer) return;
+    this.flushTimer = setInterval(() => void this.flush(), FLUSH_INTERVAL_MS);
+    this.pruneTimer = setInterval(() => void this.prune(), PRUNE_INTERVAL_MS);
+    this.flushTimer.unref();
+    this.pruneTimer.unref();
+  }
+
+  // Stop the timers and write every bucket, open ones included (shutdown), each
+  // device's last reading held for a heartbeat. A bucket continued after the
+  // restart is merged into the row.
+  async stop(): Promise<void> {
+    if (this.flushTimer) clearInterval(this.flushTimer);
+    if (this.pruneTimer) clearInterval(this.pruneTimer);
+    this.flushTimer = this.pruneTimer = null;
+    await this.flush(Infinity);
+  }
+
+  // The device's send-on-delta heartbeat: the longest a reading is held.
+  setHeartbeat(deviceId: string, heartbeatS: number): void {
+    this.heartbeatMs.set(deviceId, heartbeatS * 1000);
+  }
+
+  addLevel(deviceId: string, dbFS: number, at: Date = new Date(), backlog = false): void {
+    if (!Number.isFinite(dbFS)) return;
+    const run = backlog ? `${deviceId} backlog` : deviceId;
+    const t = at.getTime();
+    const prev = this.held.get(run);
+    if (prev) this.hold(prev, Math.min(t, prev.at + this.maxHoldMs(deviceId)));
+    for (const tier of ROLLUP_TIERS) this.levelBucket(deviceId, tier.seconds, bucketStart(at, tier.seconds)).add(dbFS);
+    // A late reading holds from where the previous one was written up to.
+    this.held.set(run, { deviceId, dbFS, at: t, until: Math.max(t, prev?.until ?? t) });
+  }
+
+  private maxHoldMs(deviceId: string): number {
+    return this.heartbeatMs.get(deviceId) ?? DEFAULT_HEARTBEAT_S * 1000;
+  }
+
+  // Add the held reading's time from `until` up to `to`, split at bucket ends.
+  private hold(r: HeldReading, to: number): void {
+    if (to <= r.until) return;
+    for (const tier of ROLLUP_TIERS) {
+      const ms = tier.seconds * 1000;
+      for (let from = r.until; from < to; ) {
+        const start = Math.floor(from / ms) * ms;
+        const end = Math.min(start + ms, to);
+        this.levelBucket(r.deviceId, tier.seconds, start).hold(r.dbFS, end - from);
+        from = end;
+      }
+    }
+    r.until = to;
+  }
+
+  private levelBucket(deviceId: string, tierS: number, start: number): LevelBucket {
+    const id = `${deviceId} ${tierS} ${start}`;
+    let b = this.levels.get(id);
+    if (!b) this.levels.set(id, (b = new LevelBucket()));
+    return b;
+  }
+
+  addVolume(configId: string, volume: number, at: Date = new Date()): void {
+    for (const tier of ROLLUP_TIERS) {
+      const id = `${configId} ${tier.seconds} ${bucketStart(at, tier.seconds)}`;
+      const b = this.volumes.get(id);
+      if (b) {
+        b.count++;
+        b.min = Math.min(b.min, volume);
+        b.max = Math.max(b.max, volume);
+        b.last = volume;
+      } else {
+        this.volumes.set(id, { count: 1, min: volume, max: volume, last: volume });
+      }
+    }
+  }
+
+  // Write the buckets that ended before `now - CLOSE_GRACE_MS`. Flushes never
+  // overlap; after a failed write the buckets go back to be retried.
+  async flush(now: number = Date.now()): Promise<void> {
+    while (this.flushing) await this.flushing;
+    const cutoff = now - CLOSE_GRACE_MS;
+    // Held readings count up to the cutoff first, so the buckets that close are
+    // whole; one past its heartbeat is done.
+    for (const [run, r] of this.held) {
+      const last = r.at + this.maxHoldMs(r.deviceId);
+      this.hold(r, Math.min(cutoff, last));
+      if (r.until >= last) this.held.delete(run);
+    }
+    const levels = close(this.levels, cutoff);
+    const volumes = close(this.volumes, cutoff);
+    if (levels.length === 0 && volumes.length === 0) return;
+    this.flushing = this.write(levels, volumes).finally(() => (this.flushing = null));
+    await this.flushing;
+  }
+
+  private async write(levels: Closed<LevelBucket>[], volumes: Closed<VolumeBucket>[]): Promise<void> {
+    const started = performance.now();
+    // One transaction for every chunk: the rows merge into stored buckets
+    // (count = count + ...), so a partly applied flush would be counted twice
+    // when the failed buckets are retried.
+    const statements: Prisma.PrismaPromise<number>[] = [];
+    for (let i = 0; i < levels.length; i += ROWS_PER_STATEMENT) {
+      statements.push(writeLevels(levels.slice(i, i + ROWS_PER_STATEMENT)));
+    }
+    for (let i = 0; i < volumes.length; i += ROWS_PER_STATEMENT) {
+      statements.push(writeVolumes(volumes.slice(i, i + ROWS_PER_STATEMENT)));
+    }
+    try {
+      await prisma.$transaction(statements);
+    } catch (err) {
+      // Nothing was committed: put the buckets back for the next flush.
+      this.metrics.failures++;
+      console.error(`Time-series flush of ${levels.length + volumes.length} bucket(s) failed:`, err);
+      for (const { key, tierS, bucket, agg } of levels) {
+        const id = `${key} ${tierS} ${bucket.getTime()}`;
+        const newer = this.levels.get(id);
+        if (newer) agg.merge(newer);
+        this.levels.set(id, agg);
+      }
+      for (const { key, tierS, bucket, agg } of volumes) {
+        const id = `${key} ${tierS} ${bucket.getTime()}`;
+        const newer = this.volumes.get(id);
+        this.volumes.set(id, newer ? mergeVolumes(agg, newer) : agg);
+      }
+      return;
+    }
+    const ms = performance.now() - started;
+    this.metrics.flushes++;
+    this.metrics.rows += levels.length + volumes.length;
+    this.metrics.lastMs = ms;
+    this.metrics.maxMs = Math.max(this.metrics.maxMs, ms);
+  }
+
+  async prune(): Promise<void> {
+    try {
+      for (const tier of ROLLUP_TIERS) {
+        const before = new Date(Date.now() - tier.retentionDays * 86400000);
+        const where = { tierS: tier.seconds, bucket: { lt: before } };
+        const [l, v] = await Promise.all([
+          prisma.levelRollup.deleteMany({ where }),
+          prisma.volumeRollup.deleteMany({ where }),
+        ]);
+        this.metrics.pruned += l.count + v.count;
+      }
+    } catch (err) {
+      console.error("Time-series prune failed:", err);
+    }
+  }
+
+  stats() {
+    const m = this.metrics;
+    return {
+      openBuckets: this.levels.size + this.volumes.size,
+      flushes: m.flushes,
+      failures: m.failures,
+      rows: m.rows,
+      lastFlushMs: round1(m.lastMs),
+      maxFlushMs: round1(m.maxMs),
+      pruned: m.pruned,
+    };
+  }
+}
+
+function mergeVolumes(older: VolumeBucket, newer: VolumeBucket): VolumeBucket {
+  return {
+    count: older.count + newer.count,
+    min: Math.min(older.min, newer.min),
+    max: Math.max(older.max, newer.max),
+    last: newer.last,
+  };
+}
+
+function bucketStart(at: Date, tierS: number): number {
+  const ms = tierS * 1000;
+  return Math.floor(at.getTime() / ms) * ms;
+}
+
+function close<T>(open: Map<string, T>, cutoff: number): Closed<T>[] {
+  const out: Closed<T>[] = [];
+  for (const [id, agg] of open) {
+    const [key, tier, start] = id.split(" ");
+    const tierS = Number(tier);
+    if (Number(start) + tierS * 1000 > cutoff) continue;
+    open.delete(id);
+    out.push({ key, tierS, bucket: new Date(Number(start)), agg });
+  }
+  return out;
+}
+
+// Rows for devices deleted meanwhile are skipped by the join. Both writers
+// return the unsent statement for write() to batch into its transaction.
+function writeLevels(rows: Closed<LevelBucket>[]): Prisma.PrismaPromise<number> {
+  const values = rows.map(
+    ({ key, tierS, bucket, agg: b }) =>
+      Prisma.sql`(${key}::text, ${tierS}::integer, ${bucket}::timestamp(3), ${b.count}::integer, ${b.heldMs}::integer,
+        ${b.min}::double precision, ${b.max}::double precision, ${b.mean()}::double precision,
+        ${round1(b.level(0.1))}::double precision, ${round1(b.level(0.5))}::double precision,
+        ${round1(b.level(0.9))}::double precision)`
+  );
+  return prisma.$executeRaw`
+    INSERT INTO "LevelRollup" AS r ("deviceId", "tierS", "bucket", "count", "heldMs", "minDb", "maxDb", "meanDb", "l10", "l50", "l90")
+    SELECT v.* FROM (VALUES ${Prisma.join(values)})
+      AS v(device_id, tier_s, bucket, count, held_ms, min_db, max_db, mean_db, l10, l50, l90)
+    JOIN "Device" d ON d."deviceId" = v.device_id
+    ON CONFLICT ("deviceId", "tierS", "bucket") DO UPDATE SET
+      "count" = r."count" + EXCLUDED."count",
+      "heldMs" = r."heldMs" + EXCLUDED."heldMs",
+      "minDb" = LEAST(r."minDb", EXCLUDED."minDb"),
+      "maxDb" = GREATEST(r."maxDb", EXCLUDED."maxDb"),
+      "meanDb" = CASE WHEN r."heldMs" + EXCLUDED."heldMs" = 0 THEN EXCLUDED."meanDb"
+        ELSE (r."meanDb" * r."heldMs" + EXCLUDED."meanDb" * EXCLUDED."heldMs") / (r."heldMs" + EXCLUDED."heldMs") END,
+      -- percentiles do not merge; keep the longer part's
+      "l10" = CASE WHEN EXCLUDED."heldMs" > r."heldMs" THEN EXCLUDED."l10" ELSE r."l10" END,
+      "l50" = CASE WHEN EXCLUDED."heldMs" > r."heldMs" THEN EXCLUDED."l50" ELSE r."l50" END,
+      "l90" = CASE WHEN EXCLUDED."heldMs" > r."heldMs" THEN EXCLUDED."l90" ELSE r."l90" END`;
+}
+
+function writeVolumes(rows: Closed<VolumeBucket>[]): Prisma.PrismaPromise<number> {
+  const values = rows.map(
+    ({ key, tierS, bucket, agg: b }) =>
+      Prisma.sql`(${key}::text, ${tierS}::integer, ${bucket}::timestamp(3), ${b.count}::integer,
+        ${b.min}::integer, ${b.max}::integer, ${b.last}::integer)`
+  );
+  return prisma.$executeRaw`
+    INSERT INTO "VolumeRollup" AS r ("configId", "tierS", "bucket", "count", "minVolume", "maxVolume", "lastVolume")
+    SELECT v.* FROM (VALUES ${Prisma.join(values)})
+      AS v(config_id, tier_s, bucket, count, min_volume, max_volume, last_volume)
+    JOIN "ZoneConfig" z ON z.id = v.config_id
+    ON CONFLICT ("configId", "tierS", "bucket") DO UPDATE SET
+      "count" = r."count" + EXCLUDED."count",
+      "minVolume" = LEAST(r."minVolume", EXCLUDED."minVolume"),
+      "maxVolume" = GREATEST(r."maxVolume", EXCLUDED."maxVolume"),
+      "lastVolume" = EXCLUDED."lastVolume"`;
+}
+
+// --- History queries ----------------------------------------------------------
+
+export function historyTier(from: Date, to: Date, now: number = Date.now()): number {
+  const spanS = (to.getTime() - from.getTime()) / 1000;
+  for (const tier of ROLLUP_TIERS) {
+    const kept = now - tier.retentionDays * 86400000;
+    if (spanS / tier.seconds <= HISTORY_MAX_POINTS && from.getTime() >= kept) return tier.seconds;
+  }
+  return ROLLUP_TIERS[ROLLUP_TIERS.length - 1].seconds;
+}
+
+export const LEVEL_COLUMNS = ["t", "minDb", "maxDb", "meanDb", "l10", "l50", "l90", "count"] as const;
+export const VOLUME_COLUMNS = ["t", "minVolume", "maxVolume", "lastVolume", "count"] as const;
+
+export interface DeviceHistory {
+  deviceId: string;
+  levels: number[][]; // LEVEL_COLUMNS, t in unix ms
+  zones: {
+    configId: string;
+    zoneId: string;
+    zoneName: string | null;
+    initialVolume: number | null; // lastVolume before `from`, if still kept
+    volumes: number[][]; // VOLUME_COLUMNS
+  }[];
+}
+
+/**
+ * History of the given devices (hardware ids) in [from, to) at one tier. Postgres
+ * builds each series as a JSON array, so a week of 100 devices at the 15-minute
+ * tier is three indexed range scans and ~70k small arrays.
+ */
+export async function queryHistory(
+  deviceIds: string[],
+  from: Date,
+  to: Date,
+  tierS: number
+): Promise<DeviceHistory[]> {
+  if (deviceIds.length === 0) return [];
+  const ids = Prisma.join(deviceIds);
+  const [levels, volumes, initial] = await Promise.all([
+    prisma.$queryRaw<{ deviceId: string; points: number[][] }[]>`
+      SELECT "deviceId", json_agg(json_build_array(
+          (extract(epoch FROM "bucket") * 1000)::bigint, "minDb", "maxDb", round("meanDb"::numeric, 1),
+          "l10", "l50", "l90", "count") ORDER BY "bucket") AS points
+      FROM "LevelRollup"
+      WHERE "deviceId" IN (${ids}) AND "tierS" = ${tierS} AND "bucket" >= ${from} AND "bucket" < ${to}
+      GROUP BY "deviceId"`,
+    prisma.$queryRaw<{ deviceId: string; configId: string; points: number[][] }[]>`
+      SELECT d."deviceId", v."configId", json_agg(json_build_array(
+          (extract(epoch FROM v."bucket") * 1000)::bigint, v."minVolume", v."maxVolume", v."lastVolume", v."count")
+          ORDER BY v."bucket") AS points
+      FROM "VolumeRollup" v
+      JOIN "ZoneConfig" z ON z.id = v."configId"
+      JOIN "Device" d ON d.id = z."deviceId"
+      WHERE d."deviceId" IN (${ids}) AND v."tierS" = ${tierS} AND v."bucket" >= ${from} AND v."bucket" < ${to}
+      GROUP BY d."deviceId", v."configId"`,
+    prisma.$queryRaw<{ configId: string; lastVolume: number }[]>`
+      SELECT DISTINCT ON (v."configId") v."configId", v."lastVolume"
+      FROM "VolumeRollup" v
+      JOIN "ZoneConfig" z ON z.id = v."configId"
+      JOIN "Device" d ON d.id = z."deviceId"
+      WHERE d."deviceId" IN (${ids}) AND v."tierS" = ${tierS} AND v."bucket" < ${from}
+      ORDER BY v."configId", v."bucket" DESC`,
+  ]);
+  const zones = await prisma.zoneConfig.findMany({
+    where: { device: { deviceId: { in: deviceIds } } },
+    select: { id: true, soundtrackZoneId: true, soundtrackZoneName: true, device: { select: { deviceId: true } } },
+  });
+
+  const initialVolume = new Map(initial.map((r) => [r.configId, r.lastVolume]));
+  const volumePoints = new Map(volumes.map((r) => [r.configId, r.points]));
+  const levelPoints = new Map(levels.map((r) => [r.deviceId, r.points]));
+  return deviceIds.map((deviceId) => ({
+    deviceId,
+    levels: levelPoints.get(deviceId) ?? [],
+    zones: zones
+      .filter((z) => z.device.deviceId === deviceId)
+      .map((z) => ({
+        configId: z.id,
+        zoneId: z.soundtrackZoneId,
+        zoneName: z.soundtrackZoneName,
+        initialVolume: initialVolume.get(z.id) ?? null,
+        volumes: volumePoints.get(z.id) ?? [],
+      })),
+  }));
+}
@@ -9,6 +9,35 @@ interface ZoneState {
   sustainCount: number;
   pendingVolume: number | null;
   pendingDirection: number | null; // 1 = up, -1 = down
+  bandsDb: number[] | null; // latest octave-band spectrum from the device (dBFS)
+  bandsAt: number; // when bandsDb was received (ms epoch)
+}
+
+// Centre frequencies of the device's octave-band levels, in the order they are
+// sent. Must match BANDS_CENTER_HZ in firmware/src/bands.cpp.
+export const OCTAVE_BAND_CENTERS_HZ = [63, 125, 250, 500, 1000, 2000, 4000] as const;
+
+// What a zone's loop follows (ZoneConfig.levelMetric): the reading itself, or a
+// percentile of the device's levels over PERCENTILE_WINDOW_S seconds
+// (firmware/src/levelstats.h). L90 tracks the ambient floor, so the venue's own
+// music peaks don't drive the volume up.
+export const LEVEL_METRICS = ["level", "l10", "l50", "l90"] as const;
+export type LevelMetric = (typeof LEVEL_METRICS)[number];
+export const PERCENTILE_WINDOW_S = 60; // MAPPER_PERCENTILE_WINDOW_S in firmware/src/config.h
+export type Percentiles = Record<string, number[]>; // window seconds -> [L10, L50, L90] dBFS
+
+/**
+ * The dB a zone's loop is fed: the reading, or the requested percentile as last
+ * reported by the device. Falls back to the reading until percentiles arrive.
+ * Must match metricDb10() in firmware/src/mapper.cpp.
+ */
+export function mapperInput(dbFS: number, metric: string | undefined, percentiles?: Percentiles): number {
+  const p = percentiles?.[PERCENTILE_WINDOW_S];
+  if (!p) return dbFS;
+  if (metric === "l10") return p[0];
+  if (metric === "l50") return p[1];
+  if (metric === "l90") return p[2];
+  return dbFS;
 }
 
 // When Soundtrack reports the zone's player offline, stop hammering setVolume
@@ -47,7 +76,8 @@ export class VolumeMapper {
       loudThresholdDb: number;
       smoothingFactor: number;
       sustainThreshold: number;
-    }
+    },
+    bands?: number[]
   ): Promise<{ volume: number; apiCalled: boolean; playerOnline?: boolean }> {
     if (!config.isEnabled) {
       return { volume: -1, apiCalled: false };
@@ -56,6 +86,7 @@ export class VolumeMapper {
     // Noise floor gate: skip readings well below the active range
     if (dbFS < config.quietThresholdDb - 3) {
       const state = this.zoneStates.get(zoneId);
+      if (state && bands) this.storeBands(state, bands);
       return { volume: state?.currentVolume ?? config.minVolume, apiCalled: false };
     }
 
@@ -71,9 +102,12 @@ export class VolumeMapper {
         sustainCount: 0,
         pendingVolume: null,
         pendingDirection: null,
+        bandsDb: null,
+        bandsAt: 0,
       };
       this.zoneStates.set(zoneId, state);
     }
+    if (bands) this.storeBands(state, bands);
 
     // 1. Apply asymmetric EMA smoothing
     //    Attack (getting louder): faster response (1.5x smoothing factor)
@@ -195,6 +229,15 @@ export class VolumeMapper {
     return Math.round(volume);
   }
 
+  /**
+   * Keep the device's latest octave-band spectrum with the zone state, so the
+   * controller can tell crowd noise from the zone's own music.
+   */
+  private storeBands(state: ZoneState, bands: number[]): void {
+    state.bandsDb = bands.slice();
+    state.bandsAt = Date.now();
+  }
+
   getZoneState(zoneId: string): ZoneState | undefined {
     return this.zoneStates.get(zoneId);
   }
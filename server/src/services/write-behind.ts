@@ -0,0 +1,161 @@
+import { Prisma } from "@prisma/client";
+import { prisma } from "../db";
+
+// Pending writes go to Postgres this often, one UPDATE per table per chunk.
+const FLUSH_INTERVAL_MS = 1000;
+const ROWS_PER_STATEMENT = 500;
+
+interface LevelWrite {
+  dbLevel: number;
+  seenAt: Date;
+  percentiles?: Record<string, number[]>;
+  bands?: number[];
+}
+
+export interface ZoneWrite {
+  currentVolume?: number;
+  playerOnline?: boolean;
+}
+
+/**
+ * Write-behind buffer for the per-reading row updates: Device.lastDbLevel /
+ * lastSeen / lastPercentiles / lastBands and ZoneConfig.currentVolume / playerOnline. The
+ * handlers queue them without waiting; a newer write to the same row replaces
+ * the pending one, and every FLUSH_INTERVAL_MS the lot goes out as batched
+ * UPDATE ... FROM (VALUES ...) statements. The dashboard reads rows at most
+ * that much behind. A failed flush keeps its rows for the next one unless a
+ * newer write has replaced them.
+ */
+export class WriteBehind {
+  private levels: Map<string, LevelWrite> = new Map(); // by hardware deviceId
+  private zones: Map<string, ZoneWrite> = new Map(); // by ZoneConfig.id
+  private timer: NodeJS.Timeout | null = null;
+  private flushing: Promise<void> | null = null;
+  private metrics = { flushes: 0, failures: 0, rows: 0, lastBatch: 0, maxBatch: 0, lastMs: 0, maxMs: 0, totalMs: 0 };
+
+  start(): void {
+    if (this.timer) return;
+    this.timer = setInterval(() => void this.flush(), FLUSH_INTERVAL_MS);
+    this.timer.unref();
+  }
+
+  // Stop the timer and write what is pending (shutdown).
+  async stop(): Promise<void> {
+    if (this.timer) clearInterval(this.timer);
+    this.timer = null;
+    await this.flush();
+  }
+
+  queueLevel(deviceId: string, dbLevel: number, percentiles?: Record<string, number[]>): void {
+    // Keep the last percentiles if this reading carries none (they come with
+    // every JSON reading but only the last of a bin1 batch).
+    const prev = this.levels.get(deviceId);
+    this.levels.set(deviceId, {
+      dbLevel,
+      seenAt: new Date(),
+      percentiles: percentiles ?? prev?.percentiles,
+      bands: prev?.bands,
+    });
+  }
+
+  // Band levels ride on the reading just queued for the device (queueLevel).
+  queueBands(deviceId: string, bands: number[]): void {
+    const w = this.levels.get(deviceId);
+    if (w) w.bands = bands.slice();
+  }
+
+  queueZone(configId: string, updates: ZoneWrite): void {
+    this.zones.set(configId, { ...this.zones.get(configId), ...updates });
+  }
+
+  // Write everything pending now. Flushes never overlap.
+  async flush(): Promise<void> {
+    while (this.flushing) await this.flushing;
+    if (this.levels.size === 0 && this.zones.size === 0) return;
+    this.flushing = this.write().finally(() => (this.flushing = null));
+    await this.flushing;
+  }
+
+  private async write(): Promise<void> {
+    const levels = [...this.levels];
+    const zones = [...this.zones];
+    this.levels.clear();
+    this.zones.clear();
+
+    const started = performance.now();
+    try {
+      for (let i = 0; i < levels.length; i += ROWS_PER_STATEMENT) {
+        await this.writeLevels(levels.slice(i, i + ROWS_PER_STATEMENT));
+      }
+      for (let i = 0; i < zones.length; i += ROWS_PER_STATEMENT) {
+        await this.writeZones(zones.slice(i, i + ROWS_PER_STATEMENT));
+      }
+    } catch (err) {
+      this.metrics.failures++;
+      console.error(`Write-behind flush of ${levels.length + zones.length} row(s) failed:`, err);
+      for (const [id, w] of levels) if (!this.levels.has(id)) this.levels.set(id, w);
+      for (const [id, w] of zones) this.zones.set(id, { ...w, ...this.zones.get(id) });
+      return;
+    }
+
+    const ms = performance.now() - started;
+    const batch = levels.length + zones.length;
+    const m = this.metrics;
+    m.flushes++;
+    m.rows += batch;
+    m.lastBatch = batch;
+    m.maxBatch = Math.max(m.maxBatch, batch);
+    m.lastMs = ms;
+    m.maxMs = Math.max(m.maxMs, ms);
+    m.totalMs += ms;
+  }
+
+  private async writeLevels(rows: [string, LevelWrite][]): Promise<void> {
+    const values = rows.map(
+      ([deviceId, w]) =>
+        Prisma.sql`(${deviceId}::text, ${w.dbLevel}::double precision, ${w.seenAt}::timestamp(3), ${
+          w.percentiles ? JSON.stringify(w.percentiles) : null
+        }::jsonb, ${w.bands ? JSON.stringify(w.bands) : null}::jsonb)`
+    );
+    await prisma.$executeRaw`
+      UPDATE "Device" AS d SET
+        "lastDbLevel" = v.level,
+        "lastSeen" = v.seen,
+        "lastPercentiles" = COALESCE(v.percentiles, d."lastPercentiles"),
+        "lastBands" = COALESCE(v.bands, d."lastBands"),
+        "updatedAt" = NOW()
+      FROM (VALUES ${Prisma.join(values)}) AS v(device_id, level, seen, percentiles, bands)
+      WHERE d."deviceId" = v.device_id`;
+  }
+
+  private async writeZones(rows: [string, ZoneWrite][]): Promise<void> {
+    const values = rows.map(
+      ([id, w]) => Prisma.sql`(${id}::text, ${w.currentVolume ?? null}::integer, ${w.playerOnline ?? null}::boolean)`
+    );
+    await prisma.$executeRaw`
+      UPDATE "ZoneConfig" AS z SET
+        "currentVolume" = COALESCE(v.volume, z."currentVolume"),
+        "playerOnline" = COALESCE(v.online, z."playerOnline"),
+        "updatedAt" = NOW()
+      FROM (VALUES ${Prisma.join(values)}) AS v(id, volume, online)
+      WHERE z.id = v.id`;
+  }
+
+  // Flush latency (ms) and batch size (rows per flush) since start.
+  stats() {
+    const m = this.metrics;
+    return {
+      intervalMs: FLUSH_INTERVAL_MS,
+      pending: this.levels.size + this.zones.size,
+      flushes: m.flushes,
+      failures: m.failures,
+      rows: m.rows,
+      lastBatch: m.lastBatch,
+      maxBatch: m.maxBatch,
+      meanBatch: m.flushes ? Math.round((m.rows / m.flushes) * 10) / 10 : 0,
+      lastFlushMs: Math.round(m.lastMs * 10) / 10,
+      maxFlushMs: Math.round(m.maxMs * 10) / 10,
+      meanFlushMs: m.flushes ? Math.round((m.totalMs / m.flushes) * 10) / 10 : 0,
+    };
+  }
+}
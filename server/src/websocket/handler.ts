@@ -1,20 +1,30 @@
 import http from "http";
 import WebSocket, { WebSocketServer } from "ws";
 import * as Sentry from "@sentry/node";
-import { DeviceManager } from "../services/device-manager";
-import { VolumeMapper } from "../services/volume-mapper";
+import { DeviceManager, type DeviceStats } from "../services/device-manager";
+import { VolumeMapper, OCTAVE_BAND_CENTERS_HZ, mapperInput, type Percentiles } from "../services/volume-mapper";
 import { SoundtrackService } from "../services/soundtrack";
+import { DeviceCache } from "../services/device-cache";
+import { WriteBehind } from "../services/write-behind";
+import { TimeSeries } from "../services/timeseries";
 import { prisma } from "../db";
 
-const deviceManager = new DeviceManager();
+const writeBehind = new WriteBehind();
+const deviceCache = new DeviceCache();
+const timeSeries = new TimeSeries();
+const deviceManager = new DeviceManager(writeBehind);
 const soundtrack = new SoundtrackService();
 const volumeMapper = new VolumeMapper(soundtrack);
 
 interface SoundLevelMessage {
   type: "sound_level";
   deviceId: string;
-  rms: number;
+  rms?: number;
   dbFS: number;
+  weighting?: "Z" | "A" | "C" | "K"; // frequency weighting applied to dbFS (absent on older firmware = Z)
+  overruns?: number; // firmware I2S DMA overruns since boot (0 = gap-free capture)
+  bands?: number[]; // octave-band levels in dBFS, see OCTAVE_BAND_CENTERS_HZ (every ~2s)
+  percentiles?: Percentiles; // window seconds -> [L10, L50, L90] dBFS (firmware/src/levelstats.h)
 }
 
 interface RegisterMessage {
@@ -22,17 +32,160 @@ interface RegisterMessage {
   deviceId: string;
   firmware?: string;
   accountId?: string;
+  encodings?: string[]; // telemetry encodings the device can send, e.g. ["bin1", "json"]
+  mapper?: number; // version of the on-device volume mapper it can run (firmware/src/mapper.h)
+  connect?: { wifiMs: number; wsMs: number; fast?: boolean }; // boot-to-WiFi / boot-to-websocket ms
+  boot?: Record<string, number>; // setup() phase -> ms since boot when it finished (firmware/src/boottrace.h)
+  tls?: { full: number; resumed: number; failed: number; fullMs: number; resumedMs: number; wsConnects: number; wsMs: number }; // handshake counters (firmware/src/tls.h)
 }
 
-type IncomingMessage = SoundLevelMessage | RegisterMessage;
+// "Set zone X to volume Y" from a device running the mapper itself. Answered
+// with { type: "volume_ack", seq, ok, playerOnline? }.
+interface VolumeIntentMessage {
+  type: "volume_intent";
+  deviceId: string;
+  zoneId: string;
+  volume: number;
+  seq: number;
+}
+
+// Runtime metrics, every minute (firmware/src/metrics.h).
+interface StatsMessage extends DeviceStats {
+  type: "stats";
+  deviceId: string;
+}
+
+// Reply to "get_logs": the newest records of the device's log ring
+// (firmware/src/logring.h) as [ms, level, module, text].
+interface LogsMessage {
+  type: "logs";
+  deviceId: string;
+  uptimeMs: number;
+  records: [number, string, string, string][];
+}
+
+type IncomingMessage = SoundLevelMessage | RegisterMessage | VolumeIntentMessage | StatsMessage | LogsMessage;
+
+// On-device volume control: a device offering this mapper version gets its zone
+// configs in "registered" (and "zone_configs" on every change) and runs the
+// control loop itself. Its readings are then only recorded, not mapped here.
+// Version 2 follows ZoneConfig.levelMetric; older firmware stays server-mapped.
+const MAPPER_VERSION = 2;
+
+// Send-on-delta reporting (firmware/src/report.h): a steady device sends only
+// a heartbeat, and every reading for holdS after a change. The mapper here
+// smooths and counts sustain per reading, so for a server-controlled device the
+// hold spans the slowest zone's release smoothing (95% settled at 2 readings/s).
+const REPORT_HOLD_S = 5;
+const REPORT_HOLD_MAX_S = 120;
+
+interface ReportingDevice {
+  reportDeadbandDb: number;
+  reportSlopeDbPerS: number;
+  reportHeartbeatS: number;
+  configs: { isEnabled: boolean; smoothingFactor: number }[];
+}
+
+export function reportingParams(device: ReportingDevice, deviceControl: boolean) {
+  let holdS = REPORT_HOLD_S;
+  if (!deviceControl) {
+    for (const c of device.configs) {
+      const release = c.smoothingFactor * 0.5; // VolumeMapper's release alpha
+      if (!c.isEnabled || release <= 0 || release >= 1) continue;
+      const readings = Math.log(0.05) / Math.log(1 - release);
+      holdS = Math.max(holdS, Math.min(Math.ceil(readings * 0.5), REPORT_HOLD_MAX_S));
+    }
+  }
+  return {
+    deadbandDb: device.reportDeadbandDb,
+    slopeDbPerS: device.reportSlopeDbPerS,
+    holdS,
+    heartbeatS: device.reportHeartbeatS,
+  };
+}
 
 const HEARTBEAT_INTERVAL_MS = 30000;
 interface LiveSocket extends WebSocket {
   isAlive?: boolean;
+  deviceId?: string; // set on register; binary frames carry no deviceId
+}
+
+// --- Binary telemetry ("bin1") ------------------------------------------------
+// Batched sound_level readings in one binary frame, negotiated in the register
+// handshake (JSON stays the fallback). Layout, little-endian — must match
+// firmware/src/telemetry.h:
+//   u8 version=1, u8 count, u8 weighting (0=Z 1=A 2=C 3=K), u8 reserved, u32 t0 (device ms)
+//   count x { u16 dt ms since t0, i16 dBFS x 10 }
+//   sections to the end: { u8 tag, u8 len, len bytes } — unknown tags are skipped
+// Frames with a backlog section are readings replayed after an outage
+// (firmware/src/backlog.h): history only, never fed to the volume mapper.
+const TELEMETRY_ENCODING = "bin1";
+const TELEMETRY_VERSION = 1;
+const TAG_BANDS = 1; // i8 x bands: octave-band dBFS
+const TAG_OVERRUNS = 2; // u32: I2S DMA overruns since boot
+const TAG_WALLCLOCK = 3; // u32 unix seconds, u16 ms: wall-clock time of t0
+const TAG_BACKLOG = 4; // u32 still queued, u32 capacity, u32 dropped since boot
+const TAG_PERCENTILES = 5; // per window { u16 seconds, i16 L10, i16 L50, i16 L90 (dBFS x 10) }
+const WEIGHTINGS = ["Z", "A", "C", "K"] as const;
+
+interface TelemetryFrame {
+  t0: number;
+  weighting: (typeof WEIGHTINGS)[number];
+  readings: { dtMs: number; dbFS: number }[];
+  overruns?: number;
+  bands?: number[];
+  wallclockMs?: number; // unix ms of t0, if the device clock was set
+  backlog?: { queued: number; capacity: number; dropped: number };
+  percentiles?: Percentiles;
+}
+
+export function decodeTelemetryFrame(buf: Buffer): TelemetryFrame | null {
+  if (buf.length < 8 || buf[0] !== TELEMETRY_VERSION) return null;
+  const count = buf[1];
+  let off = 8;
+  if (count === 0 || buf.length < off + count * 4) return null;
+
+  const frame: TelemetryFrame = {
+    t0: buf.readUInt32LE(4),
+    weighting: WEIGHTINGS[buf[2]] ?? "Z",
+    readings: [],
+  };
+  for (let i = 0; i < count; i++, off += 4) {
+    frame.readings.push({ dtMs: buf.readUInt16LE(off), dbFS: buf.readInt16LE(off + 2) / 10 });
+  }
+
+  while (off + 2 <= buf.length) {
+    const tag = buf[off];
+    const len = buf[off + 1];
+    const body = off + 2;
+    if (body + len > buf.length) break; // truncated section: keep what we have
+    if (tag === TAG_BANDS) {
+      frame.bands = Array.from({ length: len }, (_, i) => buf.readInt8(body + i));
+    } else if (tag === TAG_OVERRUNS && len >= 4) {
+      frame.overruns = buf.readUInt32LE(body);
+    } else if (tag === TAG_WALLCLOCK && len >= 6) {
+      frame.wallclockMs = buf.readUInt32LE(body) * 1000 + buf.readUInt16LE(body + 4);
+    } else if (tag === TAG_BACKLOG && len >= 12) {
+      frame.backlog = {
+        queued: buf.readUInt32LE(body),
+        capacity: buf.readUInt32LE(body + 4),
+        dropped: buf.readUInt32LE(body + 8),
+      };
+    } else if (tag === TAG_PERCENTILES) {
+      frame.percentiles = {};
+      for (let p = body; p + 8 <= body + len; p += 8) {
+        frame.percentiles[buf.readUInt16LE(p)] = [1, 2, 3].map((k) => buf.readInt16LE(p + k * 2) / 10);
+      }
+    }
+    off = body + len;
+  }
+  return frame;
 }
 
 export function setupWebSocket(server: http.Server): void {
   const wss = new WebSocketServer({ server, path: "/ws" });
+  writeBehind.start();
+  timeSeries.start();
 
   wss.on("connection", (ws: WebSocket) => {
     console.log("New WebSocket connection");
@@ -41,9 +194,14 @@ export function setupWebSocket(server: http.Server): void {
       (ws as LiveSocket).isAlive = true;
     });
 
-    ws.on("message", async (raw: Buffer) => {
+    ws.on("message", async (raw: Buffer, isBinary: boolean) => {
       (ws as LiveSocket).isAlive = true; // any device traffic proves liveness
       try {
+        if (isBinary) {
+          await handleTelemetryFrame(ws as LiveSocket, raw);
+          return;
+        }
+
         const message: IncomingMessage = JSON.parse(raw.toString());
 
         switch (message.type) {
@@ -53,6 +211,15 @@ export function setupWebSocket(server: http.Server): void {
           case "sound_level":
             await handleSoundLevel(message);
             break;
+          case "volume_intent":
+            await handleVolumeIntent(ws as LiveSocket, message);
+            break;
+          case "stats":
+            await handleStats(ws as LiveSocket, message);
+            break;
+          case "logs":
+            handleLogs(ws as LiveSocket, message);
+            break;
           default:
             console.warn("Unknown message type:", (message as any).type);
         }
@@ -104,19 +271,36 @@ export function setupWebSocket(server: http.Server): void {
 }
 
 async function handleRegister(ws: WebSocket, msg: RegisterMessage): Promise<void> {
-  await deviceManager.registerDevice(ws, msg.deviceId, msg.firmware, msg.accountId);
+  const deviceControl = msg.mapper === MAPPER_VERSION;
+  await deviceManager.registerDevice(ws, msg.deviceId, msg.firmware, msg.accountId, deviceControl);
+  deviceCache.invalidateDeviceId(msg.deviceId);
+  (ws as LiveSocket).deviceId = msg.deviceId;
+  if (msg.connect || msg.boot) await deviceManager.updateBootTiming(msg.deviceId, msg.connect, msg.boot);
+  if (msg.tls && msg.tls.full + msg.tls.resumed > 0) {
+    const t = msg.tls;
+    console.log(
+      `[tls] ${msg.deviceId}: ${t.full} full (${t.fullMs} ms), ${t.resumed} resumed (${t.resumedMs} ms), ` +
+        `${t.failed} failed; websocket ${t.wsConnects} connects (${t.wsMs} ms)`
+    );
+  }
 
   // Send back registration confirmation + any existing configs
   const device = await prisma.device.findUnique({
     where: { deviceId: msg.deviceId },
     include: { configs: true },
   });
+  if (device) timeSeries.setHeartbeat(device.deviceId, device.reportHeartbeatS);
 
   ws.send(
     JSON.stringify({
       type: "registered",
       deviceId: msg.deviceId,
       configs: device?.configs || [],
+      // Accept binary telemetry from devices that offer it.
+      ...(msg.encodings?.includes(TELEMETRY_ENCODING) && { telemetry: TELEMETRY_ENCODING }),
+      // Hand the control loop to devices that can run it.
+      ...(deviceControl && { control: "device", paused: device?.isPaused ?? false }),
+      ...(device && { reporting: reportingParams(device, deviceControl) }),
     })
   );
 
@@ -131,27 +315,171 @@ async function handleRegister(ws: WebSocket, msg: RegisterMessage): Promise<void
   }
 }
 
-async function handleSoundLevel(msg: SoundLevelMessage): Promise<void> {
-  // Update device's last reading
-  await deviceManager.updateDeviceLevel(msg.deviceId, msg.dbFS);
+async function handleTelemetryFrame(ws: LiveSocket, raw: Buffer): Promise<void> {
+  if (!ws.deviceId) {
+    console.warn("Binary telemetry before register — dropped");
+    return;
+  }
+  const frame = decodeTelemetryFrame(raw);
+  if (!frame) {
+    console.warn(`Malformed telemetry frame from ${ws.deviceId} (${raw.length} bytes)`);
+    return;
+  }
+  if (frame.backlog) {
+    await handleBacklogFrame(ws.deviceId, frame);
+    return;
+  }
+  // Readings are in time order; the spectrum/overrun/percentile sections
+  // describe the latest one, so attach them to the last reading only. The last
+  // was taken about now, the others dtMs apart before it.
+  const last = frame.readings.length - 1;
+  const now = Date.now();
+  for (let i = 0; i <= last; i++) {
+    await handleSoundLevel({
+      type: "sound_level",
+      deviceId: ws.deviceId,
+      dbFS: frame.readings[i].dbFS,
+      weighting: frame.weighting,
+      ...(i === last && { overruns: frame.overruns, bands: frame.bands, percentiles: frame.percentiles }),
+    }, new Date(now - (frame.readings[last].dtMs - frame.readings[i].dtMs)));
+  }
+}
 
-  // Get device from DB to find its ID
-  const device = await prisma.device.findUnique({
-    where: { deviceId: msg.deviceId },
+// Readings buffered on the device during an outage. They are stale by now, so
+// they must not move the volume or the live level; the buffer's state is
+// recorded (fill level and drop-oldest losses, for the dashboard), and the
+// readings go into the history if the device clock dates them.
+async function handleBacklogFrame(deviceId: string, frame: TelemetryFrame): Promise<void> {
+  if (frame.wallclockMs) {
+    for (const r of frame.readings) timeSeries.addLevel(deviceId, r.dbFS, new Date(frame.wallclockMs + r.dtMs), true);
+  }
+  const { queued, capacity, dropped } = frame.backlog!;
+  if (queued === 0) {
+    const when = frame.wallclockMs ? ` from ${new Date(frame.wallclockMs).toISOString()}` : "";
+    console.log(`Backlog from ${deviceId} replayed${when} (${dropped} dropped)`);
+  }
+  await prisma.device.updateMany({
+    where: { deviceId },
+    data: { backlogQueued: queued, backlogCapacity: capacity, backlogDropped: dropped },
   });
+}
+
+/**
+ * Send a device-controlled device its current zone configs after any change to
+ * them (or to the device's pause state). Every online device also gets its
+ * reporting parameters, whose hold follows the zones' smoothing.
+ */
+export async function pushZoneConfigs(deviceUuid: string): Promise<void> {
+  try {
+    const device = await prisma.device.findUnique({
+      where: { id: deviceUuid },
+      include: { configs: true },
+    });
+    if (!device) return;
+    const deviceControl = deviceManager.isDeviceControlled(device.deviceId);
+    timeSeries.setHeartbeat(device.deviceId, device.reportHeartbeatS);
+    deviceManager.sendToDevice(device.deviceId, {
+      type: "set_reporting",
+      ...reportingParams(device, deviceControl),
+    });
+    if (!deviceControl) return;
+    deviceManager.sendToDevice(device.deviceId, {
+      type: "zone_configs",
+      paused: device.isPaused,
+      configs: device.configs,
+    });
+  } catch (err) {
+    console.error("Failed to push zone configs:", err);
+  }
+}
+
+async function handleVolumeIntent(ws: LiveSocket, msg: VolumeIntentMessage): Promise<void> {
+  const ack = (ok: boolean, playerOnline?: boolean) =>
+    ws.send(JSON.stringify({ type: "volume_ack", seq: msg.seq, ok, ...(playerOnline !== undefined && { playerOnline }) }));
+
+  // Trust the socket's registered identity, not the message body.
+  if (!ws.deviceId || !Number.isInteger(msg.volume) || msg.volume < 0 || msg.volume > 16) return ack(false);
+  const device = await deviceCache.get(ws.deviceId);
+  const config = device?.configs.find((c) => c.soundtrackZoneId === msg.zoneId);
+  // The device may act on a config change it has not seen yet; refuse.
+  if (!device || !config || !config.isEnabled || config.isPaused || device.isPaused) return ack(false);
+
+  try {
+    await soundtrack.setVolume(config.soundtrackZoneId, msg.volume);
+    const updates = { currentVolume: msg.volume, ...(!config.playerOnline && { playerOnline: true }) };
+    Object.assign(config, updates);
+    writeBehind.queueZone(config.id, updates);
+    timeSeries.addVolume(config.id, msg.volume);
+    ack(true, true);
+  } catch (err: any) {
+    if (err?.playerOffline) {
+      console.warn(`Zone ${config.soundtrackZoneId} player offline (device ${ws.deviceId} backs off)`);
+      if (config.playerOnline) {
+        config.playerOnline = false;
+        writeBehind.queueZone(config.id, { playerOnline: false });
+      }
+      ack(false, false);
+    } else {
+      console.error(`Failed to set volume for zone ${config.soundtrackZoneId}:`, err);
+      ack(false);
+    }
+  }
+}
+
+async function handleStats(ws: LiveSocket, msg: StatsMessage): Promise<void> {
+  // Trust the socket's registered identity, not the message body.
+  if (!ws.deviceId) return;
+  await deviceManager.updateDeviceStats(ws.deviceId, msg);
+}
+
+function handleLogs(ws: LiveSocket, msg: LogsMessage): void {
+  if (!ws.deviceId) return;
+  deviceManager.resolveLogs(ws.deviceId, msg.records);
+}
+
+// Latest percentiles per device. They arrive with some readings only (the last
+// of each bin1 frame) and hold until the next, as on the device's own mapper.
+const latestPercentiles = new Map<string, Percentiles>();
+
+function validPercentiles(p: unknown): p is Percentiles {
+  return (
+    typeof p === "object" && p !== null &&
+    Object.values(p).every((v) => Array.isArray(v) && v.length === 3 && v.every(Number.isFinite))
+  );
+}
+
+async function handleSoundLevel(msg: SoundLevelMessage, at: Date = new Date()): Promise<void> {
+  const percentiles = validPercentiles(msg.percentiles) ? msg.percentiles : undefined;
+  if (percentiles) latestPercentiles.set(msg.deviceId, percentiles);
+
+  // Update device's last reading and its history
+  deviceManager.updateDeviceLevel(msg.deviceId, msg.dbFS, percentiles);
+  // Band levels are optional and sent at a lower rate; ignore malformed ones.
+  // Kept whatever the control mode, so parsed before the early return below.
+  const bands =
+    Array.isArray(msg.bands) && msg.bands.length === OCTAVE_BAND_CENTERS_HZ.length && msg.bands.every(Number.isFinite)
+      ? msg.bands
+      : undefined;
+  if (bands) deviceManager.updateDeviceBands(msg.deviceId, bands);
+  timeSeries.addLevel(msg.deviceId, msg.dbFS, at);
+
+  // Devices running the mapper send volume_intent themselves; the reading is
+  // only recorded.
+  if (deviceManager.isDeviceControlled(msg.deviceId)) return;
+
+  const device = await deviceCache.get(msg.deviceId);
   if (!device) return;
 
   // Skip processing if device is globally paused
   if (device.isPaused) return;
 
-  // Get enabled and not-paused configs for this device
-  const configs = await prisma.zoneConfig.findMany({
-    where: { deviceId: device.id, isEnabled: true, isPaused: false },
-  });
+  // Enabled and not-paused configs for this device
+  const configs = device.configs.filter((c) => c.isEnabled && !c.isPaused);
 
   // Process each zone config
   for (const config of configs) {
-    const result = await volumeMapper.processReading(config.soundtrackZoneId, msg.dbFS, {
+    const input = mapperInput(msg.dbFS, config.levelMetric, latestPercentiles.get(msg.deviceId));
+    const result = await volumeMapper.processReading(config.soundtrackZoneId, input, {
       isEnabled: config.isEnabled,
       minVolume: config.minVolume,
       maxVolume: config.maxVolume,
@@ -159,20 +487,22 @@ async function handleSoundLevel(msg: SoundLevelMessage): Promise<void> {
       loudThresholdDb: config.loudThresholdDb,
       smoothingFactor: config.smoothingFactor,
       sustainThreshold: config.sustainCount ?? 2,
-    });
+    }, bands);
 
     const updates: { currentVolume?: number; playerOnline?: boolean } = {};
     if (result.apiCalled && result.volume != null) {
       updates.currentVolume = result.volume;
+      timeSeries.addVolume(config.id, result.volume, at);
     }
     // Persist player online/offline transitions so the dashboard can show it.
     if (result.playerOnline !== undefined && result.playerOnline !== config.playerOnline) {
       updates.playerOnline = result.playerOnline;
     }
     if (Object.keys(updates).length > 0) {
-      await prisma.zoneConfig.update({ where: { id: config.id }, data: updates });
+      Object.assign(config, updates); // the cached row, ahead of the flush
+      writeBehind.queueZone(config.id, updates);
     }
   }
 }
 
-export { deviceManager, volumeMapper };
+export { deviceManager, volumeMapper, deviceCache, writeBehind, timeSeries };